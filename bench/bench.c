@@ -0,0 +1,341 @@
+/*
+ * Microbenchmarks for the hot paths: directory scan + sort, list rendering,
+ * viewer open/scroll and file copy. Run against a tree made by fm_gentree:
+ *
+ *   make bench                       (generates the tree on first use)
+ *   bin/fm_bench DIR [name-filter]
+ *
+ * Each benchmark runs in a forked child so peak RSS is per benchmark.
+ * Allocation counts cover the file manager code (malloc/calloc/realloc are
+ * wrapped at link time); ncurses' own allocations are not included.
+ */
+#define _XOPEN_SOURCE 700
+
+/* The rendering and viewer helpers are static, so the UI is compiled into this unit */
+#include "../src/ui.c"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/* ---- allocation counters (-Wl,--wrap=...) ---- */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+static unsigned long long alloc_calls, alloc_bytes;
+
+void *__wrap_malloc(size_t size) {
+    alloc_calls++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    alloc_calls++;
+    alloc_bytes += n * size;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    alloc_calls++;
+    alloc_bytes += size;
+    return __real_realloc(p, size);
+}
+
+/* ---- measurement ---- */
+
+typedef struct bench_stats {
+    const char *unit;             /* what ns/op is per: entry, row, frame, line, ... */
+    unsigned long long units;     /* units processed inside the timed region */
+    unsigned long long bytes;     /* payload bytes processed (for MB/s), 0 = n/a */
+    unsigned long long term_bytes;/* bytes written to the terminal, 0 = n/a */
+    struct timespec t0;
+    double ns;
+    unsigned long long allocs0, alloc_bytes0;
+    unsigned long long allocs, alloc_total;
+} bench_stats;
+
+static const char *data_dir;
+static FILE *term_out;
+
+static void bench_start(bench_stats *st) {
+    st->allocs0 = alloc_calls;
+    st->alloc_bytes0 = alloc_bytes;
+    clock_gettime(CLOCK_MONOTONIC, &st->t0);
+}
+
+static void bench_stop(bench_stats *st) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    st->ns += (t1.tv_sec - st->t0.tv_sec) * 1e9 + (t1.tv_nsec - st->t0.tv_nsec);
+    st->allocs += alloc_calls - st->allocs0;
+    st->alloc_total += alloc_bytes - st->alloc_bytes0;
+}
+
+static void data_path(char *buf, size_t size, const char *rel) {
+    snprintf(buf, size, "%s/%s", data_dir, rel);
+}
+
+/* Off-screen curses: a cols x lines terminal whose output goes to a scratch file
+ * (ncurses writes to the descriptor directly, so it must be a real file) */
+static void headless_screen(int cols, int lines) {
+    char c[16], l[16];
+    snprintf(c, sizeof(c), "%d", cols);
+    snprintf(l, sizeof(l), "%d", lines);
+    setenv("COLUMNS", c, 1);
+    setenv("LINES", l, 1);
+    term_out = tmpfile();
+    if (!term_out) { perror("tmpfile"); exit(1); }
+    FILE *in = fopen("/dev/null", "r");
+    SCREEN *scr = newterm("xterm-256color", term_out, in);
+    if (!scr) scr = newterm("xterm", term_out, in);
+    if (!scr) { fprintf(stderr, "bench: cannot create headless terminal\n"); exit(1); }
+    set_term(scr);
+    start_color();
+    use_default_colors();
+    init_pair(1, COLOR_CYAN, -1);
+    init_pair(2, COLOR_YELLOW, -1);
+    init_pair(3, COLOR_WHITE, -1);
+    init_pair(4, COLOR_BLACK, COLOR_WHITE);
+    init_pair(5, COLOR_BLUE, -1);
+    init_pair(6, COLOR_GREEN, -1);
+    init_pair(7, COLOR_CYAN, -1);
+    noecho();
+    curs_set(0);
+    doupdate();
+}
+
+/* Bytes the terminal emitted since the last call */
+static unsigned long long term_drain(void) {
+    fflush(term_out);
+    int fd = fileno(term_out);
+    off_t n = lseek(fd, 0, SEEK_CUR);
+    if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) < 0) return 0;
+    return n > 0 ? (unsigned long long)n : 0;
+}
+
+/* ---- benchmarks ---- */
+
+static void bench_read_dir(bench_stats *st, const char *rel) {
+    char path[PATH_MAX];
+    data_path(path, sizeof(path), rel);
+    st->unit = "entry";
+    /* Repeat small directories until the measurement is long enough */
+    while (st->ns < 5e8) {
+        fm_entry *items = NULL;
+        bench_start(st);
+        int n = fm_read_dir(path, &items);
+        bench_stop(st);
+        if (n < 0) { perror(path); exit(1); }
+        st->units += n;
+        free(items);
+    }
+}
+
+static void bench_read_dir_flat(bench_stats *st) {
+    bench_read_dir(st, "flat");
+}
+
+static void bench_read_dir_small(bench_stats *st) {
+    char rel[64];
+    st->unit = "entry";
+    for (int s = 0; s < 256; ++s) {
+        snprintf(rel, sizeof(rel), "small/s%03d", s);
+        fm_entry *items = NULL;
+        char path[PATH_MAX];
+        data_path(path, sizeof(path), rel);
+        bench_start(st);
+        int n = fm_read_dir(path, &items);
+        bench_stop(st);
+        if (n > 0) st->units += n;
+        free(items);
+    }
+}
+
+static int count_cb(void *ctx, fm_walk_event ev, const fm_walk_entry *e) {
+    (void)e;
+    if (ev != FM_WALK_DIR_POST) (*(unsigned long long *)ctx)++;
+    return 0;
+}
+
+static void bench_walk_deep(bench_stats *st) {
+    char path[PATH_MAX];
+    data_path(path, sizeof(path), "deep");
+    st->unit = "entry";
+    while (st->ns < 5e8) {
+        bench_start(st);
+        fm_walk(path, count_cb, &st->units);
+        bench_stop(st);
+    }
+}
+
+static void bench_draw(bench_stats *st, int cols) {
+    char path[PATH_MAX];
+    data_path(path, sizeof(path), "flat");
+    fm_entry *items = NULL;
+    int count = fm_read_dir(path, &items);
+    if (count <= 0) { perror(path); exit(1); }
+
+    headless_screen(cols, 50);
+    WINDOW *win = newwin(48, cols, 1, 0);
+    fm_selection marks;
+    fm_sel_init(&marks);
+    fm_sel_resize(&marks, count);
+    for (int i = 0; i < count; i += 7) fm_sel_toggle(&marks, items, i);
+    term_drain();
+
+    /* Page through the listing like a user holding PgDn */
+    st->unit = "frame";
+    int rows = getmaxy(win) - 1, offset = 0;
+    for (int frame = 0; frame < 2000; ++frame) {
+        bench_start(st);
+        draw_list(win, items, count, offset + rows / 2, offset, &marks, 1);
+        doupdate();
+        bench_stop(st);
+        st->term_bytes += term_drain();
+        st->units++;
+        offset = (offset + rows) % (count > rows ? count - rows : 1);
+    }
+    endwin();
+    fm_sel_free(&marks);
+    free(items);
+}
+
+static void bench_draw_list(bench_stats *st) {
+    bench_draw(st, 200);
+}
+
+static void bench_draw_list_compact(bench_stats *st) {
+    bench_draw(st, COMPACT_WIDTH - 1);
+}
+
+static void bench_viewer_open(bench_stats *st) {
+    char path[PATH_MAX];
+    data_path(path, sizeof(path), "text/access.log");
+    struct stat sb;
+    if (stat(path, &sb) != 0) { perror(path); exit(1); }
+    st->unit = "line";
+    while (st->ns < 5e8) {
+        viewer_doc doc;
+        bench_start(st);
+        int rc = viewer_load(path, NULL, &doc);
+        bench_stop(st);
+        if (rc != 0) { perror(path); exit(1); }
+        st->units += doc.count;
+        st->bytes += sb.st_size;
+        viewer_free(&doc);
+    }
+}
+
+static void bench_viewer_scroll(bench_stats *st) {
+    char path[PATH_MAX];
+    data_path(path, sizeof(path), "text/access.log");
+    viewer_doc doc;
+    if (viewer_load(path, NULL, &doc) != 0) { perror(path); exit(1); }
+    headless_screen(200, 50);
+    term_drain();
+    st->unit = "frame";
+    int page = getmaxy(stdscr) - 2, offset = 0;
+    for (int frame = 0; frame < 2000; ++frame) {
+        bench_start(st);
+        viewer_draw(path, &doc, offset);
+        refresh();
+        bench_stop(st);
+        st->term_bytes += term_drain();
+        st->units++;
+        offset = (offset + page) % (doc.count > page ? doc.count - page : 1);
+    }
+    endwin();
+    viewer_free(&doc);
+}
+
+static void bench_copy(bench_stats *st, const char *rel) {
+    char src[PATH_MAX], dst[PATH_MAX];
+    data_path(src, sizeof(src), rel);
+    data_path(dst, sizeof(dst), ".bench_copy.tmp");
+    struct stat sb;
+    if (stat(src, &sb) != 0) { perror(src); exit(1); }
+    st->unit = "MB";
+    bench_start(st);
+    int rc = fm_copy_file(src, dst);
+    bench_stop(st);
+    unlink(dst);
+    if (rc != 0) { perror(src); exit(1); }
+    st->bytes += sb.st_size;
+    st->units += sb.st_size / (1024 * 1024);
+}
+
+static void bench_copy_dense(bench_stats *st) {
+    bench_copy(st, "huge/dense0.bin");
+}
+
+static void bench_copy_sparse(bench_stats *st) {
+    bench_copy(st, "huge/sparse0.bin");
+}
+
+typedef struct bench_case {
+    const char *name;
+    void (*fn)(bench_stats *st);
+} bench_case;
+
+static const bench_case cases[] = {
+    { "read_dir_flat",     bench_read_dir_flat },
+    { "read_dir_small",    bench_read_dir_small },
+    { "walk_deep",         bench_walk_deep },
+    { "draw_list",         bench_draw_list },
+    { "draw_list_compact", bench_draw_list_compact },
+    { "viewer_open",       bench_viewer_open },
+    { "viewer_scroll",     bench_viewer_scroll },
+    { "copy_dense",        bench_copy_dense },
+    { "copy_sparse",       bench_copy_sparse },
+    { NULL, NULL }
+};
+
+/* Run one case in a child process and print its row */
+static int run_case(const bench_case *c) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); return -1; }
+    if (pid == 0) {
+        bench_stats st;
+        memset(&st, 0, sizeof(st));
+        c->fn(&st);
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        double per_unit = st.units ? st.ns / st.units : 0;
+        double secs = st.ns / 1e9;
+        char mbps[16] = "-", term[16] = "-";
+        if (st.bytes && secs > 0) snprintf(mbps, sizeof(mbps), "%.1f", st.bytes / (1024.0 * 1024.0) / secs);
+        if (st.units && st.term_bytes) snprintf(term, sizeof(term), "%llu", st.term_bytes / st.units);
+        printf("%-18s %12llu %12.1f %-6s %9s %12.2f %12.1f %11.1f %11s\n", c->name, st.units, per_unit,
+               st.unit, mbps, st.units ? (double)st.allocs / st.units : 0.0,
+               st.alloc_total / (1024.0 * 1024.0), ru.ru_maxrss / 1024.0, term);
+        fflush(stdout);
+        _exit(0);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("%-18s failed\n", c->name);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s DIR [name-filter]\n", argv[0]);
+        return 2;
+    }
+    data_dir = argv[1];
+    const char *filter = argc > 2 ? argv[2] : NULL;
+
+    printf("%-18s %12s %12s %-6s %9s %12s %12s %11s %11s\n", "benchmark", "units", "ns/unit", "unit",
+           "MB/s", "allocs/unit", "alloc MB", "peak RSS MB", "term B/unit");
+    int failed = 0;
+    for (const bench_case *c = cases; c->name; ++c) {
+        if (filter && !strstr(c->name, filter)) continue;
+        if (run_case(c) != 0) failed = 1;
+    }
+    return failed;
+}
@@ -0,0 +1,247 @@
+#define _XOPEN_SOURCE 700
+/*
+ * Reproducible synthetic trees for the benchmarks.
+ *
+ *   DIR/flat/     N empty files in one directory
+ *   DIR/deep/     a DEPTH-level directory chain with a few files per level
+ *   DIR/small/    N small files (1-8 KB) spread over 256 subdirectories
+ *   DIR/huge/     two dense files of HUGE_MB and one sparse file of SPARSE_MB
+ *   DIR/text/     a log-like text file of TEXT_MB for the viewer
+ *
+ * Contents are derived from --seed only, so every run produces the same tree.
+ * A tree whose DIR/.gentree stamp matches the parameters is left untouched.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+typedef struct params {
+    long flat;
+    int deep;
+    long small;
+    long huge_mb;
+    long sparse_mb;
+    long text_mb;
+    unsigned long seed;
+} params;
+
+static unsigned long long rng_state;
+
+/* xorshift64*: fast and fully determined by the seed */
+static unsigned long long rng(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static void die(const char *what, const char *path) {
+    fprintf(stderr, "gentree: %s %s: %s\n", what, path, strerror(errno));
+    exit(1);
+}
+
+static void make_dir(const char *path) {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) die("mkdir", path);
+}
+
+static void write_all(int fd, const char *buf, size_t len, const char *path) {
+    while (len > 0) {
+        ssize_t w = write(fd, buf, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            die("write", path);
+        }
+        buf += w;
+        len -= w;
+    }
+}
+
+static void fill_random(char *buf, size_t len) {
+    for (size_t i = 0; i + 8 <= len; i += 8) {
+        unsigned long long v = rng();
+        memcpy(buf + i, &v, 8);
+    }
+}
+
+static void gen_flat(const char *root, long n) {
+    char dir[PATH_MAX], path[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/flat", root);
+    make_dir(dir);
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dfd < 0) die("open", dir);
+    for (long i = 0; i < n; ++i) {
+        /* Mixed-case random prefixes so the case-insensitive sort does real work */
+        unsigned long long r = rng();
+        snprintf(path, sizeof(path), "%c%08llx_%07ld%s", (r & 1) ? 'F' : 'f', r >> 32, i,
+                 (r & 6) == 0 ? ".log" : ".dat");
+        if (i % 50 == 0) {
+            if (mkdirat(dfd, path, 0755) != 0 && errno != EEXIST) die("mkdir", path);
+            continue;
+        }
+        int fd = openat(dfd, path, O_WRONLY | O_CREAT, 0644);
+        if (fd < 0) die("create", path);
+        close(fd);
+    }
+    close(dfd);
+}
+
+static void gen_deep(const char *root, int depth) {
+    char path[PATH_MAX], file[PATH_MAX + 16];
+    int len = snprintf(path, sizeof(path), "%s/deep", root);
+    make_dir(path);
+    for (int d = 0; d < depth; ++d) {
+        int n = snprintf(path + len, sizeof(path) - len, "/d%d", d);
+        if (n < 0 || (size_t)n >= sizeof(path) - len) break;   /* PATH_MAX reached */
+        len += n;
+        make_dir(path);
+        for (int f = 0; f < 4; ++f) {
+            snprintf(file, sizeof(file), "%s/file%d.txt", path, f);
+            int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) die("create", file);
+            write_all(fd, "deep\n", 5, file);
+            close(fd);
+        }
+    }
+}
+
+static void gen_small(const char *root, long n) {
+    char dir[PATH_MAX], path[PATH_MAX + 32];
+    char buf[8192];
+    snprintf(dir, sizeof(dir), "%s/small", root);
+    make_dir(dir);
+    for (int s = 0; s < 256; ++s) {
+        snprintf(path, sizeof(path), "%s/s%03d", dir, s);
+        make_dir(path);
+    }
+    for (long i = 0; i < n; ++i) {
+        size_t size = 1024 + rng() % (8192 - 1024);
+        int len = snprintf(path, sizeof(path), "%s/s%03ld/file%07ld.bin", dir, i % 256, i);
+        if (len < 0 || (size_t)len >= sizeof(path)) {
+            errno = ENAMETOOLONG;
+            die("create", dir);
+        }
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) die("create", path);
+        fill_random(buf, size);
+        write_all(fd, buf, size, path);
+        close(fd);
+    }
+}
+
+static void gen_huge(const char *root, long huge_mb, long sparse_mb) {
+    char dir[PATH_MAX], path[PATH_MAX + 32];
+    size_t chunk = 1024 * 1024;
+    char *buf = malloc(chunk);
+    if (!buf) { errno = ENOMEM; die("alloc", "buffer"); }
+    snprintf(dir, sizeof(dir), "%s/huge", root);
+    make_dir(dir);
+    for (int k = 0; k < 2; ++k) {
+        snprintf(path, sizeof(path), "%s/dense%d.bin", dir, k);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) die("create", path);
+        for (long m = 0; m < huge_mb; ++m) {
+            fill_random(buf, chunk);
+            write_all(fd, buf, chunk, path);
+        }
+        close(fd);
+    }
+    /* Sparse: 1 MB of data at the start, middle and end, holes elsewhere */
+    snprintf(path, sizeof(path), "%s/sparse0.bin", dir);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) die("create", path);
+    off_t size = (off_t)sparse_mb * chunk;
+    off_t spots[3] = { 0, size / 2, size - (off_t)chunk };
+    for (int i = 0; i < 3 && size >= (off_t)chunk; ++i) {
+        fill_random(buf, chunk);
+        if (lseek(fd, spots[i], SEEK_SET) < 0) die("seek", path);
+        write_all(fd, buf, chunk, path);
+    }
+    if (ftruncate(fd, size) != 0) die("truncate", path);
+    close(fd);
+    free(buf);
+}
+
+static void gen_text(const char *root, long text_mb) {
+    static const char *words[] = { "GET", "POST", "/api/v1/items", "/index.html", "200", "404",
+                                   "500", "user=alice", "user=bob", "latency_ms=", "cache=hit",
+                                   "cache=miss", "worker", "request", "completed", "retry" };
+    char dir[PATH_MAX], path[PATH_MAX + 32], line[256];
+    snprintf(dir, sizeof(dir), "%s/text", root);
+    make_dir(dir);
+    snprintf(path, sizeof(path), "%s/access.log", dir);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) die("create", path);
+    long long target = text_mb * 1024LL * 1024LL, written = 0;
+    for (long n = 0; written < target; ++n) {
+        int len = snprintf(line, sizeof(line), "2025-01-01T00:%02ld:%02ld.%03ld", (n / 60000) % 60,
+                           (n / 1000) % 60, n % 1000);
+        int words_n = 4 + rng() % 8;
+        for (int w = 0; w < words_n; ++w) {
+            len += snprintf(line + len, sizeof(line) - len, " %s", words[rng() % 16]);
+        }
+        line[len++] = '\n';
+        write_all(fd, line, len, path);
+        written += len;
+    }
+    close(fd);
+}
+
+int main(int argc, char **argv) {
+    params p = { 1000000, 200, 100000, 512, 1024, 64, 42 };
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s DIR [--flat N] [--deep DEPTH] [--small N] [--huge-mb MB] "
+                        "[--sparse-mb MB] [--text-mb MB] [--seed S]\n", argv[0]);
+        return 2;
+    }
+    const char *root = argv[1];
+    for (int i = 2; i + 1 < argc; i += 2) {
+        long v = atol(argv[i + 1]);
+        if (strcmp(argv[i], "--flat") == 0) p.flat = v;
+        else if (strcmp(argv[i], "--deep") == 0) p.deep = (int)v;
+        else if (strcmp(argv[i], "--small") == 0) p.small = v;
+        else if (strcmp(argv[i], "--huge-mb") == 0) p.huge_mb = v;
+        else if (strcmp(argv[i], "--sparse-mb") == 0) p.sparse_mb = v;
+        else if (strcmp(argv[i], "--text-mb") == 0) p.text_mb = v;
+        else if (strcmp(argv[i], "--seed") == 0) p.seed = (unsigned long)v;
+        else { fprintf(stderr, "gentree: unknown option %s\n", argv[i]); return 2; }
+    }
+
+    char stamp[PATH_MAX], want[256], have[256] = "";
+    snprintf(stamp, sizeof(stamp), "%s/.gentree", root);
+    snprintf(want, sizeof(want), "flat=%ld deep=%d small=%ld huge_mb=%ld sparse_mb=%ld text_mb=%ld seed=%lu\n",
+             p.flat, p.deep, p.small, p.huge_mb, p.sparse_mb, p.text_mb, p.seed);
+    FILE *f = fopen(stamp, "r");
+    if (f) {
+        if (!fgets(have, sizeof(have), f)) have[0] = '\0';
+        fclose(f);
+    }
+    if (strcmp(have, want) == 0) {
+        printf("gentree: %s is up to date\n", root);
+        return 0;
+    }
+    if (have[0]) {
+        fprintf(stderr, "gentree: %s was generated with different parameters; remove it first\n", root);
+        return 1;
+    }
+
+    make_dir(root);
+    rng_state = p.seed * 0x9E3779B97F4A7C15ULL + 1;
+    printf("gentree: generating %s", want);
+    fflush(stdout);
+    gen_flat(root, p.flat);
+    gen_deep(root, p.deep);
+    gen_small(root, p.small);
+    gen_huge(root, p.huge_mb, p.sparse_mb);
+    gen_text(root, p.text_mb);
+
+    f = fopen(stamp, "w");
+    if (!f) die("create", stamp);
+    fputs(want, f);
+    fclose(f);
+    return 0;
+}
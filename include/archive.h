@@ -0,0 +1,56 @@
+#ifndef FM_ARCHIVE_H
+#define FM_ARCHIVE_H
+
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include "fs.h"
+
+// One member of a tar archive
+typedef struct fm_tar_member {
+    char *name;              // path inside the archive, without leading "./" or trailing "/"
+    char *link;              // symlink or hard link target, NULL otherwise
+    off_t offset;            // archive offset of the member's data
+    int hardlink;            // data lives in the member named by link
+    struct stat st;          // type and permission bits, size, owner and mtime from the header
+} fm_tar_member;
+
+// Member index of one tar archive, built by a single pass over its headers and shared by
+// every view of the same archive version (dev, ino, mtime)
+typedef struct fm_tar {
+    char path[PATH_MAX];
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    fm_tar_member *members;  // sorted by path, so a directory's descendants are contiguous
+    int count;
+    int refs;
+    struct fm_tar *next;
+} fm_tar;
+
+// Whether a file name looks like a tar archive (".tar")
+int fm_tar_is_archive(const char *name);
+
+// Return a referenced index of the archive at path, scanning its headers only if this
+// version is not cached; NULL with errno set (EINVAL for something that is not a tar)
+fm_tar *fm_tar_get(const char *path);
+
+// Drop a reference returned by fm_tar_get
+void fm_tar_release(fm_tar *t);
+
+// List the members directly below dir ("" for the archive root) the way fm_read_dir lists a
+// directory; entry paths are <archive path>/<member path>, and ".." leads to the parent
+// directory (the archive's own directory at the root). Returns count or -1 with errno set
+int fm_tar_list(const fm_tar *t, const char *dir, fm_entry **entries_out);
+
+// Index of the member with this path, -1 if none
+int fm_tar_find(const fm_tar *t, const char *name);
+
+// Read up to max bytes of a member with pread at its offset into a NUL-terminated buffer
+// (caller frees); returns bytes read or -1 with errno set (ESTALE if the archive changed)
+ssize_t fm_tar_read(const fm_tar *t, int member, size_t max, char **content_out);
+
+// Free every cached index that is no longer referenced
+void fm_tar_shutdown(void);
+
+#endif // FM_ARCHIVE_H
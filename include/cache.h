@@ -0,0 +1,64 @@
+#ifndef FM_CACHE_H
+#define FM_CACHE_H
+
+#include <limits.h>
+#include <time.h>
+#include "fs.h"
+
+// Shared, reference-counted listing of one directory. The same path is scanned
+// once no matter how many views show it; the watcher marks it stale on change.
+typedef struct fm_dirlist {
+    char path[PATH_MAX];
+    fm_entry *entries;
+    int count;
+    int refs;
+    int stale;               // set by the watcher, cleared by a rescan
+    int provisional;         // seeded from the index; not yet confirmed by a read
+    unsigned long gen;       // bumped on every rescan so views notice new contents
+    int wd;                  // watch descriptor, -1 if not watched
+    struct timespec mtime;   // directory mtime at scan time (fallback revalidation)
+    struct fm_dirlist *next;
+} fm_dirlist;
+
+// Start the directory watcher; falls back to mtime checks if unavailable
+int fm_cache_init(void);
+
+// Free every cached listing and stop the watcher
+void fm_cache_shutdown(void);
+
+// Return a referenced listing of path, scanning only if not cached or stale; NULL on error
+fm_dirlist *fm_dircache_get(const char *path);
+
+// Drop a reference returned by fm_dircache_get
+void fm_dircache_release(fm_dirlist *l);
+
+// Rescan a stale listing in place; returns 0 on success, -1 on error
+int fm_dircache_revalidate(fm_dirlist *l);
+
+// Insert a listing read elsewhere (takes ownership of entries). mtime must have been taken
+// before the read; a directory changed since then is marked stale. Ignored if path is
+// already cached, fresh and not provisional
+void fm_dircache_adopt(const char *path, fm_entry *entries, int count, const struct timespec *mtime);
+
+// Insert a listing taken from the index (takes ownership of entries) unless path is already
+// cached. It is served as fresh but flagged provisional until a read is adopted over it
+void fm_dircache_seed(const char *path, fm_entry *entries, int count, const struct timespec *mtime);
+
+// Whether path has a cached listing
+int fm_dircache_contains(const char *path);
+
+// Cached listing of path if it is fresh and was confirmed by a read, else NULL. No reference
+// is taken; the pointer is valid until the next call into the cache
+const fm_dirlist *fm_dircache_peek(const char *path);
+
+// Mark the cached listing of path (if any) stale
+void fm_dircache_invalidate(const char *path);
+
+// Drain pending watcher events; returns number of listings newly marked stale
+int fm_cache_poll(void);
+
+// Cached uid/gid to name lookups; return "?" for unknown ids
+const char *fm_user_name(uid_t uid);
+const char *fm_group_name(gid_t gid);
+
+#endif // FM_CACHE_H
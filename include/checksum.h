@@ -0,0 +1,48 @@
+#ifndef FM_CHECKSUM_H
+#define FM_CHECKSUM_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "fs.h"
+
+typedef enum fm_sum_algo {
+    FM_SUM_XXH64,       // fast path (16 hex digits)
+    FM_SUM_CRC32C,      // fast path (8 hex digits)
+    FM_SUM_SHA256,      // audits (64 hex digits)
+    FM_SUM_ALGOS
+} fm_sum_algo;
+
+#define FM_SUM_HEX_MAX 65
+
+// One file to checksum (or verify when expected is set)
+typedef struct fm_sum_job {
+    char *path;                     // malloc'd; freed by fm_sum_jobs_free
+    fm_sum_algo algo;
+    char hex[FM_SUM_HEX_MAX];       // result, lowercase hex
+    char expected[FM_SUM_HEX_MAX];  // digest from a manifest ("" if none)
+    int err;                        // errno if the file could not be read
+    int cached;                     // result came from the cache
+} fm_sum_job;
+
+// Algorithm name as used in manifests and messages ("xxh64", "crc32c", "sha256")
+const char *fm_sum_name(fm_sum_algo algo);
+
+// Look up a cached digest for an unchanged file (same dev, ino, size and mtime); 0 if found
+int fm_sum_cached(const struct stat *st, fm_sum_algo algo, char *hex);
+
+// Checksum every job concurrently (large aligned sequential reads, one file per worker).
+// Results are cached, so re-checking an unchanged file does no I/O
+void fm_sum_files(fm_sum_job *jobs, int n, fm_progress_fn progress, void *ctx);
+
+void fm_sum_jobs_free(fm_sum_job *jobs, int n);
+
+// Write "<hex>  <path>" lines (sha256sum/xxhsum format) with paths relative to the
+// manifest's directory where possible; 0 on success, -1 with errno set
+int fm_sum_write_manifest(const char *manifest, const fm_sum_job *jobs, int n);
+
+// Load a manifest into jobs (path resolved against the manifest's directory, algorithm
+// inferred from the digest length); returns the job count or -1 with errno set.
+// Unparseable lines are counted in *malformed
+int fm_sum_read_manifest(const char *manifest, fm_sum_job **jobs_out, int *malformed);
+
+#endif // FM_CHECKSUM_H
@@ -0,0 +1,10 @@
+#ifndef FM_CLI_H
+#define FM_CLI_H
+
+// Return non-zero if name is a headless subcommand (ls, cp, rm, du, find, index, locate, compare, help)
+int fm_cli_is_command(const char *name);
+
+// Run a headless subcommand; argv[0] is the subcommand. Returns the process exit code
+int fm_cli_run(int argc, char **argv);
+
+#endif // FM_CLI_H
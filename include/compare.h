@@ -0,0 +1,78 @@
+#ifndef FM_COMPARE_H
+#define FM_COMPARE_H
+
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include "fs.h"
+
+typedef enum fm_cmp_state {
+    FM_CMP_ONLY_LEFT,
+    FM_CMP_ONLY_RIGHT,
+    FM_CMP_SAME,             // size and mtime match, or the content once hashed
+    FM_CMP_DIFFERENT,
+    FM_CMP_ERROR,            // could not be read on one side (err set)
+    FM_CMP_STATES
+} fm_cmp_state;
+
+// One path that differs between the two trees (identical files are only counted)
+typedef struct fm_cmp_item {
+    char *rel;               // path relative to both roots
+    fm_cmp_state state;
+    mode_t lmode, rmode;     // lstat mode on each side, 0 where absent
+    off_t lsize, rsize;
+    struct timespec lmtime, rmtime;
+    int hashed;              // content was compared
+    int err;
+} fm_cmp_item;
+
+typedef struct fm_compare {
+    char left[PATH_MAX];
+    char right[PATH_MAX];
+    fm_cmp_item *items;      // sorted by rel
+    int count;
+    unsigned long counts[FM_CMP_STATES];  // identical files included
+    unsigned long dirs;      // directories read on both sides
+} fm_compare;
+
+// Only the modification time differs, so hashing can tell whether the content does
+int fm_cmp_hashable(const fm_cmp_item *it);
+
+// Compare the trees below left and right. Directories present on both sides are read one
+// level at a time by a worker pool (readdir + fstatat on each side, merged by name); files
+// of the same type and size are equal when their mtimes match. A directory on one side only
+// is a single item and is not descended. progress gets directories done out of known.
+// Returns 0 or -1 with errno set; free the result with fm_compare_free
+int fm_compare_run(const char *left, const char *right, fm_compare *out, fm_progress_fn progress, void *ctx);
+
+void fm_compare_free(fm_compare *c);
+
+// Hash both sides of every fm_cmp_hashable item (XXH64 through the checksum cache) and mark
+// equal content as same; returns the number of items hashed
+int fm_compare_hash(fm_compare *c, fm_progress_fn progress, void *ctx);
+
+typedef struct fm_sync_stats {
+    int total;               // operations in the job
+    int done;                // operations completed without error
+    int failed;              // entries that could not be copied or deleted
+    int skipped;             // type conflicts, and operations left when cancelled
+    int first_errno;
+    char first_failed[PATH_MAX];
+    unsigned long long bytes;
+} fm_sync_stats;
+
+// Make the right tree match the left one on a background thread: copy what is only on the
+// left and replace what differs (mode and mtime preserved, replacements written beside the
+// target and renamed over it); with mirror also delete what is only on the right. Operations
+// are independent and run on a worker pool. Returns 0 if started, -1 with errno set (EBUSY
+// if a sync is running, EINVAL if one root lies inside the other)
+int fm_sync_start(const fm_compare *c, int mirror);
+
+// Current progress in *stats; 1 once the job has finished (and is collected), 0 while
+// running, -1 if no job was started
+int fm_sync_poll(fm_sync_stats *stats);
+
+// Cancel a running sync and wait for it
+void fm_sync_stop(void);
+
+#endif // FM_COMPARE_H
@@ -0,0 +1,60 @@
+#ifndef FM_DUPES_H
+#define FM_DUPES_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+// Bytes hashed at each end of a file before the full-content pass
+#define FM_DUPE_EDGE (64 * 1024)
+
+typedef enum fm_dupe_state {
+    FM_DUPE_PRESENT,
+    FM_DUPE_DELETED,
+    FM_DUPE_LINKED
+} fm_dupe_state;
+
+typedef struct fm_dupe_file {
+    char *path;
+    off_t size;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    uint64_t edge;          // XXH64 of the first and last FM_DUPE_EDGE bytes
+    uint64_t body;          // XXH64 of the bytes between the edges (0 if the edges cover the file)
+    int err;                // errno if the file could not be read
+    fm_dupe_state state;
+} fm_dupe_file;
+
+// files[first .. first + count) hold identical content
+typedef struct fm_dupe_group {
+    int first;
+    int count;
+} fm_dupe_group;
+
+typedef struct fm_dupes {
+    fm_dupe_file *files;    // grouped, largest files first
+    int nfiles;
+    fm_dupe_group *groups;
+    int ngroups;
+    unsigned long scanned;      // regular non-empty files found
+    unsigned long hardlinks;    // extra links to an inode already seen (not reported)
+    unsigned long errors;       // files that could not be read
+    unsigned long long bytes_read;
+    unsigned long long wasted;  // bytes held by every copy but one
+} fm_dupes;
+
+// Progress from the calling thread: stage name, items done, total (0 while unknown)
+typedef void (*fm_dupes_progress_fn)(void *ctx, const char *stage, long done, long total);
+
+// Find files with identical content under root. Candidates are narrowed by size, then by
+// a hash of both edges, and only the survivors are read in full (middle bytes only) by a
+// pool of worker threads. Returns 0 or -1 with errno set; free the result with fm_dupes_free
+int fm_find_dupes(const char *root, fm_dupes *out, fm_dupes_progress_fn progress, void *ctx);
+
+void fm_dupes_free(fm_dupes *d);
+
+// 0 if the file still matches what was hashed (same inode, size and mtime), -1 otherwise
+int fm_dupe_unchanged(const fm_dupe_file *f);
+
+#endif // FM_DUPES_H
@@ -14,6 +14,9 @@ typedef struct fm_entry {
 // Read directory entries into dynamically allocated array; returns count, entries is malloc'd (caller frees)
 int fm_read_dir(const char *path, fm_entry **entries_out);
 
+// Listing order used by fm_read_dir (qsort comparator): directories first, then case-insensitive name
+int fm_entry_cmp(const void *a, const void *b);
+
 // Create directory
 int fm_mkdir(const char *path);
 
@@ -23,9 +26,16 @@ int fm_remove(const char *path);
 // Rename or move
 int fm_rename(const char *oldpath, const char *newpath);
 
+// Atomically replace path with a hard link to target (same filesystem); 0 on success
+int fm_link_replace(const char *target, const char *path);
+
 // Copy file (simple, not preserving metadata)
 int fm_copy_file(const char *src, const char *dst);
 
+// Copy everything from in to out, in the kernel where the platform allows, else through
+// buf; 0 on success, -1 with errno set
+int fm_copy_fd(int in, int out, char *buf, size_t bufsize);
+
 // Create empty file (similar to touch)
 int fm_create_file(const char *path);
 
@@ -36,4 +46,73 @@ int fm_edit_file(const char *path);
 // Caller must free *content_out
 ssize_t fm_read_file(const char *path, char **content_out);
 
+// Bulk operations applied to a set of entries living in one directory
+typedef enum fm_batch_op {
+    FM_BATCH_DELETE,
+    FM_BATCH_MOVE,
+    FM_BATCH_COPY,
+    FM_BATCH_CHMOD
+} fm_batch_op;
+
+// Progress callback: done entries out of total
+typedef void (*fm_progress_fn)(void *ctx, int done, int total);
+
+typedef struct fm_batch {
+    fm_batch_op op;
+    const char *dir;        // directory holding every entry
+    const char *dest;       // destination directory (move/copy)
+    mode_t mode;            // new permission bits (chmod)
+    fm_progress_fn progress;
+    void *progress_ctx;
+} fm_batch;
+
+typedef struct fm_batch_result {
+    int done;               // entries processed successfully
+    int failed;
+    int skipped;            // entries the operation does not apply to
+    int first_errno;        // errno of the first failure
+    char first_failed[512]; // name of the first failed entry
+} fm_batch_result;
+
+// Run one batched job over n entries; directory fds are opened once for the whole set.
+// Returns 0 if every entry succeeded or was skipped, -1 otherwise (details in *res)
+int fm_batch_run(const fm_batch *job, const fm_entry *const *entries, int n, fm_batch_result *res);
+
+// Recursive traversal events
+typedef enum fm_walk_event {
+    FM_WALK_FILE,        // non-directory entry
+    FM_WALK_DIR_PRE,     // directory, before its children
+    FM_WALK_DIR_POST,    // directory, after its children
+    FM_WALK_ERROR        // entry could not be stat'ed or opened (err set)
+} fm_walk_event;
+
+typedef struct fm_walk_entry {
+    const char *path;        // full path
+    const char *name;        // final component, relative to dirfd
+    int dirfd;               // containing directory (AT_FDCWD for the root)
+    const struct stat *st;   // lstat data (NULL if the entry could not be stat'ed)
+    int depth;               // 0 for the root
+    int err;                 // errno for FM_WALK_ERROR
+} fm_walk_entry;
+
+// Walk callback: return 0 to continue, 1 to skip a directory's children (DIR_PRE), -1 to stop
+typedef int (*fm_walk_fn)(void *ctx, fm_walk_event ev, const fm_walk_entry *e);
+
+// Depth-first walk of root without following symlinks; each directory is read once via
+// its fd and children are stat'ed with fstatat. Only the top levels keep their fds open
+// while descending, so deep trees do not run out of descriptors. Returns 0, or -1 if stopped
+// by the callback or if a directory given up on the way down could not be opened again
+// (reported as FM_WALK_ERROR first; ESTALE if it was moved)
+int fm_walk(const char *root, fm_walk_fn fn, void *ctx);
+
+// Per-item report from tree operations: path acted on, bytes copied, errno (0 on success)
+typedef void (*fm_report_fn)(void *ctx, const char *path, off_t bytes, int err);
+
+// Remove path and everything below it; returns 0 if every entry was removed, -1 otherwise
+int fm_remove_tree(const char *path, fm_report_fn report, void *ctx);
+
+// Copy src (file, symlink or directory tree) to dst, preserving permission bits;
+// returns 0 if every entry was copied, -1 otherwise
+int fm_copy_tree(const char *src, const char *dst, fm_report_fn report, void *ctx);
+
 #endif // FM_FS_H
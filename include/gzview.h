@@ -0,0 +1,72 @@
+#ifndef FM_GZVIEW_H
+#define FM_GZVIEW_H
+
+#include <sys/types.h>
+#include <zlib.h>
+
+// Uncompressed distance between decompressor checkpoints; doubled whenever the table fills
+#define FM_GZ_SPAN (1024 * 1024)
+// Most checkpoints kept per file (each holds a 32 KiB window)
+#define FM_GZ_MAX_POINTS 256
+// Uncompressed bytes kept around the last read position
+#define FM_GZ_CACHE (256 * 1024)
+
+#define FM_GZ_WINDOW 32768
+#define FM_GZ_INBUF 65536
+
+// Where inflate can be restarted without decoding what comes before it
+typedef struct fm_gz_point {
+    off_t out;               // uncompressed offset
+    off_t in;                // compressed offset of the first whole byte after the block boundary
+    int bits;                // bits of the byte before in that still belong to the next block
+    int header;              // restart at a gzip member header instead of a deflate block
+    unsigned char *window;   // the min(out, 32K) bytes of output preceding out
+} fm_gz_point;
+
+// Random-access reader over a gzip file (one or more concatenated members). Memory stays
+// bounded by the checkpoint table, the read cache and one inflate state whatever the size
+typedef struct fm_gz {
+    int fd;
+    off_t csize;             // compressed file size
+    off_t size;              // uncompressed size once known
+    int complete;            // the whole file has been decoded once (size is exact)
+    off_t frontier;          // furthest uncompressed offset decoded so far
+    fm_gz_point *points;     // sorted by out; points[0] is the start of the file
+    int npoints;
+    off_t span;
+    // live inflate stream, positioned at out_pos
+    z_stream strm;
+    int live;
+    int raw;                 // restarted mid-member: the trailer has to be skipped by hand
+    int skip;                // trailer bytes left to skip before the next member header
+    int member_out;          // the current member has produced output
+    int eof;
+    off_t in_pos;            // compressed offset of the next byte to read into inbuf
+    off_t out_pos;
+    unsigned char inbuf[FM_GZ_INBUF];
+    unsigned char ring[FM_GZ_WINDOW];  // last 32K of output, indexed by offset % FM_GZ_WINDOW
+    // read cache [cache_off, cache_off + cache_len)
+    unsigned char *cache;
+    off_t cache_off;
+    size_t cache_len;
+} fm_gz;
+
+// Return nonzero to stop a scan
+typedef int (*fm_gz_progress_fn)(void *ctx, off_t in, off_t total);
+
+// Whether a file starts with the gzip magic bytes
+int fm_gz_is_gzip(const char *path);
+
+// Allocate a reader for path; NULL with errno set (EINVAL if it is not gzip)
+fm_gz *fm_gz_open(const char *path);
+void fm_gz_close(fm_gz *gz);
+
+// Read up to len uncompressed bytes at offset, inflating from the nearest checkpoint;
+// returns bytes read (0 past the end) or -1 with errno set (EIO for corrupt data)
+ssize_t fm_gz_pread(fm_gz *gz, void *buf, size_t len, off_t offset);
+
+// Decode to the end of the file, recording checkpoints, so size becomes exact. Returns 0,
+// 1 if progress asked to stop, or -1 with errno set
+int fm_gz_scan(fm_gz *gz, fm_gz_progress_fn progress, void *ctx);
+
+#endif // FM_GZVIEW_H
@@ -0,0 +1,39 @@
+#ifndef FM_HASH_H
+#define FM_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XXH64: fast non-cryptographic 64-bit hash (streaming)
+typedef struct fm_xxh64_state {
+    uint64_t v[4];
+    uint64_t total;
+    uint64_t seed;
+    unsigned char mem[32];
+    unsigned memsize;
+} fm_xxh64_state;
+
+void fm_xxh64_init(fm_xxh64_state *s, uint64_t seed);
+void fm_xxh64_update(fm_xxh64_state *s, const void *data, size_t len);
+uint64_t fm_xxh64_digest(const fm_xxh64_state *s);
+
+// One-shot XXH64 of a buffer
+uint64_t fm_xxh64(const void *data, size_t len, uint64_t seed);
+
+// CRC32C (Castagnoli): start with 0 and pass the previous result to continue.
+// Uses the SSE4.2 crc32 instruction when the CPU has it
+uint32_t fm_crc32c(uint32_t crc, const void *data, size_t len);
+
+// SHA-256 (streaming)
+typedef struct fm_sha256_state {
+    uint32_t h[8];
+    uint64_t total;
+    unsigned char buf[64];
+    unsigned buflen;
+} fm_sha256_state;
+
+void fm_sha256_init(fm_sha256_state *s);
+void fm_sha256_update(fm_sha256_state *s, const void *data, size_t len);
+void fm_sha256_final(fm_sha256_state *s, unsigned char digest[32]);
+
+#endif // FM_HASH_H
@@ -0,0 +1,95 @@
+#ifndef FM_INDEX_H
+#define FM_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "fs.h"
+
+// Persistent metadata index of one volume, laid out for mmap:
+//   header | nodes[header.nodes] | NUL-terminated names
+// Node 0 is the root (its name is the full root path). Nodes are stored breadth-first,
+// so the children of a directory are one contiguous run in listing order.
+
+#define FM_INDEX_VERSION 1
+#define FM_INDEX_NONE UINT32_MAX
+
+typedef struct fm_index_header {
+    char magic[8];           // "FMINDEX"
+    uint32_t version;
+    uint32_t node_size;      // sizeof(fm_index_node) of the writer
+    uint64_t nodes;
+    uint64_t names_size;
+    uint64_t dev;            // device of the indexed volume
+    int64_t built;           // time() of the build
+} fm_index_header;
+
+typedef struct fm_index_node {
+    uint32_t parent;         // FM_INDEX_NONE for the root
+    uint32_t name;           // offset into the name table
+    uint32_t first_child;    // directories: children are [first_child, first_child + nchildren)
+    uint32_t nchildren;
+    uint32_t mode, nlink, uid, gid;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    uint32_t mtime_nsec;
+    uint32_t reserved;
+} fm_index_node;
+
+// A mapped index (read-only)
+typedef struct fm_index {
+    void *map;
+    size_t map_size;
+    const fm_index_header *hdr;
+    const fm_index_node *nodes;
+    const char *names;
+} fm_index;
+
+typedef struct fm_index_stats {
+    unsigned long dirs;      // directories in the new index
+    unsigned long reused;    // directories whose children were copied from the old index
+    unsigned long scanned;   // directories read from disk
+    unsigned long errors;    // directories that could not be read
+    unsigned long nodes;
+} fm_index_stats;
+
+// Index file location: $FM_INDEX_FILE, else $XDG_CACHE_HOME/filemgr/index or
+// ~/.cache/filemgr/index; missing directories are created when create is set. Returns 0 on success
+int fm_index_default_file(char *buf, size_t size, int create);
+
+// Map an index file; returns 0 or -1 with errno set (EINVAL for a foreign or corrupt file)
+int fm_index_open(fm_index *ix, const char *file);
+void fm_index_close(fm_index *ix);
+
+// Name of a node, and its full path; fm_index_path returns 0 or -1 if buf is too small
+const char *fm_index_name(const fm_index *ix, uint32_t id);
+int fm_index_path(const fm_index *ix, uint32_t id, char *buf, size_t size);
+
+// Node id of the directory at an absolute, canonical path; FM_INDEX_NONE if not indexed
+uint32_t fm_index_find_dir(const fm_index *ix, const char *path);
+
+// Build a directory listing from the index the way fm_read_dir would (caller frees);
+// *mtime receives the directory mtime recorded at index time. Returns count or -1
+int fm_index_listing(const fm_index *ix, uint32_t dir, fm_entry **entries_out, struct timespec *mtime);
+
+// Scan the name table: a pattern with * ? or [ is a glob, anything else a case-insensitive
+// substring. Stores up to max node ids in out; returns the number of matches found
+int fm_index_search(const fm_index *ix, const char *pattern, uint32_t *out, int max);
+
+// Build or refresh the index of root into file. Directories whose mtime and inode match the
+// existing index keep their recorded children (only subdirectories are re-stat'ed); others
+// are read again. The new file replaces the old one atomically. Returns 0 or -1
+int fm_index_build(const char *file, const char *root, fm_index_stats *stats);
+
+// Run fm_index_build on a background thread
+int fm_index_refresh_start(const char *file, const char *root);
+
+// 1 once a background refresh has finished successfully (reopen the index), -1 if it
+// failed, 0 while running or idle
+int fm_index_refresh_poll(void);
+
+// Cancel a running refresh and wait for the thread
+void fm_index_refresh_stop(void);
+
+#endif // FM_INDEX_H
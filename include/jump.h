@@ -0,0 +1,55 @@
+#ifndef FM_JUMP_H
+#define FM_JUMP_H
+
+#include <stddef.h>
+#include <time.h>
+
+// Visited directories ranked by frecency (how often and how recently), kept in a small text
+// file of "rank<TAB>last visit<TAB>path" lines
+
+#define FM_JUMP_MAX_RANK 5000.0      // total rank above which every rank is aged by 10%
+#define FM_JUMP_MAX_ENTRIES 1000
+
+typedef struct fm_jump_entry {
+    char *path;
+    double rank;                     // visit count, aged
+    time_t last;                     // time of the last visit
+} fm_jump_entry;
+
+typedef struct fm_jumps {
+    fm_jump_entry *items;
+    int count, cap;
+    double total;                    // sum of ranks
+    int dirty;                       // changed since load/save
+} fm_jumps;
+
+// Database location: $FM_JUMP_FILE, else $XDG_CACHE_HOME/filemgr/jumps or ~/.cache/filemgr/jumps;
+// missing directories are created when create is set. Returns 0 on success
+int fm_jump_default_file(char *buf, size_t size, int create);
+
+// Read a database (a missing file is an empty one); returns 0 or -1 with errno set
+int fm_jump_load(fm_jumps *db, const char *file);
+
+// Write the database beside file and rename it into place; returns 0 or -1 with errno set
+int fm_jump_save(fm_jumps *db, const char *file);
+
+void fm_jump_free(fm_jumps *db);
+
+// Count a visit to an absolute directory path; ranks are aged once the total grows too large
+void fm_jump_visit(fm_jumps *db, const char *path, time_t now);
+
+// Drop a directory (e.g. one that no longer exists); indices of other entries may change
+void fm_jump_forget(fm_jumps *db, const char *path);
+
+// Rank weighted by recency: x4 within an hour, x2 within a day, /2 within a week, /4 after
+double fm_jump_frecency(const fm_jump_entry *e, time_t now);
+
+// Entries matching query, best first, as indices into db->items. query is split on spaces
+// and each word must appear in the path as a case-insensitive subsequence, in order; paths
+// whose last component holds the last word rank higher (x4 as a substring, x2 as a
+// subsequence). Only the cand entries are considered (all when cand is NULL), so a longer
+// query can refine the previous result. out needs room for every candidate and may be cand.
+// Returns the number of matches or -1 with errno set
+int fm_jump_match(const fm_jumps *db, const char *query, time_t now, const int *cand, int ncand, int *out);
+
+#endif // FM_JUMP_H
@@ -0,0 +1,62 @@
+#ifndef FM_PERF_H
+#define FM_PERF_H
+
+// Instrumentation counters for the scan, name lookup, render and output paths.
+// Counting is off until fm_perf_enabled is set (one predictable branch per site);
+// building with -DFM_NO_PERF removes the counting sites entirely. The flag is per
+// thread, so background workers never touch the frame counters.
+
+typedef struct fm_perf {
+    unsigned long long scan_ns;     // readdir + lstat in fm_read_dir / fm_walk
+    unsigned long long sort_ns;     // listing sort
+    unsigned long long render_ns;   // draw_list / viewer drawing into curses windows
+    unsigned long long output_ns;   // doupdate/refresh (terminal output)
+    unsigned long long load_ns;     // viewer file load + line split
+    unsigned long long term_bytes;  // bytes written to the terminal
+    unsigned long entries;          // directory entries read
+    unsigned long stat_calls;       // lstat/fstatat calls
+    unsigned long name_lookups;     // getpwuid/getgrgid calls (id cache misses)
+    unsigned long name_hits;        // id cache hits
+    unsigned long dir_hits;         // directory cache hits
+    unsigned long dir_misses;       // directory cache scans
+    unsigned long rows;             // list/viewer rows drawn
+} fm_perf;
+
+extern _Thread_local int fm_perf_enabled;
+extern fm_perf fm_perf_frame;       // counters of the frame in progress
+
+#ifndef FM_NO_PERF
+#define FM_PERF_ADD(field, n) \
+    do { if (fm_perf_enabled) fm_perf_frame.field += (n); } while (0)
+#define FM_PERF_START(var) \
+    unsigned long long var = fm_perf_enabled ? fm_perf_now() : 0
+#define FM_PERF_STOP(var, field) \
+    do { if (fm_perf_enabled) fm_perf_frame.field += fm_perf_now() - (var); } while (0)
+#else
+#define FM_PERF_ADD(field, n) ((void)0)
+#define FM_PERF_START(var) ((void)0)
+#define FM_PERF_STOP(var, field) ((void)0)
+#endif
+
+// Monotonic clock in nanoseconds
+unsigned long long fm_perf_now(void);
+
+// Append one line per frame to path (also enables counting); returns 0 on success
+int fm_perf_open_log(const char *path);
+
+// Close the log file
+void fm_perf_close_log(void);
+
+// Finish the current frame: add it to the totals, log it under op and copy it to *last
+void fm_perf_end_frame(const char *op, fm_perf *last);
+
+// Totals since start; *frames receives the number of frames recorded
+const fm_perf *fm_perf_totals(unsigned long *frames);
+
+// Current resident set size in KB (peak RSS where unavailable)
+long fm_perf_rss_kb(void);
+
+// Bytes written by this process so far, -1 if unknown (Linux /proc/self/io)
+long long fm_perf_wchar(void);
+
+#endif // FM_PERF_H
@@ -0,0 +1,15 @@
+#ifndef FM_POOL_H
+#define FM_POOL_H
+
+#include <stddef.h>
+#include "fs.h"
+
+// One unit of work: job index and the worker's scratch buffer (NULL if it could not be allocated)
+typedef void (*fm_job_fn)(void *ctx, int i, void *buf);
+
+// Run fn for every index in [0, n) on a small pool of worker threads, each with its own
+// page-aligned scratch buffer of bufsize bytes. Blocks until all jobs are done; progress
+// is called from the calling thread while the workers run
+void fm_pool_run(int n, fm_job_fn fn, void *ctx, size_t bufsize, fm_progress_fn progress, void *pctx);
+
+#endif // FM_POOL_H
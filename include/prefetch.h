@@ -0,0 +1,48 @@
+#ifndef FM_PREFETCH_H
+#define FM_PREFETCH_H
+
+#include <limits.h>
+#include <time.h>
+#include "fs.h"
+
+// Background loader for the highlighted entry and its neighbours. Requests are debounced
+// while they keep changing, entries no longer wanted are dropped before they start, and
+// finished results stay available until their slot is reused.
+
+typedef struct fm_preview {
+    char path[PATH_MAX];
+    int is_dir;
+    int err;                    // errno if loading failed
+    fm_entry *entries;          // directory: sorted listing
+    int count;
+    struct timespec mtime;      // directory mtime taken before the listing was read
+    char *text;                 // file: first bytes
+    size_t len;
+    int binary;                 // file contains NUL bytes
+} fm_preview;
+
+// Start the loader thread; returns 0 on success
+int fm_prefetch_start(void);
+
+// Stop the loader thread and free every result
+void fm_prefetch_stop(void);
+
+// Replace the wanted set, most important first. Loading starts once the set has not
+// changed for the debounce interval
+void fm_prefetch_want(const char *const *paths, const int *is_dir, int n);
+
+// Finished result for path, NULL if not loaded (yet); valid until the next fm_prefetch_want
+// or fm_prefetch_take_dir call
+const fm_preview *fm_prefetch_lookup(const char *path);
+
+// Hand over a prefetched directory listing (caller owns entries); 0 if one was ready and
+// read recently enough to be trusted (a listing does not show files edited in place later)
+int fm_prefetch_take_dir(const char *path, fm_entry **entries, int *count, struct timespec *mtime);
+
+// Completion counter: changes whenever a new result becomes available
+unsigned long fm_prefetch_seq(void);
+
+// Nonzero while wanted entries are still waiting or loading
+int fm_prefetch_busy(void);
+
+#endif // FM_PREFETCH_H
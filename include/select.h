@@ -0,0 +1,44 @@
+#ifndef FM_SELECT_H
+#define FM_SELECT_H
+
+#include "fs.h"
+
+// Selection set over the current listing, one bit per entry index
+typedef struct fm_selection {
+    unsigned long *bits;
+    int nbits;    // number of listing slots covered
+    int count;    // number of marked entries
+    int anchor;   // index of the last toggled entry, -1 if none
+} fm_selection;
+
+// Initialize an empty selection (no allocation)
+void fm_sel_init(fm_selection *s);
+
+// Release the bitmap
+void fm_sel_free(fm_selection *s);
+
+// Resize to cover n entries; all marks are cleared. Returns 0 on success, -1 on error
+int fm_sel_resize(fm_selection *s, int n);
+
+// Clear all marks but keep the bitmap
+void fm_sel_clear(fm_selection *s);
+
+// Return non-zero if entry i is marked
+int fm_sel_test(const fm_selection *s, int i);
+
+// Toggle entry i and make it the range anchor ("..": ignored)
+void fm_sel_toggle(fm_selection *s, const fm_entry *items, int i);
+
+// Mark every entry between the anchor and i (inclusive)
+void fm_sel_range(fm_selection *s, const fm_entry *items, int i);
+
+// Invert all marks
+void fm_sel_invert(fm_selection *s, const fm_entry *items);
+
+// Mark entries whose name matches a shell glob; returns number newly marked
+int fm_sel_match(fm_selection *s, const fm_entry *items, const char *pattern);
+
+// Return the first marked index >= from, or -1 when there is none
+int fm_sel_next(const fm_selection *s, int from);
+
+#endif // FM_SELECT_H
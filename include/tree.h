@@ -0,0 +1,56 @@
+#ifndef FM_TREE_H
+#define FM_TREE_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+// One entry of the tree; a directory's children are one array, read on first expansion
+typedef struct fm_tree_node {
+    char *name;                      // full path for the root
+    struct fm_tree_node *parent;
+    struct fm_tree_node *children;   // listing order (directories first, then by name)
+    int nchildren;
+    int depth;                       // 0 for the root
+    int loaded;                      // children have been read
+    int expanded;
+    int err;                         // errno of the last failed read
+    mode_t mode;                     // lstat data; symlinks to directories are not expanded
+    off_t size;
+    time_t mtime;
+} fm_tree_node;
+
+// Visible rows in display order, kept in a gap buffer: rows [0, gap) are stored first and
+// the rest after gaplen unused slots, so inserting or removing the children of a row only
+// moves the gap there and touches those rows
+typedef struct fm_tree {
+    fm_tree_node root;
+    fm_tree_node **rows;
+    int nrows;
+    int gap, gaplen;
+    unsigned long reads;             // directories read from disk
+} fm_tree;
+
+// Start a tree at root (expanded); returns 0 or -1 with errno set
+int fm_tree_init(fm_tree *t, const char *root);
+void fm_tree_free(fm_tree *t);
+
+fm_tree_node *fm_tree_row(const fm_tree *t, int row);
+
+// Show the children of the directory at row, reading them only the first time; descendants
+// expanded before a collapse come back as they were. Returns rows added or -1 with errno set
+int fm_tree_expand(fm_tree *t, int row);
+
+// Hide everything below row (the loaded subtree is kept); returns rows removed
+int fm_tree_collapse(fm_tree *t, int row);
+
+// Read the directory at row again, dropping its cached subtree; returns 0 or -1
+int fm_tree_reload(fm_tree *t, int row);
+
+// Row of the nearest visible ancestor of row, -1 for the root
+int fm_tree_parent_row(const fm_tree *t, int row);
+
+// Full path of a node; 0, or -1 if buf is too small
+int fm_tree_path(const fm_tree_node *n, char *buf, size_t size);
+
+#endif // FM_TREE_H
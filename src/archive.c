@@ -0,0 +1,522 @@
+#define _XOPEN_SOURCE 700
+#include "archive.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TAR_BLOCK 512
+/* Unreferenced archive indexes kept for quick re-entry */
+#define TAR_IDLE_MAX 4
+
+static fm_tar *archives;      /* most recently used first */
+
+int fm_tar_is_archive(const char *name) {
+    size_t len = strlen(name);
+    return len > 4 && strcasecmp(name + len - 4, ".tar") == 0;
+}
+
+/* ---- header parsing ---- */
+
+/* Numeric header field: octal text, or base-256 (GNU) when the high bit is set; -1 for a
+ * negative base-256 value or one that does not fit in a long long */
+static long long tar_num(const unsigned char *f, size_t len) {
+    if (f[0] & 0x80) {
+        if (f[0] & 0x40) return -1;
+        unsigned long long u = f[0] & 0x3f;
+        for (size_t i = 1; i < len; ++i) {
+            if (u > (unsigned long long)LLONG_MAX >> 8) return -1;
+            u = (u << 8) | f[i];
+        }
+        return (long long)u;
+    }
+    long long v = 0;
+    size_t i = 0;
+    while (i < len && (f[i] == ' ' || f[i] == '\0')) i++;
+    for (; i < len && f[i] >= '0' && f[i] <= '7'; ++i) v = v * 8 + (f[i] - '0');
+    return v;
+}
+
+static int checksum_ok(const unsigned char *h) {
+    long long want = tar_num(h + 148, 8);
+    unsigned long usum = 0;
+    long ssum = 0;
+    for (int i = 0; i < TAR_BLOCK; ++i) {
+        unsigned char c = (i >= 148 && i < 156) ? ' ' : h[i];
+        usum += c;
+        ssum += (signed char)c;
+    }
+    /* Some old writers summed signed bytes */
+    return want == (long long)usum || want == (long long)ssum;
+}
+
+static int all_zero(const unsigned char *h) {
+    for (int i = 0; i < TAR_BLOCK; ++i) {
+        if (h[i]) return 0;
+    }
+    return 1;
+}
+
+static ssize_t pread_full(int fd, void *buf, size_t len, off_t off) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t r = pread(fd, (char *)buf + done, len - done, off + done);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (r == 0) break;
+        done += r;
+    }
+    return done;
+}
+
+/* Read a long-name or pax payload; NUL-terminated, caller frees */
+static char *read_payload(int fd, off_t off, long long size) {
+    if (size < 0 || size > 16 * 1024 * 1024) { errno = EINVAL; return NULL; }
+    char *buf = malloc(size + 1);
+    if (!buf) return NULL;
+    if (pread_full(fd, buf, size, off) != size) {
+        free(buf);
+        errno = EINVAL;
+        return NULL;
+    }
+    buf[size] = '\0';
+    return buf;
+}
+
+/* Overrides collected from pax ('x') and GNU long-name ('L', 'K') entries for the next member */
+typedef struct tar_pending {
+    char *path, *link;
+    long long size, mtime, uid, gid;   /* -1 when not overridden */
+} tar_pending;
+
+static void pending_clear(tar_pending *p) {
+    free(p->path);
+    free(p->link);
+    p->path = p->link = NULL;
+    p->size = p->mtime = p->uid = p->gid = -1;
+}
+
+/* "<len> <key>=<value>\n" records */
+static void parse_pax(const char *data, size_t len, tar_pending *p) {
+    const char *end = data + len;
+    while (data < end) {
+        char *sp;
+        long rl = strtol(data, &sp, 10);
+        if (rl <= 0 || *sp != ' ' || rl > end - data) break;
+        const char *key = sp + 1, *rec_end = data + rl - 1;   /* rec_end points at '\n' */
+        const char *eq = memchr(key, '=', rec_end - key);
+        if (eq) {
+            size_t kl = eq - key, vl = rec_end - (eq + 1);
+            char *val = strndup(eq + 1, vl);
+            if (val) {
+                if (kl == 4 && memcmp(key, "path", 4) == 0) { free(p->path); p->path = val; val = NULL; }
+                else if (kl == 8 && memcmp(key, "linkpath", 8) == 0) { free(p->link); p->link = val; val = NULL; }
+                else if (kl == 4 && memcmp(key, "size", 4) == 0) p->size = strtoll(val, NULL, 10);
+                else if (kl == 5 && memcmp(key, "mtime", 5) == 0) p->mtime = strtoll(val, NULL, 10);
+                else if (kl == 3 && memcmp(key, "uid", 3) == 0) p->uid = strtoll(val, NULL, 10);
+                else if (kl == 3 && memcmp(key, "gid", 3) == 0) p->gid = strtoll(val, NULL, 10);
+                free(val);
+            }
+        }
+        data += rl;
+    }
+}
+
+/* Strip leading "/" and "./" and trailing "/"; NULL for names that cannot be listed
+ * (empty, or with "." / ".." components) */
+static char *clean_name(const char *raw) {
+    while (*raw == '/' || (raw[0] == '.' && raw[1] == '/')) raw += raw[0] == '/' ? 1 : 2;
+    size_t len = strlen(raw);
+    while (len > 0 && raw[len - 1] == '/') len--;
+    if (len == 0) return NULL;
+    for (const char *c = raw; c < raw + len; ) {
+        size_t cl = strcspn(c, "/");
+        if (cl > (size_t)(raw + len - c)) cl = raw + len - c;
+        if (cl == 0 || (cl == 1 && c[0] == '.') || (cl == 2 && c[0] == '.' && c[1] == '.')) return NULL;
+        c += cl + 1;
+    }
+    return strndup(raw, len);
+}
+
+static mode_t type_bits(char type) {
+    switch (type) {
+    case '2': return S_IFLNK;
+    case '3': return S_IFCHR;
+    case '4': return S_IFBLK;
+    case '5': return S_IFDIR;
+    case '6': return S_IFIFO;
+    default:  return S_IFREG;
+    }
+}
+
+/* Byte order in which '/' sorts before every other character, so a directory's
+ * descendants follow it contiguously ("a", "a/x", "a.txt") */
+static int path_cmp(const char *a, const char *b) {
+    for (;; ++a, ++b) {
+        unsigned char ca = *a == '/' ? 1 : (unsigned char)*a;
+        unsigned char cb = *b == '/' ? 1 : (unsigned char)*b;
+        if (ca != cb || !ca) return ca - cb;
+    }
+}
+
+static int member_cmp(const void *pa, const void *pb) {
+    const fm_tar_member *a = pa, *b = pb;
+    int c = path_cmp(a->name, b->name);
+    if (c) return c;
+    return a->offset < b->offset ? -1 : a->offset > b->offset;
+}
+
+static void free_members(fm_tar_member *m, int n) {
+    for (int i = 0; i < n; ++i) {
+        free(m[i].name);
+        free(m[i].link);
+    }
+    free(m);
+}
+
+/* One pass over the headers; member data is skipped, never read */
+static int scan(fm_tar *t, int fd, off_t archive_size) {
+    unsigned char h[TAR_BLOCK];
+    off_t off = 0;
+    int cap = 0, rc = 0, ended = 0;
+    tar_pending pend = { NULL, NULL, -1, -1, -1, -1 };
+
+    while (off + TAR_BLOCK <= archive_size) {
+        if (pread_full(fd, h, TAR_BLOCK, off) != TAR_BLOCK) { rc = -1; break; }
+        if (all_zero(h)) { ended = 1; break; }
+        if (!checksum_ok(h)) {
+            /* Garbage after valid members is treated as the end; garbage first is not a tar */
+            if (t->count == 0) { errno = EINVAL; rc = -1; }
+            break;
+        }
+        char type = h[156];
+        long long size = pend.size >= 0 ? pend.size : tar_num(h + 124, 12);
+        long long mode = tar_num(h + 100, 8), uid = tar_num(h + 108, 8);
+        long long gid = tar_num(h + 116, 8), mtime = tar_num(h + 136, 12);
+        off_t data = off + TAR_BLOCK;
+        if (size < 0 || mode < 0 || uid < 0 || gid < 0 || mtime < 0 || size > archive_size - data) {
+            /* A field that does not decode is a corrupt header; a truncated archive still
+             * lists the members before the cut */
+            if (t->count == 0) { errno = EINVAL; rc = -1; }
+            break;
+        }
+        off = data + (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+
+        if (type == 'L' || type == 'K') {
+            char *s = read_payload(fd, data, size);
+            if (!s) { rc = -1; break; }
+            if (type == 'L') { free(pend.path); pend.path = s; }
+            else { free(pend.link); pend.link = s; }
+            pend.size = -1;
+            continue;
+        }
+        if (type == 'x') {
+            char *s = read_payload(fd, data, size);
+            if (!s) { rc = -1; break; }
+            pend.size = -1;
+            parse_pax(s, size, &pend);
+            free(s);
+            continue;
+        }
+        if (type == 'g' || type == 'V') {
+            pend.size = -1;
+            continue;
+        }
+
+        /* ustar splits long paths into prefix "/" name */
+        char raw[256 + 2 + 100];
+        if (pend.path) {
+            raw[0] = '\0';
+        } else if (memcmp(h + 257, "ustar", 5) == 0 && h[345]) {
+            snprintf(raw, sizeof(raw), "%.155s/%.100s", (const char *)h + 345, (const char *)h);
+        } else {
+            snprintf(raw, sizeof(raw), "%.100s", (const char *)h);
+        }
+        char *name = clean_name(pend.path ? pend.path : raw);
+        if (!name) { pending_clear(&pend); continue; }
+
+        if (t->count == cap) {
+            int ncap = cap ? cap * 2 : 256;
+            fm_tar_member *nm = realloc(t->members, ncap * sizeof(*nm));
+            if (!nm) { free(name); rc = -1; break; }
+            t->members = nm;
+            cap = ncap;
+        }
+        fm_tar_member *m = &t->members[t->count++];
+        memset(m, 0, sizeof(*m));
+        m->name = name;
+        m->offset = data;
+        m->hardlink = type == '1';
+        if (type == '1' || type == '2') {
+            if (pend.link) { m->link = pend.link; pend.link = NULL; }
+            else m->link = strndup((const char *)h + 157, 100);
+        }
+        m->st.st_mode = type_bits(type) | (mode & 07777);
+        m->st.st_size = S_ISREG(m->st.st_mode) && !m->hardlink ? size : 0;
+        m->st.st_uid = pend.uid >= 0 ? pend.uid : uid;
+        m->st.st_gid = pend.gid >= 0 ? pend.gid : gid;
+        m->st.st_mtim.tv_sec = pend.mtime >= 0 ? pend.mtime : mtime;
+        m->st.st_nlink = 1;
+        m->st.st_dev = t->dev;
+        pending_clear(&pend);
+    }
+    pending_clear(&pend);
+    /* An empty archive still has its end-of-archive block */
+    if (rc == 0 && t->count == 0 && !ended) { errno = EINVAL; rc = -1; }
+    if (rc != 0) return -1;
+
+    /* Later copies of a name replace earlier ones, as on extraction */
+    if (t->count > 1) qsort(t->members, t->count, sizeof(*t->members), member_cmp);
+    int out = 0;
+    for (int i = 0; i < t->count; ++i) {
+        if (i + 1 < t->count && strcmp(t->members[i].name, t->members[i + 1].name) == 0) {
+            free(t->members[i].name);
+            free(t->members[i].link);
+            continue;
+        }
+        t->members[out++] = t->members[i];
+    }
+    t->count = out;
+    /* Show hard links with the size of the data they share */
+    for (int i = 0; i < t->count; ++i) {
+        fm_tar_member *m = &t->members[i];
+        char *target = m->hardlink && m->link ? clean_name(m->link) : NULL;
+        int j = target ? fm_tar_find(t, target) : -1;
+        if (j >= 0) m->st.st_size = t->members[j].st.st_size;
+        free(target);
+    }
+    return 0;
+}
+
+static void free_tar(fm_tar *t) {
+    free_members(t->members, t->count);
+    free(t);
+}
+
+static void evict_idle(void) {
+    int idle = 0;
+    fm_tar **pp = &archives;
+    while (*pp) {
+        fm_tar *t = *pp;
+        if (t->refs == 0 && ++idle > TAR_IDLE_MAX) {
+            *pp = t->next;
+            free_tar(t);
+        } else {
+            pp = &t->next;
+        }
+    }
+}
+
+static int same_version(const fm_tar *t, const struct stat *st) {
+    return t->dev == st->st_dev && t->ino == st->st_ino &&
+           t->mtime.tv_sec == st->st_mtim.tv_sec && t->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+fm_tar *fm_tar_get(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return NULL; }
+    if (!S_ISREG(st.st_mode)) { close(fd); errno = EINVAL; return NULL; }
+
+    fm_tar **pp = &archives;
+    for (; *pp; pp = &(*pp)->next) {
+        if (same_version(*pp, &st)) break;
+    }
+    fm_tar *t = *pp;
+    if (t) {
+        close(fd);
+        *pp = t->next;
+        t->next = archives;
+        archives = t;
+        t->refs++;
+        return t;
+    }
+
+    if (!(t = calloc(1, sizeof(*t)))) { close(fd); return NULL; }
+    snprintf(t->path, sizeof(t->path), "%s", path);
+    t->dev = st.st_dev;
+    t->ino = st.st_ino;
+    t->mtime = st.st_mtim;
+#ifdef POSIX_FADV_RANDOM
+    /* Headers are read one block at a time between skipped member data */
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+#endif
+    int rc = scan(t, fd, st.st_size);
+    close(fd);
+    if (rc != 0) {
+        int saved = errno;
+        free_tar(t);
+        errno = saved;
+        return NULL;
+    }
+    t->refs = 1;
+    t->next = archives;
+    archives = t;
+    evict_idle();
+    return t;
+}
+
+void fm_tar_release(fm_tar *t) {
+    if (!t) return;
+    if (t->refs > 0) t->refs--;
+    if (t->refs == 0) evict_idle();
+}
+
+void fm_tar_shutdown(void) {
+    fm_tar **pp = &archives;
+    while (*pp) {
+        fm_tar *t = *pp;
+        if (t->refs == 0) {
+            *pp = t->next;
+            free_tar(t);
+        } else {
+            pp = &t->next;
+        }
+    }
+}
+
+/* First member not ordered before key */
+static int lower_bound(const fm_tar *t, const char *key) {
+    int lo = 0, hi = t->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (path_cmp(t->members[mid].name, key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int fm_tar_find(const fm_tar *t, const char *name) {
+    int i = lower_bound(t, name);
+    return i < t->count && strcmp(t->members[i].name, name) == 0 ? i : -1;
+}
+
+static int add_entry(fm_entry **arr, int *n, int *cap) {
+    if (*n < *cap) return 0;
+    int ncap = *cap ? *cap * 2 : 64;
+    fm_entry *na = realloc(*arr, ncap * sizeof(*na));
+    if (!na) return -1;
+    *arr = na;
+    *cap = ncap;
+    return 0;
+}
+
+int fm_tar_list(const fm_tar *t, const char *dir, fm_entry **entries_out) {
+    char prefix[PATH_MAX];
+    size_t pl = 0;
+    if (*dir) {
+        int self = fm_tar_find(t, dir);
+        if (self >= 0 && !S_ISDIR(t->members[self].st.st_mode)) { errno = ENOTDIR; return -1; }
+        if (snprintf(prefix, sizeof(prefix), "%s/", dir) >= (int)sizeof(prefix)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        pl = strlen(prefix);
+    } else {
+        prefix[0] = '\0';
+    }
+    int first = lower_bound(t, prefix);
+    if (*dir && (first >= t->count || strncmp(t->members[first].name, prefix, pl) != 0) &&
+        fm_tar_find(t, dir) < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    fm_entry *arr = NULL;
+    int n = 0, cap = 0;
+    if (add_entry(&arr, &n, &cap) != 0) return -1;
+    fm_entry *up = &arr[n++];
+    memset(up, 0, sizeof(*up));
+    snprintf(up->name, sizeof(up->name), "..");
+    if (*dir) {
+        const char *slash = strrchr(dir, '/');
+        if (snprintf(up->path, sizeof(up->path), "%s%s%.*s", t->path, slash ? "/" : "",
+                     slash ? (int)(slash - dir) : 0, dir) >= (int)sizeof(up->path)) {
+            free(arr);
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+    } else {
+        /* Leaving the archive root goes back to the directory holding it */
+        const char *slash = strrchr(t->path, '/');
+        if (!slash) snprintf(up->path, sizeof(up->path), ".");
+        else if (slash == t->path) snprintf(up->path, sizeof(up->path), "/");
+        else snprintf(up->path, sizeof(up->path), "%.*s", (int)(slash - t->path), t->path);
+    }
+    up->st.st_mode = S_IFDIR | 0755;
+    up->st.st_nlink = 1;
+    up->st.st_mtim = t->mtime;
+    up->is_dir = 1;
+
+    /* Descendants of dir are contiguous; members of a subdirectory follow its name, so
+     * directories without their own header are emitted once */
+    for (int i = first; i < t->count && strncmp(t->members[i].name, prefix, pl) == 0; ++i) {
+        const fm_tar_member *m = &t->members[i];
+        const char *rest = m->name + pl;
+        size_t cl = strcspn(rest, "/");
+        if (n > 1 && strlen(arr[n - 1].name) == cl && strncmp(arr[n - 1].name, rest, cl) == 0) continue;
+        if (add_entry(&arr, &n, &cap) != 0) { free(arr); return -1; }
+        fm_entry *e = &arr[n++];
+        memset(e, 0, sizeof(*e));
+        snprintf(e->name, sizeof(e->name), "%.*s", (int)cl, rest);
+        if (snprintf(e->path, sizeof(e->path), "%s/%.*s", t->path, (int)(pl + cl), m->name) >=
+            (int)sizeof(e->path)) {
+            free(arr);
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        if (rest[cl] == '\0') {
+            e->st = m->st;
+        } else {
+            e->st.st_mode = S_IFDIR | 0755;
+            e->st.st_nlink = 1;
+            e->st.st_dev = t->dev;
+            e->st.st_mtim = t->mtime;
+        }
+        e->is_dir = S_ISDIR(e->st.st_mode);
+    }
+    qsort(arr, n, sizeof(*arr), fm_entry_cmp);
+    *entries_out = arr;
+    return n;
+}
+
+ssize_t fm_tar_read(const fm_tar *t, int member, size_t max, char **content_out) {
+    if (member < 0 || member >= t->count) { errno = ENOENT; return -1; }
+    const fm_tar_member *m = &t->members[member];
+    if (m->hardlink) {
+        /* A hard link's data is stored with the member it points to */
+        char *target = m->link ? clean_name(m->link) : NULL;
+        int i = target ? fm_tar_find(t, target) : -1;
+        free(target);
+        if (i < 0 || t->members[i].hardlink) { errno = ENOENT; return -1; }
+        m = &t->members[i];
+    }
+    if (!S_ISREG(m->st.st_mode)) { errno = EINVAL; return -1; }
+
+    int fd = open(t->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !same_version(t, &st)) {
+        /* Offsets are only valid for the archive version that was indexed */
+        close(fd);
+        errno = ESTALE;
+        return -1;
+    }
+    size_t len = (size_t)m->st.st_size < max ? (size_t)m->st.st_size : max;
+    char *buf = malloc(len + 1);
+    if (!buf) { close(fd); return -1; }
+    ssize_t r = pread_full(fd, buf, len, m->offset);
+    close(fd);
+    if (r < 0) { free(buf); return -1; }
+    buf[r] = '\0';
+    *content_out = buf;
+    return r;
+}
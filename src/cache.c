@@ -0,0 +1,308 @@
+#define _XOPEN_SOURCE 700
+#include "cache.h"
+#include "perf.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <grp.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+/* Unreferenced listings kept around for quick back-navigation */
+#define DIRCACHE_IDLE_MAX 32
+
+#define IDCACHE_SIZE 256   /* power of two */
+
+typedef struct id_slot {
+    int used;
+    unsigned id;
+    char name[32];
+} id_slot;
+
+static fm_dirlist *lists;      /* most recently used first */
+static int watch_fd = -1;
+static id_slot users[IDCACHE_SIZE];
+static id_slot groups[IDCACHE_SIZE];
+
+#ifdef __linux__
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                    IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF)
+#endif
+
+static void add_watch(fm_dirlist *l) {
+    l->wd = -1;
+#ifdef __linux__
+    if (watch_fd >= 0) l->wd = inotify_add_watch(watch_fd, l->path, WATCH_MASK | IN_ONLYDIR);
+#endif
+}
+
+/* Listings of the same directory under two paths (e.g. through a symlink) share one watch
+ * descriptor, since inotify hands back the existing wd for an inode; it is removed only with
+ * the last of them */
+#ifdef __linux__
+static int wd_shared(const fm_dirlist *l) {
+    for (const fm_dirlist *o = lists; o; o = o->next) {
+        if (o != l && o->wd == l->wd) return 1;
+    }
+    return 0;
+}
+#endif
+
+static void rm_watch(fm_dirlist *l) {
+#ifdef __linux__
+    if (watch_fd >= 0 && l->wd >= 0 && !wd_shared(l)) inotify_rm_watch(watch_fd, l->wd);
+#endif
+    l->wd = -1;
+}
+
+static int dir_mtime(const char *path, struct timespec *out) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    *out = st.st_mtim;
+    return 0;
+}
+
+static int scan(fm_dirlist *l) {
+    fm_entry *entries = NULL;
+    FM_PERF_ADD(dir_misses, 1);
+    /* Take the mtime before reading so a concurrent change is never missed */
+    if (dir_mtime(l->path, &l->mtime) != 0) return -1;
+    int n = fm_read_dir(l->path, &entries);
+    if (n < 0) return -1;
+    free(l->entries);
+    l->entries = entries;
+    l->count = n;
+    l->stale = 0;
+    l->provisional = 0;
+    l->gen++;
+    return 0;
+}
+
+static void free_list(fm_dirlist *l) {
+    rm_watch(l);
+    free(l->entries);
+    free(l);
+}
+
+/* Keep at most DIRCACHE_IDLE_MAX unreferenced listings, dropping the oldest */
+static void evict_idle(void) {
+    int idle = 0;
+    fm_dirlist **pp = &lists;
+    while (*pp) {
+        fm_dirlist *l = *pp;
+        if (l->refs == 0 && (l->stale || ++idle > DIRCACHE_IDLE_MAX)) {
+            *pp = l->next;
+            free_list(l);
+        } else {
+            pp = &l->next;
+        }
+    }
+}
+
+int fm_cache_init(void) {
+#ifdef __linux__
+    watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    return 0;
+}
+
+void fm_cache_shutdown(void) {
+    while (lists) {
+        fm_dirlist *l = lists;
+        lists = l->next;
+        free_list(l);
+    }
+    if (watch_fd >= 0) close(watch_fd);
+    watch_fd = -1;
+}
+
+fm_dirlist *fm_dircache_get(const char *path) {
+    fm_dirlist **pp = &lists;
+    for (; *pp; pp = &(*pp)->next) {
+        if (strcmp((*pp)->path, path) == 0) break;
+    }
+    fm_dirlist *l = *pp;
+    if (l) {
+        /* Move to front (most recently used) */
+        *pp = l->next;
+        l->next = lists;
+        lists = l;
+        if (l->stale && fm_dircache_revalidate(l) != 0) return NULL;
+        FM_PERF_ADD(dir_hits, 1);
+        l->refs++;
+        return l;
+    }
+
+    l = calloc(1, sizeof(*l));
+    if (!l) return NULL;
+    snprintf(l->path, sizeof(l->path), "%s", path);
+    /* Watch first so events during the scan mark the fresh listing stale */
+    add_watch(l);
+    if (scan(l) != 0) {
+        int saved = errno;
+        free_list(l);
+        errno = saved;
+        return NULL;
+    }
+    l->refs = 1;
+    l->next = lists;
+    lists = l;
+    evict_idle();
+    return l;
+}
+
+void fm_dircache_release(fm_dirlist *l) {
+    if (!l) return;
+    if (l->refs > 0) l->refs--;
+    if (l->refs == 0) evict_idle();
+}
+
+int fm_dircache_revalidate(fm_dirlist *l) {
+    if (!l->stale) return 0;
+    if (l->wd < 0) add_watch(l);
+    return scan(l);
+}
+
+static fm_dirlist *lookup(const char *path) {
+    fm_dirlist *l = lists;
+    while (l && strcmp(l->path, path) != 0) l = l->next;
+    return l;
+}
+
+/* Install entries as the listing of path, creating and watching it if needed */
+static fm_dirlist *install(fm_dirlist *l, const char *path, fm_entry *entries, int count,
+                           const struct timespec *mtime) {
+    if (!l) {
+        if (!(l = calloc(1, sizeof(*l)))) { free(entries); return NULL; }
+        snprintf(l->path, sizeof(l->path), "%s", path);
+        l->next = lists;
+        lists = l;
+        add_watch(l);
+    } else if (l->wd < 0) {
+        add_watch(l);
+    }
+    free(l->entries);
+    l->entries = entries;
+    l->count = count;
+    l->mtime = *mtime;
+    l->gen++;
+    return l;
+}
+
+void fm_dircache_adopt(const char *path, fm_entry *entries, int count, const struct timespec *mtime) {
+    fm_dirlist *l = lookup(path);
+    if (l && !l->stale && !l->provisional) { free(entries); return; }
+    if (!(l = install(l, path, entries, count, mtime))) return;
+    l->provisional = 0;
+    /* The watch only covers changes from now on; the mtime covers the gap since the read */
+    struct timespec now;
+    l->stale = dir_mtime(path, &now) != 0 ||
+               now.tv_sec != mtime->tv_sec || now.tv_nsec != mtime->tv_nsec;
+    evict_idle();
+}
+
+void fm_dircache_seed(const char *path, fm_entry *entries, int count, const struct timespec *mtime) {
+    if (lookup(path)) { free(entries); return; }
+    /* No stat here: the caller confirms the listing with a background read instead */
+    fm_dirlist *l = install(NULL, path, entries, count, mtime);
+    if (!l) return;
+    l->provisional = 1;
+    evict_idle();
+}
+
+int fm_dircache_contains(const char *path) {
+    return lookup(path) != NULL;
+}
+
+const fm_dirlist *fm_dircache_peek(const char *path) {
+    const fm_dirlist *l = lookup(path);
+    return l && !l->stale && !l->provisional ? l : NULL;
+}
+
+void fm_dircache_invalidate(const char *path) {
+    for (fm_dirlist *l = lists; l; l = l->next) {
+        if (strcmp(l->path, path) == 0) l->stale = 1;
+    }
+}
+
+static int mark_stale(fm_dirlist *l) {
+    if (l->stale) return 0;
+    l->stale = 1;
+    return 1;
+}
+
+int fm_cache_poll(void) {
+    int changed = 0;
+#ifdef __linux__
+    if (watch_fd >= 0) {
+        char buf[8192] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t len;
+        while ((len = read(watch_fd, buf, sizeof(buf))) > 0) {
+            for (char *p = buf; p < buf + len; ) {
+                const struct inotify_event *ev = (const struct inotify_event *)p;
+                p += sizeof(*ev) + ev->len;
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    for (fm_dirlist *l = lists; l; l = l->next) changed += mark_stale(l);
+                    continue;
+                }
+                for (fm_dirlist *l = lists; l; l = l->next) {
+                    if (l->wd != ev->wd) continue;
+                    changed += mark_stale(l);
+                    /* The kernel already dropped the watch */
+                    if (ev->mask & IN_IGNORED) l->wd = -1;
+                }
+            }
+        }
+        return changed;
+    }
+#endif
+    /* No watcher: a directory whose mtime moved has changed */
+    for (fm_dirlist *l = lists; l; l = l->next) {
+        struct timespec ts;
+        if (l->stale) continue;
+        if (dir_mtime(l->path, &ts) != 0 ||
+            ts.tv_sec != l->mtime.tv_sec || ts.tv_nsec != l->mtime.tv_nsec) {
+            changed += mark_stale(l);
+        }
+    }
+    return changed;
+}
+
+static id_slot *id_lookup(id_slot *table, unsigned id) {
+    unsigned h = (id * 2654435761u) & (IDCACHE_SIZE - 1);
+    for (int probe = 0; probe < IDCACHE_SIZE; ++probe) {
+        id_slot *s = &table[(h + probe) & (IDCACHE_SIZE - 1)];
+        if (!s->used || s->id == id) return s;
+    }
+    return NULL;
+}
+
+const char *fm_user_name(uid_t uid) {
+    id_slot *s = id_lookup(users, uid);
+    if (s && s->used) { FM_PERF_ADD(name_hits, 1); return s->name; }
+    FM_PERF_ADD(name_lookups, 1);
+    struct passwd *pw = getpwuid(uid);
+    const char *name = pw ? pw->pw_name : "?";
+    if (!s) return name;
+    s->used = 1;
+    s->id = uid;
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    return s->name;
+}
+
+const char *fm_group_name(gid_t gid) {
+    id_slot *s = id_lookup(groups, gid);
+    if (s && s->used) { FM_PERF_ADD(name_hits, 1); return s->name; }
+    FM_PERF_ADD(name_lookups, 1);
+    struct group *gr = getgrgid(gid);
+    const char *name = gr ? gr->gr_name : "?";
+    if (!s) return name;
+    s->used = 1;
+    s->id = gid;
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    return s->name;
+}
@@ -0,0 +1,232 @@
+#define _XOPEN_SOURCE 700
+#include "checksum.h"
+#include "hash.h"
+#include "pool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+
+/* Sequential read size per worker */
+#define SUM_READ_SIZE (1024 * 1024)
+
+#define SUMCACHE_SIZE 1024   /* power of two */
+
+typedef struct sum_slot {
+    int used;
+    fm_sum_algo algo;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    char hex[FM_SUM_HEX_MAX];
+} sum_slot;
+
+/* Direct-mapped: a newer digest simply replaces whatever shared its slot */
+static sum_slot sumcache[SUMCACHE_SIZE];
+static pthread_mutex_t sumcache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *algo_names[FM_SUM_ALGOS] = { "xxh64", "crc32c", "sha256" };
+static const int algo_hexlen[FM_SUM_ALGOS] = { 16, 8, 64 };
+
+const char *fm_sum_name(fm_sum_algo algo) {
+    return algo < FM_SUM_ALGOS ? algo_names[algo] : "?";
+}
+
+static sum_slot *slot_for(const struct stat *st, fm_sum_algo algo) {
+    unsigned h = ((unsigned)st->st_ino * 2654435761u) ^ ((unsigned)st->st_dev * 40503u) ^ algo;
+    return &sumcache[h & (SUMCACHE_SIZE - 1)];
+}
+
+static int slot_matches(const sum_slot *s, const struct stat *st, fm_sum_algo algo) {
+    return s->used && s->algo == algo && s->dev == st->st_dev && s->ino == st->st_ino &&
+           s->size == st->st_size && s->mtime.tv_sec == st->st_mtim.tv_sec &&
+           s->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+int fm_sum_cached(const struct stat *st, fm_sum_algo algo, char *hex) {
+    pthread_mutex_lock(&sumcache_lock);
+    sum_slot *s = slot_for(st, algo);
+    int found = slot_matches(s, st, algo);
+    if (found) memcpy(hex, s->hex, FM_SUM_HEX_MAX);
+    pthread_mutex_unlock(&sumcache_lock);
+    return found ? 0 : -1;
+}
+
+static void cache_store(const struct stat *st, fm_sum_algo algo, const char *hex) {
+    pthread_mutex_lock(&sumcache_lock);
+    sum_slot *s = slot_for(st, algo);
+    s->used = 1;
+    s->algo = algo;
+    s->dev = st->st_dev;
+    s->ino = st->st_ino;
+    s->size = st->st_size;
+    s->mtime = st->st_mtim;
+    memcpy(s->hex, hex, FM_SUM_HEX_MAX);
+    pthread_mutex_unlock(&sumcache_lock);
+}
+
+static void to_hex(const unsigned char *d, int n, char *hex) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < n; ++i) {
+        hex[2 * i] = digits[d[i] >> 4];
+        hex[2 * i + 1] = digits[d[i] & 15];
+    }
+    hex[2 * n] = '\0';
+}
+
+/* Hash fd from its current offset to EOF; 0 or -1 with errno set */
+static int sum_fd(int fd, fm_sum_algo algo, unsigned char *buf, char *hex) {
+    fm_xxh64_state xs;
+    fm_sha256_state ss;
+    uint32_t crc = 0;
+    if (algo == FM_SUM_XXH64) fm_xxh64_init(&xs, 0);
+    else if (algo == FM_SUM_SHA256) fm_sha256_init(&ss);
+
+    ssize_t r;
+    while ((r = read(fd, buf, SUM_READ_SIZE)) != 0) {
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (algo == FM_SUM_XXH64) fm_xxh64_update(&xs, buf, r);
+        else if (algo == FM_SUM_CRC32C) crc = fm_crc32c(crc, buf, r);
+        else fm_sha256_update(&ss, buf, r);
+    }
+
+    if (algo == FM_SUM_XXH64) {
+        snprintf(hex, FM_SUM_HEX_MAX, "%016llx", (unsigned long long)fm_xxh64_digest(&xs));
+    } else if (algo == FM_SUM_CRC32C) {
+        snprintf(hex, FM_SUM_HEX_MAX, "%08x", (unsigned)crc);
+    } else {
+        unsigned char d[32];
+        fm_sha256_final(&ss, d);
+        to_hex(d, 32, hex);
+    }
+    return 0;
+}
+
+static void sum_job(void *ctx, int i, void *buf) {
+    fm_sum_job *job = &((fm_sum_job *)ctx)[i];
+    job->hex[0] = '\0';
+    job->err = 0;
+    job->cached = 0;
+    int fd = open(job->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { job->err = errno; return; }
+    struct stat st, after;
+    if (fstat(fd, &st) != 0) { job->err = errno; close(fd); return; }
+    if (!S_ISREG(st.st_mode)) { job->err = S_ISDIR(st.st_mode) ? EISDIR : EINVAL; close(fd); return; }
+    if (fm_sum_cached(&st, job->algo, job->hex) == 0) {
+        job->cached = 1;
+        close(fd);
+        return;
+    }
+    if (!buf) { job->err = ENOMEM; close(fd); return; }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    if (sum_fd(fd, job->algo, buf, job->hex) != 0) {
+        job->err = errno;
+    } else if (fstat(fd, &after) == 0 && after.st_size == st.st_size &&
+               after.st_mtim.tv_sec == st.st_mtim.tv_sec && after.st_mtim.tv_nsec == st.st_mtim.tv_nsec) {
+        /* Only cache a digest of content that held still while it was read */
+        cache_store(&st, job->algo, job->hex);
+    }
+    close(fd);
+}
+
+void fm_sum_files(fm_sum_job *jobs, int n, fm_progress_fn progress, void *ctx) {
+    fm_pool_run(n, sum_job, jobs, SUM_READ_SIZE, progress, ctx);
+}
+
+void fm_sum_jobs_free(fm_sum_job *jobs, int n) {
+    if (!jobs) return;
+    for (int i = 0; i < n; ++i) free(jobs[i].path);
+    free(jobs);
+}
+
+/* Length of the directory part of path including the slash, 0 if there is none */
+static size_t dir_len(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? (size_t)(slash - path) + 1 : 0;
+}
+
+int fm_sum_write_manifest(const char *manifest, const fm_sum_job *jobs, int n) {
+    size_t dl = dir_len(manifest);
+    FILE *f = fopen(manifest, "w");
+    if (!f) return -1;
+    for (int i = 0; i < n; ++i) {
+        if (jobs[i].err || !jobs[i].hex[0]) continue;
+        const char *p = jobs[i].path;
+        if (dl && strncmp(p, manifest, dl) == 0) p += dl;
+        fprintf(f, "%s  %s\n", jobs[i].hex, p);
+    }
+    if (fclose(f) != 0) return -1;
+    return 0;
+}
+
+static int algo_for_len(size_t len) {
+    for (int a = 0; a < FM_SUM_ALGOS; ++a) {
+        if ((size_t)algo_hexlen[a] == len) return a;
+    }
+    return -1;
+}
+
+int fm_sum_read_manifest(const char *manifest, fm_sum_job **jobs_out, int *malformed) {
+    FILE *f = fopen(manifest, "r");
+    if (!f) return -1;
+    size_t dl = dir_len(manifest);
+    fm_sum_job *jobs = NULL;
+    int n = 0, cap = 0;
+    *malformed = 0;
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &linecap, f)) >= 0) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+        if (len == 0 || line[0] == '#') continue;
+
+        /* "<hex>  <path>" or "<hex> *<path>" (binary-mode marker) */
+        size_t hexlen = 0;
+        while (isxdigit((unsigned char)line[hexlen])) hexlen++;
+        int algo = algo_for_len(hexlen);
+        if (algo < 0 || line[hexlen] != ' ' || (line[hexlen + 1] != ' ' && line[hexlen + 1] != '*') ||
+            line[hexlen + 2] == '\0') {
+            (*malformed)++;
+            continue;
+        }
+        const char *name = line + hexlen + 2;
+
+        if (n == cap) {
+            int ncap = cap ? cap * 2 : 64;
+            fm_sum_job *nj = realloc(jobs, ncap * sizeof(*nj));
+            if (!nj) goto nomem;
+            jobs = nj;
+            cap = ncap;
+        }
+        fm_sum_job *job = &jobs[n];
+        memset(job, 0, sizeof(*job));
+        job->algo = algo;
+        for (size_t i = 0; i < hexlen; ++i) job->expected[i] = tolower((unsigned char)line[i]);
+        size_t plen = (name[0] == '/' ? 0 : dl) + strlen(name) + 1;
+        if (!(job->path = malloc(plen))) goto nomem;
+        snprintf(job->path, plen, "%.*s%s", name[0] == '/' ? 0 : (int)dl, manifest, name);
+        n++;
+    }
+    free(line);
+    fclose(f);
+    *jobs_out = jobs;
+    return n;
+
+nomem:
+    free(line);
+    fclose(f);
+    fm_sum_jobs_free(jobs, n);
+    errno = ENOMEM;
+    return -1;
+}
@@ -0,0 +1,466 @@
+#define _XOPEN_SOURCE 700
+#include "cli.h"
+#include "fs.h"
+#include "cache.h"
+#include "index.h"
+#include "compare.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <time.h>
+#include <limits.h>
+
+/* Output state shared by every subcommand: NDJSON or plain text, plus running totals */
+typedef struct cli_out {
+    const char *cmd;
+    int json;
+    long long items;
+    long long bytes;
+    long long errors;
+    struct timespec start;
+} cli_out;
+
+static const char *const commands[] = { "ls", "cp", "rm", "du", "find", "index", "locate", "compare", "help", NULL };
+
+int fm_cli_is_command(const char *name) {
+    for (int i = 0; commands[i]; ++i) {
+        if (strcmp(name, commands[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static void usage(FILE *f) {
+    fprintf(f,
+            "usage: filemgr [start_directory]            interactive mode\n"
+            "       filemgr ls   [--json] [PATH...]\n"
+            "       filemgr cp   [--json] [-r] SRC... DEST\n"
+            "       filemgr rm   [--json] [-r] PATH...\n"
+            "       filemgr du   [--json] [PATH...]\n"
+            "       filemgr find [--json] [PATH] [-name GLOB] [-type f|d|l] [-maxdepth N]\n"
+            "       filemgr index  [--json] [ROOT]        build or refresh the metadata index\n"
+            "       filemgr locate [--json] PATTERN       search the index (GLOB or substring)\n"
+            "       filemgr compare [--json] LEFT RIGHT   list what differs between two trees\n"
+            "With --json every result is one JSON object per line (NDJSON),\n"
+            "followed by a {\"kind\":\"summary\"} record with totals and throughput.\n");
+}
+
+/* Write s as a JSON string literal; bytes >= 0x80 pass through (names are assumed UTF-8) */
+static void json_str(const char *s) {
+    putchar('"');
+    for (const unsigned char *p = (const unsigned char *)s; *p; ++p) {
+        switch (*p) {
+        case '"':  fputs("\\\"", stdout); break;
+        case '\\': fputs("\\\\", stdout); break;
+        case '\n': fputs("\\n", stdout); break;
+        case '\t': fputs("\\t", stdout); break;
+        case '\r': fputs("\\r", stdout); break;
+        default:
+            if (*p < 0x20) printf("\\u%04x", *p);
+            else putchar(*p);
+        }
+    }
+    putchar('"');
+}
+
+static const char *type_name(mode_t mode) {
+    if (S_ISREG(mode)) return "file";
+    if (S_ISDIR(mode)) return "dir";
+    if (S_ISLNK(mode)) return "symlink";
+    if (S_ISCHR(mode)) return "char";
+    if (S_ISBLK(mode)) return "block";
+    if (S_ISFIFO(mode)) return "fifo";
+    if (S_ISSOCK(mode)) return "socket";
+    return "unknown";
+}
+
+static double elapsed_s(const cli_out *o) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - o->start.tv_sec) + (now.tv_nsec - o->start.tv_nsec) / 1e9;
+}
+
+static void emit_error(cli_out *o, const char *path, int err) {
+    o->errors++;
+    if (o->json) {
+        printf("{\"kind\":\"error\",\"path\":");
+        json_str(path);
+        printf(",\"error\":");
+        json_str(strerror(err));
+        printf("}\n");
+    } else {
+        fprintf(stderr, "filemgr %s: %s: %s\n", o->cmd, path, strerror(err));
+    }
+}
+
+static void emit_entry(cli_out *o, const char *path, const struct stat *st) {
+    o->items++;
+    if (o->json) {
+        printf("{\"kind\":\"entry\",\"path\":");
+        json_str(path);
+        printf(",\"type\":\"%s\",\"size\":%lld,\"mode\":\"%04o\",\"nlink\":%lu,\"uid\":%u,\"gid\":%u,\"owner\":",
+               type_name(st->st_mode), (long long)st->st_size, (unsigned)(st->st_mode & 07777),
+               (unsigned long)st->st_nlink, (unsigned)st->st_uid, (unsigned)st->st_gid);
+        json_str(fm_user_name(st->st_uid));
+        printf(",\"group\":");
+        json_str(fm_group_name(st->st_gid));
+        printf(",\"mtime\":%lld,\"ino\":%llu}\n", (long long)st->st_mtime, (unsigned long long)st->st_ino);
+    } else {
+        printf("%c %04o %12lld %s\n", S_ISDIR(st->st_mode) ? 'd' : S_ISLNK(st->st_mode) ? 'l' : '-',
+               (unsigned)(st->st_mode & 07777), (long long)st->st_size, path);
+    }
+}
+
+static int finish(cli_out *o) {
+    double secs = elapsed_s(o);
+    double rate = secs > 0 ? o->items / secs : 0;
+    double mbps = secs > 0 ? o->bytes / (1024.0 * 1024.0) / secs : 0;
+    if (o->json) {
+        printf("{\"kind\":\"summary\",\"cmd\":\"%s\",\"items\":%lld,\"bytes\":%lld,\"errors\":%lld,"
+               "\"elapsed_ms\":%.3f,\"items_per_s\":%.1f,\"mb_per_s\":%.2f}\n",
+               o->cmd, o->items, o->bytes, o->errors, secs * 1000.0, rate, mbps);
+    } else if (strcmp(o->cmd, "cp") == 0 || strcmp(o->cmd, "rm") == 0) {
+        fprintf(stderr, "%s: %lld items, %.1f MB in %.3f s (%.1f MB/s), %lld errors\n",
+                o->cmd, o->items, o->bytes / (1024.0 * 1024.0), secs, mbps, o->errors);
+    }
+    fflush(stdout);
+    return o->errors ? 1 : 0;
+}
+
+/* ---- ls ---- */
+
+static int cmd_ls(cli_out *o, int npaths, char **paths) {
+    static char *dot[] = { "." };
+    if (npaths == 0) { npaths = 1; paths = dot; }
+    for (int i = 0; i < npaths; ++i) {
+        fm_entry *entries = NULL;
+        int n = fm_read_dir(paths[i], &entries);
+        if (n < 0) {
+            emit_error(o, paths[i], errno);
+            continue;
+        }
+        for (int k = 0; k < n; ++k) {
+            if (strcmp(entries[k].name, "..") == 0) continue;
+            emit_entry(o, entries[k].path, &entries[k].st);
+        }
+        free(entries);
+    }
+    return finish(o);
+}
+
+/* ---- cp / rm ---- */
+
+static void report_copy(void *ctx, const char *path, off_t bytes, int err) {
+    cli_out *o = ctx;
+    if (err) { emit_error(o, path, err); return; }
+    o->items++;
+    o->bytes += bytes;
+    if (o->json) {
+        printf("{\"kind\":\"%s\",\"path\":", strcmp(o->cmd, "cp") == 0 ? "copy" : "remove");
+        json_str(path);
+        printf(",\"bytes\":%lld}\n", (long long)bytes);
+    }
+}
+
+static int cmd_cp(cli_out *o, int recursive, int npaths, char **paths) {
+    if (npaths < 2) { usage(stderr); return 2; }
+    const char *dest = paths[npaths - 1];
+    struct stat dst;
+    int into_dir = stat(dest, &dst) == 0 && S_ISDIR(dst.st_mode);
+    if (npaths > 2 && !into_dir) {
+        fprintf(stderr, "filemgr cp: target '%s' is not a directory\n", dest);
+        return 2;
+    }
+    for (int i = 0; i < npaths - 1; ++i) {
+        const char *src = paths[i];
+        struct stat st;
+        if (lstat(src, &st) != 0) { emit_error(o, src, errno); continue; }
+        if (S_ISDIR(st.st_mode) && !recursive) { emit_error(o, src, EISDIR); continue; }
+
+        char target[PATH_MAX];
+        if (into_dir) {
+            /* cp SRC DIR copies to DIR/basename(SRC) */
+            char tmp[PATH_MAX];
+            snprintf(tmp, sizeof(tmp), "%s", src);
+            size_t len = strlen(tmp);
+            while (len > 1 && tmp[len - 1] == '/') tmp[--len] = '\0';
+            const char *base = strrchr(tmp, '/');
+            base = base ? base + 1 : tmp;
+            if (snprintf(target, sizeof(target), "%s/%s", dest, base) >= (int)sizeof(target)) {
+                emit_error(o, src, ENAMETOOLONG);
+                continue;
+            }
+        } else {
+            snprintf(target, sizeof(target), "%s", dest);
+        }
+        fm_copy_tree(src, target, report_copy, o);
+    }
+    return finish(o);
+}
+
+static int cmd_rm(cli_out *o, int recursive, int npaths, char **paths) {
+    if (npaths < 1) { usage(stderr); return 2; }
+    for (int i = 0; i < npaths; ++i) {
+        if (recursive) {
+            fm_remove_tree(paths[i], report_copy, o);
+        } else if (fm_remove(paths[i]) == 0) {
+            report_copy(o, paths[i], 0, 0);
+        } else {
+            emit_error(o, paths[i], errno);
+        }
+    }
+    return finish(o);
+}
+
+/* ---- du ---- */
+
+/* Set of (dev, ino) already counted, so hard links are charged once */
+typedef struct ino_set {
+    struct { dev_t dev; ino_t ino; int used; } *slots;
+    size_t cap, len;
+} ino_set;
+
+static int ino_set_add(ino_set *s, dev_t dev, ino_t ino) {
+    if ((s->len + 1) * 2 > s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 1024;
+        ino_set grown = { calloc(cap, sizeof(*s->slots)), cap, 0 };
+        if (!grown.slots) return 1;   /* count it again rather than fail */
+        for (size_t i = 0; i < s->cap; ++i) {
+            if (s->slots[i].used) ino_set_add(&grown, s->slots[i].dev, s->slots[i].ino);
+        }
+        free(s->slots);
+        *s = grown;
+    }
+    size_t h = ((size_t)ino * 0x9E3779B97F4A7C15ULL ^ (size_t)dev) & (s->cap - 1);
+    while (s->slots[h].used) {
+        if (s->slots[h].dev == dev && s->slots[h].ino == ino) return 0;
+        h = (h + 1) & (s->cap - 1);
+    }
+    s->slots[h].used = 1;
+    s->slots[h].dev = dev;
+    s->slots[h].ino = ino;
+    s->len++;
+    return 1;
+}
+
+typedef struct du_state {
+    cli_out *out;
+    ino_set seen;
+    long long bytes, disk_bytes, files, dirs;
+} du_state;
+
+static int du_cb(void *ctx, fm_walk_event ev, const fm_walk_entry *e) {
+    du_state *d = ctx;
+    if (ev == FM_WALK_ERROR) { emit_error(d->out, e->path, e->err); return 0; }
+    if (ev == FM_WALK_DIR_POST) return 0;
+    if (e->st->st_nlink > 1 && !S_ISDIR(e->st->st_mode) &&
+        !ino_set_add(&d->seen, e->st->st_dev, e->st->st_ino)) return 0;
+    if (ev == FM_WALK_DIR_PRE) d->dirs++;
+    else d->files++;
+    d->bytes += e->st->st_size;
+    d->disk_bytes += (long long)e->st->st_blocks * 512;
+    return 0;
+}
+
+static int cmd_du(cli_out *o, int npaths, char **paths) {
+    static char *dot[] = { "." };
+    if (npaths == 0) { npaths = 1; paths = dot; }
+    for (int i = 0; i < npaths; ++i) {
+        du_state d = { o, { NULL, 0, 0 }, 0, 0, 0, 0 };
+        fm_walk(paths[i], du_cb, &d);
+        free(d.seen.slots);
+        o->items += d.files + d.dirs;
+        o->bytes += d.bytes;
+        if (o->json) {
+            printf("{\"kind\":\"du\",\"path\":");
+            json_str(paths[i]);
+            printf(",\"bytes\":%lld,\"disk_bytes\":%lld,\"files\":%lld,\"dirs\":%lld}\n",
+                   d.bytes, d.disk_bytes, d.files, d.dirs);
+        } else {
+            printf("%lld\t%s\n", d.bytes, paths[i]);
+        }
+    }
+    return finish(o);
+}
+
+/* ---- find ---- */
+
+typedef struct find_state {
+    cli_out *out;
+    const char *name;   /* glob on the final component, NULL = any */
+    char type;          /* 'f', 'd', 'l' or 0 */
+    int maxdepth;       /* -1 = unlimited */
+} find_state;
+
+static int find_cb(void *ctx, fm_walk_event ev, const fm_walk_entry *e) {
+    find_state *f = ctx;
+    if (ev == FM_WALK_ERROR) { emit_error(f->out, e->path, e->err); return 0; }
+    if (ev == FM_WALK_DIR_POST) return 0;
+    mode_t m = e->st->st_mode;
+    int type_ok = !f->type || (f->type == 'f' && S_ISREG(m)) ||
+                  (f->type == 'd' && S_ISDIR(m)) || (f->type == 'l' && S_ISLNK(m));
+    if (type_ok && (!f->name || fnmatch(f->name, e->name, 0) == 0)) emit_entry(f->out, e->path, e->st);
+    /* Do not descend past -maxdepth */
+    return (ev == FM_WALK_DIR_PRE && f->maxdepth >= 0 && e->depth >= f->maxdepth) ? 1 : 0;
+}
+
+static int cmd_find(cli_out *o, int argc, char **argv) {
+    find_state f = { o, NULL, 0, -1 };
+    const char *root = ".";
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "-name") == 0 && i + 1 < argc) f.name = argv[++i];
+        else if (strcmp(argv[i], "-type") == 0 && i + 1 < argc) f.type = argv[++i][0];
+        else if (strcmp(argv[i], "-maxdepth") == 0 && i + 1 < argc) f.maxdepth = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && i == 0) root = argv[i];
+        else { usage(stderr); return 2; }
+    }
+    if (f.type && !strchr("fdl", f.type)) { usage(stderr); return 2; }
+    fm_walk(root, find_cb, &f);
+    return finish(o);
+}
+
+/* ---- index / locate ---- */
+
+static int cmd_index(cli_out *o, int npaths, char **paths) {
+    if (npaths > 1) { usage(stderr); return 2; }
+    char file[PATH_MAX];
+    if (fm_index_default_file(file, sizeof(file), 1) != 0) { emit_error(o, "index", errno); return finish(o); }
+    /* Without ROOT the existing index is refreshed in place */
+    char root[PATH_MAX];
+    if (npaths == 1) {
+        snprintf(root, sizeof(root), "%s", paths[0]);
+    } else {
+        fm_index ix;
+        if (fm_index_open(&ix, file) != 0) {
+            fprintf(stderr, "filemgr index: no index at %s; give a ROOT to build one\n", file);
+            return 2;
+        }
+        snprintf(root, sizeof(root), "%s", fm_index_name(&ix, 0));
+        fm_index_close(&ix);
+    }
+    fm_index_stats st;
+    if (fm_index_build(file, root, &st) != 0) { emit_error(o, root, errno); return finish(o); }
+    o->items = st.nodes;
+    o->errors = st.errors;
+    if (o->json) {
+        printf("{\"kind\":\"index\",\"root\":");
+        json_str(root);
+        printf(",\"file\":");
+        json_str(file);
+        printf(",\"nodes\":%lu,\"dirs\":%lu,\"reused\":%lu,\"scanned\":%lu,\"errors\":%lu}\n",
+               st.nodes, st.dirs, st.reused, st.scanned, st.errors);
+    } else {
+        printf("%s: %lu entries, %lu directories (%lu reused, %lu read, %lu unreadable)\n",
+               root, st.nodes, st.dirs, st.reused, st.scanned, st.errors);
+    }
+    return finish(o);
+}
+
+static int cmd_locate(cli_out *o, int npaths, char **paths) {
+    if (npaths != 1) { usage(stderr); return 2; }
+    char file[PATH_MAX];
+    fm_index ix;
+    if (fm_index_default_file(file, sizeof(file), 0) != 0 || fm_index_open(&ix, file) != 0) {
+        fprintf(stderr, "filemgr locate: no usable index (run 'filemgr index ROOT' first)\n");
+        return 2;
+    }
+    int n = fm_index_search(&ix, paths[0], NULL, 0);
+    uint32_t *ids = n > 0 ? malloc(n * sizeof(*ids)) : NULL;
+    if (n > 0 && !ids) { emit_error(o, paths[0], ENOMEM); fm_index_close(&ix); return finish(o); }
+    if (n > 0) fm_index_search(&ix, paths[0], ids, n);
+    for (int k = 0; k < n; ++k) {
+        char path[PATH_MAX];
+        if (fm_index_path(&ix, ids[k], path, sizeof(path)) != 0) {
+            emit_error(o, fm_index_name(&ix, ids[k]), ENAMETOOLONG);
+            continue;
+        }
+        /* Recorded metadata, as of the last index refresh */
+        const fm_index_node *nd = &ix.nodes[ids[k]];
+        struct stat st;
+        memset(&st, 0, sizeof(st));
+        st.st_mode = nd->mode;
+        st.st_nlink = nd->nlink;
+        st.st_uid = nd->uid;
+        st.st_gid = nd->gid;
+        st.st_size = nd->size;
+        st.st_ino = nd->ino;
+        st.st_mtime = nd->mtime_sec;
+        emit_entry(o, path, &st);
+    }
+    free(ids);
+    fm_index_close(&ix);
+    return finish(o);
+}
+
+/* ---- compare ---- */
+
+static const char *const cmp_state_names[FM_CMP_STATES] = {
+    "only_left", "only_right", "same", "different", "error"
+};
+
+static int cmd_compare(cli_out *o, int npaths, char **paths) {
+    if (npaths != 2) { usage(stderr); return 2; }
+    fm_compare c;
+    if (fm_compare_run(paths[0], paths[1], &c, NULL, NULL) != 0) {
+        emit_error(o, errno == ENOTDIR ? paths[0] : "compare", errno);
+        return finish(o);
+    }
+    for (int k = 0; k < c.count; ++k) {
+        const fm_cmp_item *it = &c.items[k];
+        if (it->state == FM_CMP_ERROR) { emit_error(o, it->rel[0] ? it->rel : ".", it->err); continue; }
+        o->items++;
+        if (o->json) {
+            printf("{\"kind\":\"diff\",\"path\":");
+            json_str(it->rel);
+            printf(",\"state\":\"%s\",\"left_type\":\"%s\",\"right_type\":\"%s\","
+                   "\"left_size\":%lld,\"right_size\":%lld,\"left_mtime\":%lld,\"right_mtime\":%lld}\n",
+                   cmp_state_names[it->state], it->lmode ? type_name(it->lmode) : "none",
+                   it->rmode ? type_name(it->rmode) : "none", (long long)it->lsize, (long long)it->rsize,
+                   (long long)it->lmtime.tv_sec, (long long)it->rmtime.tv_sec);
+        } else {
+            char mark = it->state == FM_CMP_ONLY_LEFT ? '<' : it->state == FM_CMP_ONLY_RIGHT ? '>' : '!';
+            printf("%c %s%s\n", mark, it->rel, S_ISDIR(it->lmode | it->rmode) ? "/" : "");
+        }
+    }
+    if (o->json) {
+        printf("{\"kind\":\"compare\",\"dirs\":%lu,\"only_left\":%lu,\"only_right\":%lu,"
+               "\"same\":%lu,\"different\":%lu}\n", c.dirs, c.counts[FM_CMP_ONLY_LEFT],
+               c.counts[FM_CMP_ONLY_RIGHT], c.counts[FM_CMP_SAME], c.counts[FM_CMP_DIFFERENT]);
+    } else {
+        fprintf(stderr, "compare: %lu directories, %lu only left, %lu only right, %lu same, %lu different\n",
+                c.dirs, c.counts[FM_CMP_ONLY_LEFT], c.counts[FM_CMP_ONLY_RIGHT],
+                c.counts[FM_CMP_SAME], c.counts[FM_CMP_DIFFERENT]);
+    }
+    fm_compare_free(&c);
+    return finish(o);
+}
+
+int fm_cli_run(int argc, char **argv) {
+    cli_out o = { argv[0], 0, 0, 0, 0, { 0, 0 } };
+    int recursive = 0;
+
+    /* Leading options; find keeps its own predicates after the path */
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+        if (strcmp(argv[i], "--") == 0) { i++; break; }
+        if (strcmp(argv[i], "--json") == 0) o.json = 1;
+        else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "-R") == 0) recursive = 1;
+        else if (strcmp(o.cmd, "find") == 0) break;
+        else { usage(stderr); return 2; }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &o.start);
+    int rc;
+    if (strcmp(o.cmd, "ls") == 0) rc = cmd_ls(&o, argc - i, argv + i);
+    else if (strcmp(o.cmd, "cp") == 0) rc = cmd_cp(&o, recursive, argc - i, argv + i);
+    else if (strcmp(o.cmd, "rm") == 0) rc = cmd_rm(&o, recursive, argc - i, argv + i);
+    else if (strcmp(o.cmd, "du") == 0) rc = cmd_du(&o, argc - i, argv + i);
+    else if (strcmp(o.cmd, "find") == 0) rc = cmd_find(&o, argc - i, argv + i);
+    else if (strcmp(o.cmd, "index") == 0) rc = cmd_index(&o, argc - i, argv + i);
+    else if (strcmp(o.cmd, "locate") == 0) rc = cmd_locate(&o, argc - i, argv + i);
+    else if (strcmp(o.cmd, "compare") == 0) rc = cmd_compare(&o, argc - i, argv + i);
+    else { usage(stdout); rc = 0; }
+    fm_cache_shutdown();
+    return rc;
+}
@@ -0,0 +1,683 @@
+#define _XOPEN_SOURCE 700
+#include "compare.h"
+#include "checksum.h"
+#include "pool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+/* Fallback copy buffer per sync worker (sendfile needs none) */
+#define SYNC_BUFSIZE (256 * 1024)
+
+int fm_cmp_hashable(const fm_cmp_item *it) {
+    return it->state == FM_CMP_DIFFERENT && !it->hashed && S_ISREG(it->lmode) && S_ISREG(it->rmode) &&
+           it->lsize == it->rsize;
+}
+
+/* root/rel (root itself for ""), malloc'd */
+static char *join(const char *root, const char *rel) {
+    size_t rl = strlen(root), ll = strlen(rel);
+    char *p = malloc(rl + ll + 2);
+    if (!p) return NULL;
+    memcpy(p, root, rl);
+    if (ll) {
+        p[rl++] = '/';
+        memcpy(p + rl, rel, ll);
+    }
+    p[rl + ll] = '\0';
+    return p;
+}
+
+/* Path order with '/' below every other byte, so a directory's contents follow it */
+static int rel_cmp(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    unsigned char x = *a == '/' ? 1 : (unsigned char)*a;
+    unsigned char y = *b == '/' ? 1 : (unsigned char)*b;
+    return x - y;
+}
+
+static int item_cmp(const void *a, const void *b) {
+    return rel_cmp(((const fm_cmp_item *)a)->rel, ((const fm_cmp_item *)b)->rel);
+}
+
+/* ---- one directory on one side ---- */
+
+typedef struct side_ent {
+    const char *name;
+    size_t off;              /* into side.names while reading */
+    struct stat st;
+    int err;                 /* errno if fstatat failed */
+} side_ent;
+
+typedef struct side {
+    DIR *d;                  /* kept open for readlinkat */
+    side_ent *v;
+    int n;
+    char *names;
+} side;
+
+static int ent_cmp(const void *a, const void *b) {
+    return strcmp(((const side_ent *)a)->name, ((const side_ent *)b)->name);
+}
+
+static void side_free(side *s) {
+    if (s->d) closedir(s->d);
+    free(s->v);
+    free(s->names);
+}
+
+/* Read and lstat every entry of root/rel, sorted by name; -1 with errno set */
+static int side_read(const char *root, const char *rel, side *s) {
+    memset(s, 0, sizeof(*s));
+    char *path = join(root, rel);
+    if (!path) return -1;
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(path);
+    if (fd < 0) return -1;
+    if (!(s->d = fdopendir(fd))) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    int cap = 0;
+    size_t nlen = 0, ncap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(s->d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        size_t len = strlen(ent->d_name) + 1;
+        if (s->n == cap) {
+            cap = cap ? cap * 2 : 64;
+            side_ent *v = realloc(s->v, cap * sizeof(*v));
+            if (!v) goto nomem;
+            s->v = v;
+        }
+        if (nlen + len > ncap) {
+            ncap = ncap ? ncap * 2 : 4096;
+            while (ncap < nlen + len) ncap *= 2;
+            char *names = realloc(s->names, ncap);
+            if (!names) goto nomem;
+            s->names = names;
+        }
+        side_ent *e = &s->v[s->n++];
+        memcpy(s->names + nlen, ent->d_name, len);
+        e->off = nlen;
+        nlen += len;
+        e->err = fstatat(dirfd(s->d), ent->d_name, &e->st, AT_SYMLINK_NOFOLLOW) == 0 ? 0 : errno;
+    }
+    for (int i = 0; i < s->n; ++i) s->v[i].name = s->names + s->v[i].off;
+    qsort(s->v, s->n, sizeof(*s->v), ent_cmp);
+    return 0;
+nomem:
+    side_free(s);
+    memset(s, 0, sizeof(*s));
+    errno = ENOMEM;
+    return -1;
+}
+
+/* ---- one level of the parallel walk ---- */
+
+typedef struct job_out {
+    fm_cmp_item *items;
+    int n, cap;
+    char **subdirs;          /* rel paths present as directories on both sides */
+    int nsub, subcap;
+    unsigned long counts[FM_CMP_STATES];
+    unsigned long dirs;
+    int nomem;
+} job_out;
+
+typedef struct level {
+    const char *left, *right;
+    char **dirs;
+    job_out *outs;
+} level;
+
+static fm_cmp_item *add_item(job_out *o, const char *dir, const char *name, fm_cmp_state state) {
+    if (o->n == o->cap) {
+        int cap = o->cap ? o->cap * 2 : 16;
+        fm_cmp_item *v = realloc(o->items, cap * sizeof(*v));
+        if (!v) { o->nomem = 1; return NULL; }
+        o->items = v;
+        o->cap = cap;
+    }
+    char *rel = !name ? strdup(dir) : dir[0] ? join(dir, name) : strdup(name);
+    if (!rel) { o->nomem = 1; return NULL; }
+    fm_cmp_item *it = &o->items[o->n++];
+    memset(it, 0, sizeof(*it));
+    it->rel = rel;
+    it->state = state;
+    o->counts[state]++;
+    return it;
+}
+
+static void set_left(fm_cmp_item *it, const struct stat *st) {
+    it->lmode = st->st_mode;
+    it->lsize = st->st_size;
+    it->lmtime = st->st_mtim;
+}
+
+static void set_right(fm_cmp_item *it, const struct stat *st) {
+    it->rmode = st->st_mode;
+    it->rsize = st->st_size;
+    it->rmtime = st->st_mtim;
+}
+
+static void add_subdir(job_out *o, const char *dir, const char *name) {
+    if (o->nsub == o->subcap) {
+        int cap = o->subcap ? o->subcap * 2 : 16;
+        char **v = realloc(o->subdirs, cap * sizeof(*v));
+        if (!v) { o->nomem = 1; return; }
+        o->subdirs = v;
+        o->subcap = cap;
+    }
+    char *rel = dir[0] ? join(dir, name) : strdup(name);
+    if (!rel) { o->nomem = 1; return; }
+    o->subdirs[o->nsub++] = rel;
+}
+
+/* Classify an entry present on both sides */
+static fm_cmp_state classify(const side *l, const side_ent *a, const side *r, const side_ent *b) {
+    if ((a->st.st_mode & S_IFMT) != (b->st.st_mode & S_IFMT)) return FM_CMP_DIFFERENT;
+    if (S_ISREG(a->st.st_mode)) {
+        return a->st.st_size == b->st.st_size && a->st.st_mtim.tv_sec == b->st.st_mtim.tv_sec &&
+               a->st.st_mtim.tv_nsec == b->st.st_mtim.tv_nsec ? FM_CMP_SAME : FM_CMP_DIFFERENT;
+    }
+    if (S_ISLNK(a->st.st_mode)) {
+        char x[PATH_MAX], y[PATH_MAX];
+        ssize_t nx = readlinkat(dirfd(l->d), a->name, x, sizeof(x));
+        ssize_t ny = readlinkat(dirfd(r->d), b->name, y, sizeof(y));
+        if (nx < 0 || ny < 0) return FM_CMP_ERROR;
+        return nx == ny && memcmp(x, y, nx) == 0 ? FM_CMP_SAME : FM_CMP_DIFFERENT;
+    }
+    if (S_ISCHR(a->st.st_mode) || S_ISBLK(a->st.st_mode))
+        return a->st.st_rdev == b->st.st_rdev ? FM_CMP_SAME : FM_CMP_DIFFERENT;
+    return FM_CMP_SAME;
+}
+
+/* Read one directory on both sides and merge the sorted listings */
+static void level_job(void *ctx, int i, void *buf) {
+    (void)buf;
+    level *lv = ctx;
+    const char *dir = lv->dirs[i];
+    job_out *o = &lv->outs[i];
+    side l, r;
+    int lrc = side_read(lv->left, dir, &l);
+    int rrc = lrc == 0 ? side_read(lv->right, dir, &r) : -1;
+    if (rrc != 0) {
+        int err = errno;
+        fm_cmp_item *it = add_item(o, dir, NULL, FM_CMP_ERROR);
+        if (it) it->err = err;
+        if (lrc == 0) side_free(&l);
+        return;
+    }
+    o->dirs++;
+    int a = 0, b = 0;
+    while ((a < l.n || b < r.n) && !o->nomem) {
+        int c = a == l.n ? 1 : b == r.n ? -1 : strcmp(l.v[a].name, r.v[b].name);
+        fm_cmp_item *it;
+        if (c < 0) {
+            const side_ent *e = &l.v[a++];
+            if ((it = add_item(o, dir, e->name, e->err ? FM_CMP_ERROR : FM_CMP_ONLY_LEFT))) {
+                it->err = e->err;
+                if (!e->err) set_left(it, &e->st);
+            }
+        } else if (c > 0) {
+            const side_ent *e = &r.v[b++];
+            if ((it = add_item(o, dir, e->name, e->err ? FM_CMP_ERROR : FM_CMP_ONLY_RIGHT))) {
+                it->err = e->err;
+                if (!e->err) set_right(it, &e->st);
+            }
+        } else {
+            const side_ent *x = &l.v[a++], *y = &r.v[b++];
+            if (x->err || y->err) {
+                if ((it = add_item(o, dir, x->name, FM_CMP_ERROR))) it->err = x->err ? x->err : y->err;
+                continue;
+            }
+            if (S_ISDIR(x->st.st_mode) && S_ISDIR(y->st.st_mode)) {
+                add_subdir(o, dir, x->name);
+                continue;
+            }
+            fm_cmp_state st = classify(&l, x, &r, y);
+            int err = errno;
+            if (st == FM_CMP_SAME) {
+                o->counts[FM_CMP_SAME]++;
+                continue;
+            }
+            if ((it = add_item(o, dir, x->name, st))) {
+                set_left(it, &x->st);
+                set_right(it, &y->st);
+                if (st == FM_CMP_ERROR) it->err = err;
+            }
+        }
+    }
+    side_free(&l);
+    side_free(&r);
+}
+
+/* Directories done across levels */
+typedef struct walk_progress {
+    fm_progress_fn fn;
+    void *ctx;
+    int base;
+} walk_progress;
+
+static void walk_progress_cb(void *ctx, int done, int total) {
+    walk_progress *wp = ctx;
+    wp->fn(wp->ctx, wp->base + done, wp->base + total);
+}
+
+void fm_compare_free(fm_compare *c) {
+    for (int i = 0; i < c->count; ++i) free(c->items[i].rel);
+    free(c->items);
+    c->items = NULL;
+    c->count = 0;
+}
+
+int fm_compare_run(const char *left, const char *right, fm_compare *out, fm_progress_fn progress, void *ctx) {
+    memset(out, 0, sizeof(*out));
+    struct stat ls, rs;
+    if (stat(left, &ls) != 0 || stat(right, &rs) != 0) return -1;
+    if (!S_ISDIR(ls.st_mode) || !S_ISDIR(rs.st_mode)) { errno = ENOTDIR; return -1; }
+    int n1 = snprintf(out->left, sizeof(out->left), "%s", left);
+    int n2 = snprintf(out->right, sizeof(out->right), "%s", right);
+    if (n1 < 0 || (size_t)n1 >= sizeof(out->left) || n2 < 0 || (size_t)n2 >= sizeof(out->right)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    char **dirs = malloc(sizeof(char *));
+    int ndirs = 1, cap = 0, nomem = !dirs;
+    if (dirs && !(dirs[0] = strdup(""))) nomem = 1;
+    walk_progress wp = { progress, ctx, 0 };
+    /* Breadth-first: every directory of a level is independent, so the pool reads them at once */
+    while (!nomem && ndirs > 0) {
+        level lv = { out->left, out->right, dirs, calloc(ndirs, sizeof(job_out)) };
+        if (!lv.outs) { nomem = 1; break; }
+        fm_pool_run(ndirs, level_job, &lv, 0, progress ? walk_progress_cb : NULL, &wp);
+        wp.base += ndirs;
+
+        char **next = NULL;
+        int nnext = 0, nextcap = 0;
+        for (int i = 0; i < ndirs; ++i) {
+            job_out *o = &lv.outs[i];
+            nomem |= o->nomem;
+            for (int s = 0; s < FM_CMP_STATES; ++s) out->counts[s] += o->counts[s];
+            out->dirs += o->dirs;
+            if (!nomem && out->count + o->n > cap) {
+                int ncap = cap ? cap : 1024;
+                while (ncap < out->count + o->n) ncap *= 2;
+                fm_cmp_item *v = realloc(out->items, ncap * sizeof(*v));
+                if (v) { out->items = v; cap = ncap; }
+                else nomem = 1;
+            }
+            if (!nomem) {
+                memcpy(out->items + out->count, o->items, o->n * sizeof(*o->items));
+                out->count += o->n;
+            } else {
+                for (int k = 0; k < o->n; ++k) free(o->items[k].rel);
+            }
+            if (!nomem && nnext + o->nsub > nextcap) {
+                int ncap = nextcap ? nextcap : 64;
+                while (ncap < nnext + o->nsub) ncap *= 2;
+                char **v = realloc(next, ncap * sizeof(*v));
+                if (v) { next = v; nextcap = ncap; }
+                else nomem = 1;
+            }
+            if (!nomem) {
+                memcpy(next + nnext, o->subdirs, o->nsub * sizeof(*o->subdirs));
+                nnext += o->nsub;
+            } else {
+                for (int k = 0; k < o->nsub; ++k) free(o->subdirs[k]);
+            }
+            free(o->items);
+            free(o->subdirs);
+            free(dirs[i]);
+        }
+        free(lv.outs);
+        free(dirs);
+        dirs = next;
+        ndirs = nnext;
+    }
+    if (dirs) {
+        for (int i = 0; i < ndirs; ++i) free(dirs[i]);
+        free(dirs);
+    }
+    if (nomem) {
+        fm_compare_free(out);
+        errno = ENOMEM;
+        return -1;
+    }
+    qsort(out->items, out->count, sizeof(*out->items), item_cmp);
+    return 0;
+}
+
+int fm_compare_hash(fm_compare *c, fm_progress_fn progress, void *ctx) {
+    int n = 0;
+    for (int i = 0; i < c->count; ++i) n += fm_cmp_hashable(&c->items[i]);
+    if (n == 0) return 0;
+    fm_sum_job *jobs = calloc(2 * n, sizeof(*jobs));
+    int *which = malloc(n * sizeof(int));
+    if (!jobs || !which) {
+        free(jobs);
+        free(which);
+        errno = ENOMEM;
+        return -1;
+    }
+    int k = 0;
+    for (int i = 0; i < c->count; ++i) {
+        if (!fm_cmp_hashable(&c->items[i])) continue;
+        which[k] = i;
+        jobs[2 * k].path = join(c->left, c->items[i].rel);
+        jobs[2 * k + 1].path = join(c->right, c->items[i].rel);
+        jobs[2 * k].algo = jobs[2 * k + 1].algo = FM_SUM_XXH64;
+        if (!jobs[2 * k].path || !jobs[2 * k + 1].path) {
+            fm_sum_jobs_free(jobs, 2 * (k + 1));
+            free(which);
+            errno = ENOMEM;
+            return -1;
+        }
+        k++;
+    }
+    /* Both copies of a pair are separate jobs, so the pool reads them concurrently */
+    fm_sum_files(jobs, 2 * n, progress, ctx);
+    for (k = 0; k < n; ++k) {
+        const fm_sum_job *a = &jobs[2 * k], *b = &jobs[2 * k + 1];
+        fm_cmp_item *it = &c->items[which[k]];
+        if (a->err || b->err) continue;
+        it->hashed = 1;
+        if (strcmp(a->hex, b->hex) == 0) {
+            it->state = FM_CMP_SAME;
+            c->counts[FM_CMP_DIFFERENT]--;
+            c->counts[FM_CMP_SAME]++;
+        }
+    }
+    fm_sum_jobs_free(jobs, 2 * n);
+    free(which);
+    return n;
+}
+
+/* ---- background sync ---- */
+
+typedef enum sync_kind { SYNC_COPY, SYNC_DELETE } sync_kind;
+
+typedef struct sync_op {
+    sync_kind kind;
+    char *src;               /* left path (copy) */
+    char *dst;               /* right path */
+} sync_op;
+
+static pthread_t sync_thread;
+static int sync_running;
+static sync_op *sync_ops;
+static int sync_nops, sync_total, sync_conflicts;
+static atomic_int sync_cancel;
+static atomic_int sync_finished;
+static atomic_int sync_done, sync_failed, sync_skipped;
+static atomic_ullong sync_bytes;
+static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
+static int sync_first_errno;
+static char sync_first_failed[PATH_MAX];
+
+static void sync_fail(const char *path, int err) {
+    atomic_fetch_add(&sync_failed, 1);
+    pthread_mutex_lock(&sync_lock);
+    if (!sync_first_errno) {
+        sync_first_errno = err;
+        snprintf(sync_first_failed, sizeof(sync_first_failed), "%s", path);
+    }
+    pthread_mutex_unlock(&sync_lock);
+}
+
+/* mkstemp template beside dst: ".<name>.fmsyncXXXXXX" in the same directory */
+static int temp_template(const char *dst, char *tmp, size_t size) {
+    const char *slash = strrchr(dst, '/');
+    int dirlen = slash ? (int)(slash - dst + 1) : 0;
+    /* The name is shortened so the template stays within NAME_MAX */
+    int n = snprintf(tmp, size, "%.*s.%.200s.fmsyncXXXXXX", dirlen, dst, slash ? slash + 1 : dst);
+    if (n < 0 || (size_t)n >= size) { errno = ENAMETOOLONG; return -1; }
+    return 0;
+}
+
+/* Create a symlink under a fresh name made from a temp_template */
+static int temp_symlink(const char *target, char *tmp) {
+    static atomic_uint seq;
+    size_t len = strlen(tmp);
+    for (int tries = 0; tries < 100; ++tries) {
+        unsigned v = (atomic_fetch_add(&seq, 1) + 1) * 2654435761u ^ (unsigned)getpid();
+        snprintf(tmp + len - 6, 7, "%06x", v & 0xffffff);
+        if (symlink(target, tmp) == 0) return 0;
+        if (errno != EEXIST) return -1;
+    }
+    errno = EEXIST;
+    return -1;
+}
+
+/* Copy a file or symlink to dst through a temporary name beside it, with src's mode and
+ * times, then rename it into place; 0 or -1 with errno set */
+static int sync_entry(const char *src, const char *dst, const struct stat *st, char *buf) {
+    char tmp[PATH_MAX];
+    if (temp_template(dst, tmp, sizeof(tmp)) != 0) return -1;
+    struct timespec times[2] = { st->st_atim, st->st_mtim };
+    int rc = -1, made = 0;
+    if (S_ISREG(st->st_mode)) {
+        /* Without a pool buffer the read/write fallback still works from the stack */
+        char local[16 * 1024];
+        int in = open(src, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        if (in < 0) return -1;
+        int out = mkstemp(tmp);
+        if (out >= 0) {
+            made = 1;
+            fcntl(out, F_SETFD, FD_CLOEXEC);
+            rc = buf ? fm_copy_fd(in, out, buf, SYNC_BUFSIZE) : fm_copy_fd(in, out, local, sizeof(local));
+            /* Mode and mtime as on the left, so the next compare finds the pair equal */
+            if (rc == 0) rc = fchmod(out, st->st_mode & 07777);
+            if (rc == 0) rc = futimens(out, times);
+            int saved = errno;
+            if (close(out) != 0 && rc == 0) { rc = -1; saved = errno; }
+            errno = saved;
+        }
+        int saved = errno;
+        close(in);
+        errno = saved;
+    } else if (S_ISLNK(st->st_mode)) {
+        char target[PATH_MAX];
+        ssize_t len = readlink(src, target, sizeof(target) - 1);
+        if (len >= 0) {
+            target[len] = '\0';
+            rc = temp_symlink(target, tmp);
+            made = rc == 0;
+            if (rc == 0) utimensat(AT_FDCWD, tmp, times, AT_SYMLINK_NOFOLLOW);
+        }
+    } else {
+        errno = ENOTSUP;   /* devices, fifos and sockets are not synced */
+        return -1;
+    }
+    if (rc == 0) rc = rename(tmp, dst);
+    if (rc != 0) {
+        /* Only a name this call created is removed */
+        int saved = errno;
+        if (made) unlink(tmp);
+        errno = saved;
+        return -1;
+    }
+    atomic_fetch_add(&sync_bytes, S_ISREG(st->st_mode) ? (unsigned long long)st->st_size : 0);
+    return 0;
+}
+
+/* Copy of a directory that exists on the left only */
+typedef struct sync_tree {
+    size_t srclen;
+    const char *dst;
+    char *buf;
+    int failed;
+} sync_tree;
+
+static int sync_tree_cb(void *ctx, fm_walk_event ev, const fm_walk_entry *e) {
+    sync_tree *t = ctx;
+    if (atomic_load(&sync_cancel)) return -1;
+    char dst[PATH_MAX];
+    int n = snprintf(dst, sizeof(dst), "%s%s", t->dst, e->path + t->srclen);
+    if (ev == FM_WALK_ERROR || n < 0 || (size_t)n >= sizeof(dst)) {
+        sync_fail(e->path, ev == FM_WALK_ERROR ? e->err : ENAMETOOLONG);
+        t->failed++;
+        return ev == FM_WALK_DIR_PRE ? 1 : 0;
+    }
+    if (ev == FM_WALK_DIR_PRE) {
+        if (mkdir(dst, 0700) != 0 && errno != EEXIST) {
+            sync_fail(dst, errno);
+            t->failed++;
+            return 1;
+        }
+        return 0;
+    }
+    if (ev == FM_WALK_DIR_POST) {
+        /* After the children, so creating them does not bump the copied mtime */
+        struct timespec times[2] = { e->st->st_atim, e->st->st_mtim };
+        if (chmod(dst, e->st->st_mode & 07777) != 0 || utimensat(AT_FDCWD, dst, times, 0) != 0) {
+            sync_fail(dst, errno);
+            t->failed++;
+        }
+        return 0;
+    }
+    if (sync_entry(e->path, dst, e->st, t->buf) != 0) {
+        sync_fail(e->path, errno);
+        t->failed++;
+    }
+    return 0;
+}
+
+static void sync_job(void *ctx, int i, void *buf) {
+    (void)ctx;
+    const sync_op *op = &sync_ops[i];
+    if (atomic_load(&sync_cancel)) {
+        atomic_fetch_add(&sync_skipped, 1);
+        return;
+    }
+    struct stat st;
+    int ok = 0;
+    if (op->kind == SYNC_DELETE) {
+        if (lstat(op->dst, &st) == 0)
+            ok = S_ISDIR(st.st_mode) ? fm_remove_tree(op->dst, NULL, NULL) == 0 : unlink(op->dst) == 0;
+        if (!ok) sync_fail(op->dst, errno ? errno : EIO);
+    } else if (lstat(op->src, &st) != 0) {
+        sync_fail(op->src, errno);
+    } else if (S_ISDIR(st.st_mode)) {
+        sync_tree t = { strlen(op->src), op->dst, buf, 0 };
+        ok = fm_walk(op->src, sync_tree_cb, &t) == 0 && t.failed == 0;
+    } else {
+        ok = sync_entry(op->src, op->dst, &st, buf) == 0;
+        if (!ok) sync_fail(op->src, errno);
+    }
+    if (ok) atomic_fetch_add(&sync_done, 1);
+}
+
+static void *sync_main(void *arg) {
+    (void)arg;
+    fm_pool_run(sync_nops, sync_job, NULL, SYNC_BUFSIZE, NULL, NULL);
+    atomic_store(&sync_finished, 1);
+    return NULL;
+}
+
+static void sync_free_ops(void) {
+    for (int i = 0; i < sync_nops; ++i) {
+        free(sync_ops[i].src);
+        free(sync_ops[i].dst);
+    }
+    free(sync_ops);
+    sync_ops = NULL;
+    sync_nops = 0;
+}
+
+/* Whether a is b or lies below it (both canonical) */
+static int path_within(const char *a, const char *b) {
+    size_t n = strlen(b);
+    if (n == 1 && b[0] == '/') return 1;
+    return strncmp(a, b, n) == 0 && (a[n] == '\0' || a[n] == '/');
+}
+
+int fm_sync_start(const fm_compare *c, int mirror) {
+    if (sync_running) { errno = EBUSY; return -1; }
+    char l[PATH_MAX], r[PATH_MAX];
+    if (!realpath(c->left, l) || !realpath(c->right, r)) return -1;
+    /* Copying a tree into itself would never end */
+    if (path_within(l, r) || path_within(r, l)) { errno = EINVAL; return -1; }
+
+    sync_free_ops();
+    sync_ops = malloc((c->count ? c->count : 1) * sizeof(*sync_ops));
+    if (!sync_ops) { errno = ENOMEM; return -1; }
+    sync_conflicts = 0;
+    for (int i = 0; i < c->count; ++i) {
+        const fm_cmp_item *it = &c->items[i];
+        sync_op op = { SYNC_COPY, NULL, NULL };
+        if (it->state == FM_CMP_ONLY_RIGHT && mirror) {
+            op.kind = SYNC_DELETE;
+        } else if (it->state == FM_CMP_DIFFERENT) {
+            /* Only a file or symlink replaces one of its own type */
+            if ((it->lmode & S_IFMT) != (it->rmode & S_IFMT) || !(S_ISREG(it->lmode) || S_ISLNK(it->lmode))) {
+                sync_conflicts++;
+                continue;
+            }
+        } else if (it->state != FM_CMP_ONLY_LEFT) {
+            continue;
+        }
+        if ((op.kind == SYNC_COPY && !(op.src = join(c->left, it->rel))) || !(op.dst = join(c->right, it->rel))) {
+            free(op.src);
+            sync_free_ops();
+            errno = ENOMEM;
+            return -1;
+        }
+        sync_ops[sync_nops++] = op;
+    }
+
+    sync_total = sync_nops;
+    sync_first_errno = 0;
+    sync_first_failed[0] = '\0';
+    atomic_store(&sync_cancel, 0);
+    atomic_store(&sync_finished, 0);
+    atomic_store(&sync_done, 0);
+    atomic_store(&sync_failed, 0);
+    atomic_store(&sync_skipped, 0);
+    atomic_store(&sync_bytes, 0);
+    if (pthread_create(&sync_thread, NULL, sync_main, NULL) != 0) {
+        sync_free_ops();
+        errno = EAGAIN;
+        return -1;
+    }
+    sync_running = 1;
+    return 0;
+}
+
+int fm_sync_poll(fm_sync_stats *stats) {
+    if (!sync_running) return -1;
+    int finished = atomic_load(&sync_finished);
+    stats->total = sync_total;
+    stats->done = atomic_load(&sync_done);
+    stats->failed = atomic_load(&sync_failed);
+    stats->skipped = atomic_load(&sync_skipped) + sync_conflicts;
+    stats->bytes = atomic_load(&sync_bytes);
+    pthread_mutex_lock(&sync_lock);
+    stats->first_errno = sync_first_errno;
+    snprintf(stats->first_failed, sizeof(stats->first_failed), "%s", sync_first_failed);
+    pthread_mutex_unlock(&sync_lock);
+    if (!finished) return 0;
+    pthread_join(sync_thread, NULL);
+    sync_running = 0;
+    sync_free_ops();
+    return 1;
+}
+
+void fm_sync_stop(void) {
+    if (!sync_running) return;
+    atomic_store(&sync_cancel, 1);
+    pthread_join(sync_thread, NULL);
+    sync_running = 0;
+    sync_free_ops();
+}
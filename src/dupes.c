@@ -0,0 +1,274 @@
+#define _XOPEN_SOURCE 700
+#include "dupes.h"
+#include "fs.h"
+#include "hash.h"
+#include "pool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+/* Sequential read size for the full-content pass */
+#define DUPE_READ_SIZE (1024 * 1024)
+
+typedef struct collect_ctx {
+    fm_dupe_file *files;
+    int count, cap;
+    fm_dupes_progress_fn progress;
+    void *pctx;
+} collect_ctx;
+
+static int collect_cb(void *ctx, fm_walk_event ev, const fm_walk_entry *e) {
+    collect_ctx *c = ctx;
+    if (ev != FM_WALK_FILE || !S_ISREG(e->st->st_mode) || e->st->st_size == 0) return 0;
+    if (c->count == c->cap) {
+        int cap = c->cap ? c->cap * 2 : 1024;
+        fm_dupe_file *nf = realloc(c->files, cap * sizeof(*nf));
+        if (!nf) return -1;
+        c->files = nf;
+        c->cap = cap;
+    }
+    fm_dupe_file *f = &c->files[c->count];
+    memset(f, 0, sizeof(*f));
+    if (!(f->path = strdup(e->path))) return -1;
+    f->size = e->st->st_size;
+    f->dev = e->st->st_dev;
+    f->ino = e->st->st_ino;
+    f->mtime = e->st->st_mtim;
+    c->count++;
+    if (c->progress && c->count % 4096 == 0) c->progress(c->pctx, "Scanning", c->count, 0);
+    return 0;
+}
+
+static int cmp_inode(const void *a, const void *b) {
+    const fm_dupe_file *x = a, *y = b;
+    if (x->dev != y->dev) return x->dev < y->dev ? -1 : 1;
+    if (x->ino != y->ino) return x->ino < y->ino ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+/* Largest first, then by the hashes computed so far (zero until a stage has run) */
+static int cmp_content(const void *a, const void *b) {
+    const fm_dupe_file *x = a, *y = b;
+    if (x->size != y->size) return x->size > y->size ? -1 : 1;
+    if (x->edge != y->edge) return x->edge < y->edge ? -1 : 1;
+    if (x->body != y->body) return x->body < y->body ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+static int same_content(const fm_dupe_file *x, const fm_dupe_file *y) {
+    return x->size == y->size && x->edge == y->edge && x->body == y->body;
+}
+
+/* Keep only runs of two or more files with equal keys (array sorted by cmp_content) */
+static int keep_runs(fm_dupe_file *f, int n) {
+    int out = 0;
+    for (int i = 0; i < n; ) {
+        int j = i + 1;
+        while (j < n && same_content(&f[i], &f[j])) j++;
+        for (int k = i; k < j; ++k) {
+            if (j - i >= 2) f[out++] = f[k];
+            else free(f[k].path);
+        }
+        i = j;
+    }
+    return out;
+}
+
+/* Drop files that failed to read, counting them */
+static int drop_errors(fm_dupe_file *f, int n, unsigned long *errors) {
+    int out = 0;
+    for (int i = 0; i < n; ++i) {
+        if (f[i].err) { free(f[i].path); (*errors)++; }
+        else f[out++] = f[i];
+    }
+    return out;
+}
+
+typedef enum hash_stage { STAGE_EDGE, STAGE_BODY } hash_stage;
+
+typedef struct hash_pass {
+    fm_dupe_file **jobs;
+    hash_stage stage;
+    atomic_ullong bytes;
+    const char *name;
+    fm_dupes_progress_fn progress;
+    void *pctx;
+} hash_pass;
+
+static ssize_t pread_full(int fd, unsigned char *buf, size_t len, off_t off) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = pread(fd, buf + got, len - got, off + got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return -1;
+        if (r == 0) break;
+        got += r;
+    }
+    return got;
+}
+
+/* Hash [off, off + len) into s; returns bytes read or -1 */
+static long long hash_range(int fd, fm_xxh64_state *s, unsigned char *buf, off_t off, off_t len) {
+    long long total = 0;
+    while (len > 0) {
+        size_t want = len < DUPE_READ_SIZE ? (size_t)len : DUPE_READ_SIZE;
+        ssize_t r = pread_full(fd, buf, want, off);
+        if (r < 0) return -1;
+        if (r == 0) { errno = EIO; return -1; }   /* shrank underneath us */
+        fm_xxh64_update(s, buf, r);
+        off += r;
+        len -= r;
+        total += r;
+    }
+    return total;
+}
+
+/* Edge stage reads two small blocks; body stage reads only what the edges did not cover */
+static void hash_job(void *ctx, int i, void *buf) {
+    hash_pass *pass = ctx;
+    fm_dupe_file *f = pass->jobs[i];
+    if (!buf) { f->err = ENOMEM; return; }
+    int fd = open(f->path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) { f->err = errno; return; }
+    fm_xxh64_state s;
+    fm_xxh64_init(&s, 0);
+    long long got;
+    off_t head = f->size < FM_DUPE_EDGE ? f->size : FM_DUPE_EDGE;
+    if (pass->stage == STAGE_EDGE) {
+        off_t tail_off = f->size - FM_DUPE_EDGE > head ? f->size - FM_DUPE_EDGE : head;
+        got = hash_range(fd, &s, buf, 0, head);
+        if (got >= 0 && tail_off < f->size) {
+            long long t = hash_range(fd, &s, buf, tail_off, f->size - tail_off);
+            got = t < 0 ? -1 : got + t;
+        }
+        if (got >= 0) f->edge = fm_xxh64_digest(&s);
+    } else {
+        off_t len = f->size - 2 * (off_t)FM_DUPE_EDGE;
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, head, len, POSIX_FADV_SEQUENTIAL);
+#endif
+        got = hash_range(fd, &s, buf, head, len);
+        /* Never 0, so hashed bodies stay distinct from files the edges covered */
+        if (got >= 0) f->body = fm_xxh64_digest(&s) | 1;
+    }
+    if (got < 0) f->err = errno ? errno : EIO;
+    else atomic_fetch_add(&pass->bytes, (unsigned long long)got);
+    close(fd);
+}
+
+static void pass_progress(void *ctx, int done, int total) {
+    hash_pass *pass = ctx;
+    if (pass->progress) pass->progress(pass->pctx, pass->name, done, total);
+}
+
+static int cmp_job(const void *a, const void *b) {
+    return cmp_inode(*(fm_dupe_file *const *)a, *(fm_dupe_file *const *)b);
+}
+
+/* Hash the files that still need the given stage in parallel; inode order approximates disk order */
+static int hash_stage_run(fm_dupes *d, hash_stage stage, fm_dupes_progress_fn progress, void *ctx) {
+    hash_pass pass;
+    memset(&pass, 0, sizeof(pass));
+    pass.stage = stage;
+    pass.name = stage == STAGE_EDGE ? "Hashing edges" : "Hashing contents";
+    pass.progress = progress;
+    pass.pctx = ctx;
+    pass.jobs = malloc((d->nfiles ? d->nfiles : 1) * sizeof(*pass.jobs));
+    if (!pass.jobs) return -1;
+    int n = 0;
+    for (int i = 0; i < d->nfiles; ++i) {
+        if (stage == STAGE_BODY && d->files[i].size <= 2 * (off_t)FM_DUPE_EDGE) continue;
+        pass.jobs[n++] = &d->files[i];
+    }
+    qsort(pass.jobs, n, sizeof(*pass.jobs), cmp_job);
+    fm_pool_run(n, hash_job, &pass, DUPE_READ_SIZE, pass_progress, &pass);
+    d->bytes_read += atomic_load(&pass.bytes);
+    free(pass.jobs);
+    return 0;
+}
+
+/* Regroup after a stage: drop unreadable files and any file left without a twin */
+static void regroup(fm_dupes *d) {
+    d->nfiles = drop_errors(d->files, d->nfiles, &d->errors);
+    qsort(d->files, d->nfiles, sizeof(*d->files), cmp_content);
+    d->nfiles = keep_runs(d->files, d->nfiles);
+}
+
+int fm_find_dupes(const char *root, fm_dupes *out, fm_dupes_progress_fn progress, void *ctx) {
+    memset(out, 0, sizeof(*out));
+    collect_ctx c = { NULL, 0, 0, progress, ctx };
+    if (fm_walk(root, collect_cb, &c) != 0) {
+        int saved = errno ? errno : ENOMEM;
+        out->files = c.files;
+        out->nfiles = c.count;
+        fm_dupes_free(out);
+        errno = saved;
+        return -1;
+    }
+    out->files = c.files;
+    out->nfiles = c.count;
+    out->scanned = c.count;
+
+    /* Extra links to one inode share storage: keep one path per inode */
+    qsort(out->files, out->nfiles, sizeof(*out->files), cmp_inode);
+    int n = 0;
+    for (int i = 0; i < out->nfiles; ++i) {
+        if (n > 0 && out->files[n - 1].dev == out->files[i].dev &&
+            out->files[n - 1].ino == out->files[i].ino) {
+            free(out->files[i].path);
+            out->hardlinks++;
+            continue;
+        }
+        out->files[n++] = out->files[i];
+    }
+    out->nfiles = n;
+
+    /* Stage 1: size. Stage 2: both edges. Stage 3: the middle, for survivors only */
+    regroup(out);
+    if (hash_stage_run(out, STAGE_EDGE, progress, ctx) != 0) goto nomem;
+    regroup(out);
+    if (hash_stage_run(out, STAGE_BODY, progress, ctx) != 0) goto nomem;
+    regroup(out);
+
+    out->groups = malloc((out->nfiles / 2 + 1) * sizeof(*out->groups));
+    if (!out->groups) goto nomem;
+    for (int i = 0; i < out->nfiles; ) {
+        int j = i + 1;
+        while (j < out->nfiles && same_content(&out->files[i], &out->files[j])) j++;
+        out->groups[out->ngroups].first = i;
+        out->groups[out->ngroups].count = j - i;
+        out->ngroups++;
+        out->wasted += (unsigned long long)(j - i - 1) * out->files[i].size;
+        i = j;
+    }
+    return 0;
+
+nomem:
+    fm_dupes_free(out);
+    errno = ENOMEM;
+    return -1;
+}
+
+void fm_dupes_free(fm_dupes *d) {
+    for (int i = 0; i < d->nfiles; ++i) free(d->files[i].path);
+    free(d->files);
+    free(d->groups);
+    d->files = NULL;
+    d->groups = NULL;
+    d->nfiles = d->ngroups = 0;
+}
+
+int fm_dupe_unchanged(const fm_dupe_file *f) {
+    struct stat st;
+    if (lstat(f->path, &st) != 0) return -1;
+    if (!S_ISREG(st.st_mode) || st.st_dev != f->dev || st.st_ino != f->ino || st.st_size != f->size ||
+        st.st_mtim.tv_sec != f->mtime.tv_sec || st.st_mtim.tv_nsec != f->mtime.tv_nsec) {
+        return -1;
+    }
+    return 0;
+}
@@ -1,5 +1,6 @@
 #define _XOPEN_SOURCE 700
 #include "fs.h"
+#include "perf.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <dirent.h>
@@ -9,8 +10,11 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <limits.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
-static int entry_cmp(const void *pa, const void *pb) {
+int fm_entry_cmp(const void *pa, const void *pb) {
     const fm_entry *a = pa;
     const fm_entry *b = pb;
     if (a->is_dir && !b->is_dir) return -1;
@@ -19,11 +23,14 @@ static int entry_cmp(const void *pa, const void *pb) {
 }
 
 int fm_read_dir(const char *path, fm_entry **entries_out) {
+    FM_PERF_START(scan_t0);
     DIR *d = opendir(path);
     if (!d) return -1;
     struct dirent *ent;
     fm_entry *arr = NULL;
     int cap = 0, n = 0;
+    size_t plen = strlen(path);
+    const char *sep = plen && path[plen - 1] == '/' ? "" : "/";
     while ((ent = readdir(d)) != NULL) {
         if (strcmp(ent->d_name, ".") == 0) continue;
         if (n + 1 > cap) {
@@ -34,7 +41,9 @@ int fm_read_dir(const char *path, fm_entry **entries_out) {
         }
         fm_entry *e = &arr[n++];
         snprintf(e->name, sizeof(e->name), "%s", ent->d_name);
-        snprintf(e->path, sizeof(e->path), "%s/%s", path, ent->d_name);
+        /* No doubled slash under "/", so entry paths match the realpath'd cache keys */
+        snprintf(e->path, sizeof(e->path), "%s%s%s", path, sep, ent->d_name);
+        FM_PERF_ADD(stat_calls, 1);
         if (lstat(e->path, &e->st) == -1) {
             memset(&e->st, 0, sizeof(e->st));
             e->is_dir = 0;
@@ -43,8 +52,12 @@ int fm_read_dir(const char *path, fm_entry **entries_out) {
         }
     }
     closedir(d);
+    FM_PERF_STOP(scan_t0, scan_ns);
+    FM_PERF_ADD(entries, n);
     // simple sort: directories first, then name
-    if (n > 0) qsort(arr, n, sizeof(fm_entry), entry_cmp);
+    FM_PERF_START(sort_t0);
+    if (n > 0) qsort(arr, n, sizeof(fm_entry), fm_entry_cmp);
+    FM_PERF_STOP(sort_t0, sort_ns);
     *entries_out = arr;
     return n;
 }
@@ -64,21 +77,86 @@ int fm_rename(const char *oldpath, const char *newpath) {
     return rename(oldpath, newpath);
 }
 
+int fm_link_replace(const char *target, const char *path) {
+    /* Link under a temporary name first so path is never missing if we fail */
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.fmlink%ld", path, (long)getpid()) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (link(target, tmp) != 0) return -1;
+    if (rename(tmp, path) != 0) {
+        int saved = errno;
+        unlink(tmp);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+int fm_copy_fd(int in, int out, char *buf, size_t bufsize) {
+#ifdef __linux__
+    /* File-to-file sendfile keeps the data in the kernel (no copy through buf) */
+    int sent = 0;
+    for (;;) {
+        ssize_t r = sendfile(out, in, NULL, 1 << 30);
+        if (r > 0) { sent = 1; continue; }
+        if (r == 0) return 0;
+        if (errno == EINTR) continue;
+        /* Unsupported for this pair of files: nothing was consumed, use read/write */
+        if (sent || (errno != EINVAL && errno != ENOSYS)) return -1;
+        break;
+    }
+#endif
+    ssize_t r;
+    while ((r = read(in, buf, bufsize)) != 0) {
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        char *p = buf;
+        while (r > 0) {
+            ssize_t w = write(out, p, r);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            r -= w; p += w;
+        }
+    }
+    return 0;
+}
+
+/* Open the target of a copy from in, truncating it only once it is known not to be the
+ * source itself (the same path, or a hard link to it); EINVAL if it is */
+static int open_copy_target(int dirfd, const char *name, int in, mode_t mode) {
+    int out = openat(dirfd, name, O_WRONLY | O_CREAT, mode);
+    if (out < 0) return -1;
+    struct stat sst, dst;
+    int rc = fstat(in, &sst) == 0 && fstat(out, &dst) == 0 ? 0 : -1;
+    if (rc == 0 && sst.st_dev == dst.st_dev && sst.st_ino == dst.st_ino) {
+        errno = EINVAL;
+        rc = -1;
+    }
+    if (rc == 0) rc = ftruncate(out, 0);
+    if (rc != 0) {
+        int saved = errno;
+        close(out);
+        errno = saved;
+        return -1;
+    }
+    return out;
+}
+
 int fm_copy_file(const char *src, const char *dst) {
     int in = open(src, O_RDONLY);
     if (in < 0) return -1;
-    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (out < 0) { close(in); return -1; }
+    int out = open_copy_target(AT_FDCWD, dst, in, 0644);
+    if (out < 0) { int saved = errno; close(in); errno = saved; return -1; }
     char buf[8192];
-    ssize_t r;
-    while ((r = read(in, buf, sizeof(buf))) > 0) {
-        char *p = buf;
-        ssize_t w;
-        while (r > 0 && (w = write(out, p, r)) > 0) { r -= w; p += w; }
-        if (w < 0) { close(in); close(out); return -1; }
-    }
+    int rc = fm_copy_fd(in, out, buf, sizeof(buf));
     close(in); close(out);
-    return 0;
+    return rc;
 }
 
 int fm_create_file(const char *path) {
@@ -162,3 +240,379 @@ ssize_t fm_read_file(const char *path, char **content_out) {
     *content_out = buf;
     return total;
 }
+
+#define BATCH_BUFSIZE (256 * 1024)
+
+/* Copy one entry between two open directories; the target must not exist */
+static int batch_copy(int sfd, int dfd, const fm_entry *e, char *buf) {
+    int in = openat(sfd, e->name, O_RDONLY | O_NOFOLLOW);
+    if (in < 0) return -1;
+    int out = openat(dfd, e->name, O_WRONLY | O_CREAT | O_EXCL, e->st.st_mode & 0777);
+    if (out < 0) { int saved = errno; close(in); errno = saved; return -1; }
+    int rc = fm_copy_fd(in, out, buf, BATCH_BUFSIZE);
+    int saved = errno;
+    close(in);
+    if (close(out) < 0 && rc == 0) { rc = -1; saved = errno; }
+    if (rc < 0) unlinkat(dfd, e->name, 0);
+    errno = saved;
+    return rc;
+}
+
+int fm_batch_run(const fm_batch *job, const fm_entry *const *entries, int n, fm_batch_result *res) {
+    memset(res, 0, sizeof(*res));
+    int sfd = open(job->dir, O_RDONLY | O_DIRECTORY);
+    if (sfd < 0) {
+        res->failed = n;
+        res->first_errno = errno;
+        return -1;
+    }
+    int dfd = -1;
+    if (job->op == FM_BATCH_MOVE || job->op == FM_BATCH_COPY) {
+        dfd = open(job->dest, O_RDONLY | O_DIRECTORY);
+        if (dfd < 0) {
+            res->failed = n;
+            res->first_errno = errno;
+            close(sfd);
+            return -1;
+        }
+    }
+    char *buf = NULL;
+    if (job->op == FM_BATCH_COPY || job->op == FM_BATCH_MOVE) buf = malloc(BATCH_BUFSIZE);
+
+    for (int i = 0; i < n; ++i) {
+        const fm_entry *e = entries[i];
+        int rc = 0;
+        /* The listing already carries lstat data, so no per-entry stat here */
+        switch (job->op) {
+        case FM_BATCH_DELETE:
+            rc = unlinkat(sfd, e->name, e->is_dir ? AT_REMOVEDIR : 0);
+            break;
+        case FM_BATCH_MOVE:
+            rc = renameat(sfd, e->name, dfd, e->name);
+            /* Across filesystems fall back to copy + unlink for regular files */
+            if (rc < 0 && errno == EXDEV && S_ISREG(e->st.st_mode) && buf) {
+                rc = batch_copy(sfd, dfd, e, buf);
+                if (rc == 0) rc = unlinkat(sfd, e->name, 0);
+            }
+            break;
+        case FM_BATCH_COPY:
+            if (!S_ISREG(e->st.st_mode)) { res->skipped++; goto next; }
+            if (!buf) { rc = -1; errno = ENOMEM; break; }
+            rc = batch_copy(sfd, dfd, e, buf);
+            break;
+        case FM_BATCH_CHMOD:
+            if (S_ISLNK(e->st.st_mode)) { res->skipped++; goto next; }
+            rc = fchmodat(sfd, e->name, job->mode, 0);
+            break;
+        }
+        if (rc == 0) {
+            res->done++;
+        } else {
+            if (res->failed++ == 0) {
+                res->first_errno = errno;
+                snprintf(res->first_failed, sizeof(res->first_failed), "%s", e->name);
+            }
+        }
+    next:
+        if (job->progress) job->progress(job->progress_ctx, i + 1, n);
+    }
+
+    free(buf);
+    if (dfd >= 0) close(dfd);
+    close(sfd);
+    return res->failed ? -1 : 0;
+}
+
+/* Directories at this depth and below are read into memory before their children are
+ * walked, and their fd is given up while a subdirectory is walked, so a walk holds about
+ * this many directory fds however deep the tree is */
+#define WALK_MAX_OPEN 16
+
+static int walk_children(int fd, char *path, size_t len, int depth, fm_walk_fn fn, void *ctx);
+
+/* Recursive worker for fm_walk; path holds the full path of (*dirfd, name) and the first
+ * plen bytes are the path of *dirfd. With detach the parent fd is closed while the children
+ * are walked and opened again (and checked to be the same directory) before DIR_POST */
+static int walk_entry(int *dirfd, const char *name, char *path, size_t len, size_t plen, int depth,
+                      int detach, fm_walk_fn fn, void *ctx) {
+    struct stat st;
+    fm_walk_entry e = { path, name, *dirfd, &st, depth, 0 };
+    FM_PERF_ADD(stat_calls, 1);
+    FM_PERF_ADD(entries, 1);
+    if (fstatat(*dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        e.st = NULL;
+        e.err = errno;
+        return fn(ctx, FM_WALK_ERROR, &e) < 0 ? -1 : 0;
+    }
+    if (!S_ISDIR(st.st_mode)) return fn(ctx, FM_WALK_FILE, &e) < 0 ? -1 : 0;
+
+    int rc = fn(ctx, FM_WALK_DIR_PRE, &e);
+    if (rc < 0) return -1;
+    if (rc == 0) {
+        int fd = openat(*dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) {
+            e.err = errno;
+            if (fn(ctx, FM_WALK_ERROR, &e) < 0) return -1;
+        } else {
+            struct stat pst;
+            int reopen = detach && fstat(*dirfd, &pst) == 0;
+            if (reopen) {
+                close(*dirfd);
+                *dirfd = -1;
+            }
+            rc = walk_children(fd, path, len, depth, fn, ctx);
+            if (reopen) {
+                char c = path[plen];
+                path[plen] = '\0';
+                int pfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                path[plen] = c;
+                struct stat now;
+                if (pfd < 0 || fstat(pfd, &now) != 0 || now.st_dev != pst.st_dev || now.st_ino != pst.st_ino) {
+                    /* The parent was moved or cannot be opened: the walk cannot go on */
+                    e.err = pfd < 0 ? errno : ESTALE;
+                    if (pfd >= 0) close(pfd);
+                    fn(ctx, FM_WALK_ERROR, &e);
+                    errno = e.err;
+                    return -1;
+                }
+                *dirfd = pfd;
+                e.dirfd = pfd;
+            }
+            if (rc < 0) return -1;
+        }
+    }
+    return fn(ctx, FM_WALK_DIR_POST, &e) < 0 ? -1 : 0;
+}
+
+/* Append "/name" to path; the new length, or 0 (after reporting) if it does not fit */
+static size_t walk_join(char *path, size_t len, const char *name, int fd, int depth,
+                        fm_walk_fn fn, void *ctx, int *rc) {
+    int n = snprintf(path + len, PATH_MAX - len, "%s%s", len > 0 && path[len - 1] == '/' ? "" : "/", name);
+    if (n < 0 || (size_t)n >= PATH_MAX - len) {
+        fm_walk_entry err = { path, name, fd, NULL, depth, ENAMETOOLONG };
+        *rc = fn(ctx, FM_WALK_ERROR, &err) < 0 ? -1 : 0;
+        path[len] = '\0';
+        return 0;
+    }
+    return len + n;
+}
+
+/* Walk the entries of the directory open as fd (at the given depth); closes fd */
+static int walk_children(int fd, char *path, size_t len, int depth, fm_walk_fn fn, void *ctx) {
+    fm_walk_entry self = { path, path, fd, NULL, depth, 0 };
+    int rc = 0;
+    if (depth < WALK_MAX_OPEN) {
+        DIR *d = fdopendir(fd);
+        if (!d) {
+            self.err = errno;
+            close(fd);
+            return fn(ctx, FM_WALK_ERROR, &self) < 0 ? -1 : 0;
+        }
+        struct dirent *ent;
+        while (rc == 0 && (ent = readdir(d)) != NULL) {
+            if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+            size_t clen = walk_join(path, len, ent->d_name, fd, depth + 1, fn, ctx, &rc);
+            if (clen) rc = walk_entry(&fd, ent->d_name, path, clen, len, depth + 1, 0, fn, ctx);
+            path[len] = '\0';
+        }
+        closedir(d);
+        return rc;
+    }
+
+    /* Deep: read the names first so only fd stays open, and let each child close it */
+    char **names = NULL;
+    int count = 0, cap = 0;
+    int sfd = dup(fd);
+    DIR *d = sfd >= 0 ? fdopendir(sfd) : NULL;
+    if (!d) {
+        self.err = errno;
+        if (sfd >= 0) close(sfd);
+        close(fd);
+        return fn(ctx, FM_WALK_ERROR, &self) < 0 ? -1 : 0;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            char **tmp = realloc(names, cap * sizeof(*names));
+            if (!tmp) break;
+            names = tmp;
+        }
+        if (!(names[count] = strdup(ent->d_name))) break;
+        count++;
+    }
+    if (ent) {
+        self.err = ENOMEM;
+        if (fn(ctx, FM_WALK_ERROR, &self) < 0) rc = -1;
+    }
+    closedir(d);
+    for (int i = 0; i < count && rc == 0; ++i) {
+        size_t clen = walk_join(path, len, names[i], fd, depth + 1, fn, ctx, &rc);
+        if (clen) rc = walk_entry(&fd, names[i], path, clen, len, depth + 1, 1, fn, ctx);
+        path[len] = '\0';
+    }
+    for (int i = 0; i < count; ++i) free(names[i]);
+    free(names);
+    if (fd >= 0) close(fd);
+    return rc;
+}
+
+int fm_walk(const char *root, fm_walk_fn fn, void *ctx) {
+    char path[PATH_MAX];
+    size_t len = snprintf(path, sizeof(path), "%s", root);
+    if (len >= sizeof(path)) { errno = ENAMETOOLONG; return -1; }
+    int cwd = AT_FDCWD;
+    return walk_entry(&cwd, root, path, len, 0, 0, 0, fn, ctx);
+}
+
+typedef struct tree_op {
+    fm_report_fn report;
+    void *ctx;
+    int failed;
+    /* copy only */
+    const char *dst;
+    size_t srclen;
+    int *dfds;              /* dfds[d]: destination directory for entries at depth d */
+    int dfds_cap;
+    dev_t root_dev;
+    ino_t root_ino;
+    char *buf;
+} tree_op;
+
+static void tree_report(tree_op *op, const char *path, off_t bytes, int err) {
+    if (err) op->failed++;
+    if (op->report) op->report(op->ctx, path, bytes, err);
+}
+
+static int remove_cb(void *ctx, fm_walk_event ev, const fm_walk_entry *e) {
+    tree_op *op = ctx;
+    int rc = 0;
+    switch (ev) {
+    case FM_WALK_ERROR:
+        tree_report(op, e->path, 0, e->err);
+        return 0;
+    case FM_WALK_DIR_PRE:
+        return 0;
+    case FM_WALK_FILE:
+        rc = unlinkat(e->dirfd, e->name, 0);
+        break;
+    case FM_WALK_DIR_POST:
+        rc = unlinkat(e->dirfd, e->name, AT_REMOVEDIR);
+        break;
+    }
+    tree_report(op, e->path, 0, rc == 0 ? 0 : errno);
+    return 0;
+}
+
+int fm_remove_tree(const char *path, fm_report_fn report, void *ctx) {
+    tree_op op = { report, ctx, 0, NULL, 0, NULL, 0, 0, 0, NULL };
+    fm_walk(path, remove_cb, &op);
+    return op.failed ? -1 : 0;
+}
+
+static int copy_cb(void *ctx, fm_walk_event ev, const fm_walk_entry *e) {
+    tree_op *op = ctx;
+    /* The root maps onto dst itself; deeper entries keep their name under dfds[depth], and
+     * below the levels fm_walk keeps open the target is addressed by path instead */
+    char tpath[PATH_MAX];
+    int tdfd = e->depth == 0 ? AT_FDCWD : op->dfds[e->depth];
+    const char *tname = e->depth == 0 ? op->dst : e->name;
+
+    if (ev == FM_WALK_ERROR) {
+        tree_report(op, e->path, 0, e->err);
+        return 0;
+    }
+    if (e->depth > WALK_MAX_OPEN) {
+        int n = snprintf(tpath, sizeof(tpath), "%s%s", op->dst, e->path + op->srclen);
+        if (n < 0 || (size_t)n >= sizeof(tpath)) {
+            tree_report(op, e->path, 0, ENAMETOOLONG);
+            return 1;
+        }
+        tdfd = AT_FDCWD;
+        tname = tpath;
+    } else if (e->depth > 0 && tdfd < 0) {
+        return 1;   /* parent could not be created */
+    }
+
+    if (ev == FM_WALK_DIR_PRE) {
+        /* Never descend into the copy being created (dst inside src) */
+        if (e->depth > 0 && e->st->st_dev == op->root_dev && e->st->st_ino == op->root_ino) return 1;
+        if (e->depth + 1 >= op->dfds_cap) {
+            int cap = op->dfds_cap ? op->dfds_cap * 2 : 32;
+            int *tmp = realloc(op->dfds, cap * sizeof(int));
+            if (!tmp) { tree_report(op, e->path, 0, ENOMEM); return -1; }
+            op->dfds = tmp;
+            op->dfds_cap = cap;
+        }
+        op->dfds[e->depth + 1] = -1;
+        if (mkdirat(tdfd, tname, 0700) != 0 && errno != EEXIST) {
+            tree_report(op, e->path, 0, errno);
+            return 1;
+        }
+        if (e->depth >= WALK_MAX_OPEN) return 0;
+        int fd = openat(tdfd, tname, O_RDONLY | O_DIRECTORY);
+        if (fd < 0) {
+            tree_report(op, e->path, 0, errno);
+            return 1;
+        }
+        if (e->depth == 0) {
+            struct stat st;
+            if (fstat(fd, &st) == 0) { op->root_dev = st.st_dev; op->root_ino = st.st_ino; }
+        }
+        op->dfds[e->depth + 1] = fd;
+        return 0;
+    }
+    if (ev == FM_WALK_DIR_POST) {
+        /* Final permissions are applied after the children were written */
+        if (e->depth >= WALK_MAX_OPEN) {
+            int rc = fchmodat(tdfd, tname, e->st->st_mode & 07777, 0);
+            tree_report(op, e->path, 0, rc == 0 ? 0 : errno);
+            return 0;
+        }
+        int fd = op->dfds[e->depth + 1];
+        if (fd < 0) return 0;
+        int rc = fchmod(fd, e->st->st_mode & 07777);
+        close(fd);
+        op->dfds[e->depth + 1] = -1;
+        tree_report(op, e->path, 0, rc == 0 ? 0 : errno);
+        return 0;
+    }
+
+    int rc = -1;
+    off_t copied = 0;
+    if (S_ISREG(e->st->st_mode)) {
+        int in = openat(e->dirfd, e->name, O_RDONLY | O_NOFOLLOW);
+        int out = in < 0 ? -1 : open_copy_target(tdfd, tname, in, e->st->st_mode & 0777);
+        if (in >= 0 && out >= 0) rc = fm_copy_fd(in, out, op->buf, BATCH_BUFSIZE);
+        int saved = errno;
+        /* The target was empty, so its offset is what was actually written */
+        if (rc == 0) {
+            off_t pos = lseek(out, 0, SEEK_CUR);
+            copied = pos > 0 ? pos : 0;
+        }
+        if (in >= 0) close(in);
+        if (out >= 0 && close(out) != 0 && rc == 0) { rc = -1; saved = errno; }
+        errno = saved;
+    } else if (S_ISLNK(e->st->st_mode)) {
+        char target[PATH_MAX];
+        ssize_t n = readlinkat(e->dirfd, e->name, target, sizeof(target) - 1);
+        if (n >= 0) {
+            target[n] = '\0';
+            rc = symlinkat(target, tdfd, tname);
+        }
+    } else {
+        errno = ENOTSUP;   /* devices, fifos and sockets are not copied */
+    }
+    tree_report(op, e->path, rc == 0 ? copied : 0, rc == 0 ? 0 : errno);
+    return 0;
+}
+
+int fm_copy_tree(const char *src, const char *dst, fm_report_fn report, void *ctx) {
+    tree_op op = { report, ctx, 0, dst, strlen(src), NULL, 0, 0, 0, malloc(BATCH_BUFSIZE) };
+    if (!op.buf) return -1;
+    int rc = fm_walk(src, copy_cb, &op);
+    free(op.buf);
+    free(op.dfds);
+    return (rc < 0 || op.failed) ? -1 : 0;
+}
@@ -0,0 +1,305 @@
+#define _XOPEN_SOURCE 700
+#include "gzview.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* A gzip member trailer: CRC-32 and length */
+#define GZ_TRAILER 8
+
+int fm_gz_is_gzip(const char *path) {
+    unsigned char magic[2];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t n = pread(fd, magic, sizeof(magic), 0);
+    close(fd);
+    return n == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+fm_gz *fm_gz_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    unsigned char magic[2];
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return NULL;
+    }
+    if (pread(fd, magic, sizeof(magic), 0) != 2 || magic[0] != 0x1f || magic[1] != 0x8b) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    fm_gz *gz = calloc(1, sizeof(*gz));
+    if (gz) {
+        gz->cache = malloc(FM_GZ_CACHE);
+        gz->points = calloc(FM_GZ_MAX_POINTS, sizeof(fm_gz_point));
+    }
+    if (!gz || !gz->cache || !gz->points) {
+        if (gz) {
+            free(gz->cache);
+            free(gz->points);
+            free(gz);
+        }
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    gz->fd = fd;
+    gz->csize = st.st_size;
+    gz->span = FM_GZ_SPAN;
+    /* The file itself starts with a member header */
+    gz->points[0].header = 1;
+    gz->npoints = 1;
+    return gz;
+}
+
+static void stream_end(fm_gz *gz) {
+    if (gz->live) {
+        inflateEnd(&gz->strm);
+        gz->live = 0;
+    }
+}
+
+void fm_gz_close(fm_gz *gz) {
+    if (!gz) return;
+    stream_end(gz);
+    for (int i = 0; i < gz->npoints; ++i) free(gz->points[i].window);
+    free(gz->points);
+    free(gz->cache);
+    close(gz->fd);
+    free(gz);
+}
+
+/* ---- checkpoints ---- */
+
+/* Copy the wlen bytes of output preceding out from the ring into dst */
+static void ring_copy(const fm_gz *gz, off_t out, size_t wlen, unsigned char *dst) {
+    size_t start = (size_t)((out - (off_t)wlen) % FM_GZ_WINDOW);
+    size_t first = FM_GZ_WINDOW - start < wlen ? FM_GZ_WINDOW - start : wlen;
+    memcpy(dst, gz->ring + start, first);
+    memcpy(dst + first, gz->ring, wlen - first);
+}
+
+/* Drop every other checkpoint (keeping the first) and double the span */
+static void thin(fm_gz *gz) {
+    int n = 1;
+    for (int i = 1; i < gz->npoints; ++i) {
+        if (i % 2 == 0) gz->points[n++] = gz->points[i];
+        else free(gz->points[i].window);
+    }
+    gz->npoints = n;
+    gz->span *= 2;
+}
+
+/* Remember the live position, which is at a deflate block boundary */
+static void record(fm_gz *gz) {
+    if (gz->npoints == FM_GZ_MAX_POINTS) {
+        thin(gz);
+        if (gz->out_pos - gz->points[gz->npoints - 1].out < gz->span) return;
+    }
+    size_t wlen = gz->out_pos < FM_GZ_WINDOW ? (size_t)gz->out_pos : FM_GZ_WINDOW;
+    unsigned char *w = malloc(wlen ? wlen : 1);
+    if (!w) return; /* a missing checkpoint only makes seeks slower */
+    ring_copy(gz, gz->out_pos, wlen, w);
+    fm_gz_point *pt = &gz->points[gz->npoints++];
+    pt->out = gz->out_pos;
+    pt->in = gz->in_pos - gz->strm.avail_in;
+    pt->bits = gz->strm.data_type & 7;
+    pt->header = 0;
+    pt->window = w;
+}
+
+/* Last checkpoint at or before out */
+static const fm_gz_point *nearest(const fm_gz *gz, off_t out) {
+    int lo = 0, hi = gz->npoints - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (gz->points[mid].out <= out) lo = mid;
+        else hi = mid - 1;
+    }
+    return &gz->points[lo];
+}
+
+/* ---- decoding ---- */
+
+/* Set up the live stream at a checkpoint */
+static int restart(fm_gz *gz, const fm_gz_point *pt) {
+    stream_end(gz);
+    memset(&gz->strm, 0, sizeof(gz->strm));
+    /* 31: gzip header and trailer; -15: raw deflate from a block boundary */
+    if (inflateInit2(&gz->strm, pt->header ? 31 : -15) != Z_OK) {
+        errno = ENOMEM;
+        return -1;
+    }
+    gz->live = 1;
+    gz->raw = !pt->header;
+    gz->skip = 0;
+    gz->member_out = !pt->header;
+    gz->eof = 0;
+    gz->in_pos = pt->in;
+    gz->out_pos = pt->out;
+    if (pt->bits) {
+        unsigned char c;
+        if (pread(gz->fd, &c, 1, pt->in - 1) != 1) {
+            stream_end(gz);
+            errno = EIO;
+            return -1;
+        }
+        inflatePrime(&gz->strm, pt->bits, c >> (8 - pt->bits));
+    }
+    if (!pt->header && pt->out > 0) {
+        size_t wlen = pt->out < FM_GZ_WINDOW ? (size_t)pt->out : FM_GZ_WINDOW;
+        inflateSetDictionary(&gz->strm, pt->window, (uInt)wlen);
+        /* Later checkpoints take their window from the ring */
+        for (size_t i = 0; i < wlen; ++i)
+            gz->ring[(pt->out - (off_t)wlen + (off_t)i) % FM_GZ_WINDOW] = pt->window[i];
+    }
+    return 0;
+}
+
+/* Inflate forward from the live position until it reaches stop (-1: the end of the data),
+ * copying output that falls in [dst_off, dst_off + dst_len) to dst and recording checkpoints
+ * past the frontier. Returns 0, 1 if progress asked to stop, or -1 with errno set */
+static int run(fm_gz *gz, off_t stop, unsigned char *dst, off_t dst_off, size_t dst_len,
+               fm_gz_progress_fn progress, void *ctx) {
+    z_stream *s = &gz->strm;
+    int rc = 0;
+    while (!gz->eof && (stop < 0 || gz->out_pos < stop)) {
+        if (s->avail_in == 0) {
+            ssize_t n = pread(gz->fd, gz->inbuf, FM_GZ_INBUF, gz->in_pos);
+            if (n < 0) return -1;
+            if (n == 0) {
+                /* End of file; a truncated member just ends the data early */
+                gz->eof = 1;
+                break;
+            }
+            gz->in_pos += n;
+            s->next_in = gz->inbuf;
+            s->avail_in = (uInt)n;
+            if (progress && progress(ctx, gz->in_pos, gz->csize)) {
+                rc = 1;
+                break;
+            }
+        }
+        if (gz->skip) {
+            uInt k = (uInt)gz->skip < s->avail_in ? (uInt)gz->skip : s->avail_in;
+            s->next_in += k;
+            s->avail_in -= k;
+            gz->skip -= (int)k;
+            if (gz->skip == 0) {
+                /* Continue with the next member, header included */
+                if (inflateReset2(s, 31) != Z_OK) {
+                    errno = EIO;
+                    return -1;
+                }
+                gz->raw = 0;
+                gz->member_out = 0;
+            }
+            continue;
+        }
+
+        size_t pos = (size_t)(gz->out_pos % FM_GZ_WINDOW);
+        s->next_out = gz->ring + pos;
+        s->avail_out = (uInt)(FM_GZ_WINDOW - pos);
+        int ret = inflate(s, Z_BLOCK);
+        size_t got = FM_GZ_WINDOW - pos - s->avail_out;
+        if (got) {
+            off_t a = gz->out_pos > dst_off ? gz->out_pos : dst_off;
+            off_t b = gz->out_pos + (off_t)got;
+            if (b > dst_off + (off_t)dst_len) b = dst_off + (off_t)dst_len;
+            if (dst && a < b) memcpy(dst + (a - dst_off), gz->ring + pos + (a - gz->out_pos), (size_t)(b - a));
+            gz->out_pos += (off_t)got;
+            gz->member_out = 1;
+        }
+
+        if (ret == Z_STREAM_END) {
+            if (gz->raw) {
+                gz->skip = GZ_TRAILER;
+            } else {
+                inflateReset(s);
+                gz->member_out = 0;
+            }
+        } else if (ret == Z_OK || ret == Z_BUF_ERROR) {
+            /* At a block boundary that is not the end of the stream */
+            if ((s->data_type & 0xc0) == 0x80 && gz->out_pos >= gz->frontier &&
+                gz->out_pos - gz->points[gz->npoints - 1].out >= gz->span)
+                record(gz);
+        } else if (!gz->raw && !gz->member_out && gz->out_pos > 0) {
+            /* Trailing garbage after a complete member ends the data, as gunzip does */
+            gz->eof = 1;
+        } else {
+            errno = ret == Z_MEM_ERROR ? ENOMEM : EIO;
+            return -1;
+        }
+        if (gz->out_pos > gz->frontier) gz->frontier = gz->out_pos;
+    }
+    if (gz->eof && gz->out_pos >= gz->frontier) {
+        gz->size = gz->out_pos;
+        gz->complete = 1;
+    }
+    return rc;
+}
+
+/* Load the cache-aligned chunk holding offset */
+static int fill(fm_gz *gz, off_t offset) {
+    off_t start = offset - offset % FM_GZ_CACHE;
+    const fm_gz_point *pt = nearest(gz, start);
+    /* Keep going with the live stream when it is already between the checkpoint and start */
+    if (!gz->live || gz->out_pos > start || gz->out_pos < pt->out) {
+        if (restart(gz, pt) != 0) return -1;
+    }
+    gz->cache_off = start;
+    gz->cache_len = 0;
+    if (run(gz, start + FM_GZ_CACHE, gz->cache, start, FM_GZ_CACHE, NULL, NULL) < 0) {
+        int saved = errno;
+        stream_end(gz);
+        errno = saved;
+        return -1;
+    }
+    if (gz->out_pos > start)
+        gz->cache_len = gz->out_pos - start < FM_GZ_CACHE ? (size_t)(gz->out_pos - start) : FM_GZ_CACHE;
+    return 0;
+}
+
+ssize_t fm_gz_pread(fm_gz *gz, void *buf, size_t len, off_t offset) {
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t done = 0;
+    while (done < len) {
+        off_t at = offset + (off_t)done;
+        if (at < gz->cache_off || at >= gz->cache_off + (off_t)gz->cache_len) {
+            if (gz->complete && at >= gz->size) break;
+            if (fill(gz, at) != 0) return done ? (ssize_t)done : -1;
+            if (at >= gz->cache_off + (off_t)gz->cache_len) break; /* past the end */
+        }
+        size_t avail = (size_t)(gz->cache_off + (off_t)gz->cache_len - at);
+        size_t n = avail < len - done ? avail : len - done;
+        memcpy((unsigned char *)buf + done, gz->cache + (at - gz->cache_off), n);
+        done += n;
+    }
+    return (ssize_t)done;
+}
+
+int fm_gz_scan(fm_gz *gz, fm_gz_progress_fn progress, void *ctx) {
+    if (gz->complete) return 0;
+    /* Resume from the furthest checkpoint unless the live stream is already past it */
+    const fm_gz_point *pt = &gz->points[gz->npoints - 1];
+    if (!gz->live || gz->out_pos < pt->out) {
+        if (restart(gz, pt) != 0) return -1;
+    }
+    int rc = run(gz, -1, NULL, 0, 0, progress, ctx);
+    if (rc < 0) {
+        int saved = errno;
+        stream_end(gz);
+        errno = saved;
+    }
+    return rc;
+}
@@ -0,0 +1,270 @@
+#define _XOPEN_SOURCE 700
+#include "hash.h"
+#include <string.h>
+#include <pthread.h>
+
+#define P64_1 0x9E3779B185EBCA87ULL
+#define P64_2 0xC2B2AE3D27D4EB4FULL
+#define P64_3 0x165667B19E3779F9ULL
+#define P64_4 0x85EBCA77C2B2AE63ULL
+#define P64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/* Little-endian loads; compilers turn these into single moves on LE hosts */
+static inline uint64_t read64(const unsigned char *p) {
+    return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
+           (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * P64_2;
+    acc = rotl64(acc, 31);
+    return acc * P64_1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh_round(0, val);
+    return acc * P64_1 + P64_4;
+}
+
+void fm_xxh64_init(fm_xxh64_state *s, uint64_t seed) {
+    memset(s, 0, sizeof(*s));
+    s->seed = seed;
+    s->v[0] = seed + P64_1 + P64_2;
+    s->v[1] = seed + P64_2;
+    s->v[2] = seed;
+    s->v[3] = seed - P64_1;
+}
+
+void fm_xxh64_update(fm_xxh64_state *s, const void *data, size_t len) {
+    const unsigned char *p = data;
+    const unsigned char *end = p + len;
+    s->total += len;
+
+    if (s->memsize + len < 32) {
+        memcpy(s->mem + s->memsize, p, len);
+        s->memsize += len;
+        return;
+    }
+    if (s->memsize) {
+        size_t fill = 32 - s->memsize;
+        memcpy(s->mem + s->memsize, p, fill);
+        for (int i = 0; i < 4; ++i) s->v[i] = xxh_round(s->v[i], read64(s->mem + 8 * i));
+        p += fill;
+        s->memsize = 0;
+    }
+    /* Main loop: 32-byte stripes across four independent lanes */
+    uint64_t v0 = s->v[0], v1 = s->v[1], v2 = s->v[2], v3 = s->v[3];
+    while (p + 32 <= end) {
+        v0 = xxh_round(v0, read64(p));
+        v1 = xxh_round(v1, read64(p + 8));
+        v2 = xxh_round(v2, read64(p + 16));
+        v3 = xxh_round(v3, read64(p + 24));
+        p += 32;
+    }
+    s->v[0] = v0; s->v[1] = v1; s->v[2] = v2; s->v[3] = v3;
+    if (p < end) {
+        memcpy(s->mem, p, end - p);
+        s->memsize = end - p;
+    }
+}
+
+uint64_t fm_xxh64_digest(const fm_xxh64_state *s) {
+    uint64_t h;
+    if (s->total >= 32) {
+        h = rotl64(s->v[0], 1) + rotl64(s->v[1], 7) + rotl64(s->v[2], 12) + rotl64(s->v[3], 18);
+        for (int i = 0; i < 4; ++i) h = xxh_merge(h, s->v[i]);
+    } else {
+        h = s->seed + P64_5;
+    }
+    h += s->total;
+
+    const unsigned char *p = s->mem;
+    const unsigned char *end = p + s->memsize;
+    while (p + 8 <= end) {
+        h ^= xxh_round(0, read64(p));
+        h = rotl64(h, 27) * P64_1 + P64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * P64_1;
+        h = rotl64(h, 23) * P64_2 + P64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p++) * P64_5;
+        h = rotl64(h, 11) * P64_1;
+    }
+
+    h ^= h >> 33;
+    h *= P64_2;
+    h ^= h >> 29;
+    h *= P64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t fm_xxh64(const void *data, size_t len, uint64_t seed) {
+    fm_xxh64_state s;
+    fm_xxh64_init(&s, seed);
+    fm_xxh64_update(&s, data, len);
+    return fm_xxh64_digest(&s);
+}
+
+/* ---- CRC32C ---- */
+
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+static int crc_hw;
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1)));
+        crc_table[0][i] = c;
+    }
+    for (int t = 1; t < 8; ++t) {
+        for (int i = 0; i < 256; ++i) {
+            uint32_t c = crc_table[t - 1][i];
+            crc_table[t][i] = (c >> 8) ^ crc_table[0][c & 0xff];
+        }
+    }
+#if defined(__x86_64__) && defined(__GNUC__)
+    crc_hw = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+/* Slice-by-8: eight table lookups per 8 input bytes */
+static uint32_t crc_sw(uint32_t c, const unsigned char *p, size_t len) {
+    while (len >= 8) {
+        uint32_t lo = c ^ read32(p);
+        uint32_t hi = read32(p + 4);
+        c = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+            crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+            crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+            crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) c = (c >> 8) ^ crc_table[0][(c ^ *p++) & 0xff];
+    return c;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2")))
+static uint32_t crc_hw_sse42(uint32_t c, const unsigned char *p, size_t len) {
+    uint64_t c64 = c;
+    while (len >= 8) {
+        c64 = __builtin_ia32_crc32di(c64, read64(p));
+        p += 8;
+        len -= 8;
+    }
+    c = (uint32_t)c64;
+    while (len--) c = __builtin_ia32_crc32qi(c, *p++);
+    return c;
+}
+#endif
+
+uint32_t fm_crc32c(uint32_t crc, const void *data, size_t len) {
+    pthread_once(&crc_once, crc_init);
+    uint32_t c = ~crc;
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (crc_hw) return ~crc_hw_sse42(c, data, len);
+#endif
+    return ~crc_sw(c, data, len);
+}
+
+/* ---- SHA-256 ---- */
+
+static const uint32_t sha_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr32(uint32_t x, int r) {
+    return (x >> r) | (x << (32 - r));
+}
+
+static void sha256_block(uint32_t h[8], const unsigned char *p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 |
+               (uint32_t)p[4 * i + 2] << 8 | (uint32_t)p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = hh + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + sha_k[i] + w[i];
+        uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        hh = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+void fm_sha256_init(fm_sha256_state *s) {
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(s->h, iv, sizeof(iv));
+    s->total = 0;
+    s->buflen = 0;
+}
+
+void fm_sha256_update(fm_sha256_state *s, const void *data, size_t len) {
+    const unsigned char *p = data;
+    s->total += len;
+    if (s->buflen) {
+        size_t fill = 64 - s->buflen;
+        if (len < fill) {
+            memcpy(s->buf + s->buflen, p, len);
+            s->buflen += len;
+            return;
+        }
+        memcpy(s->buf + s->buflen, p, fill);
+        sha256_block(s->h, s->buf);
+        p += fill;
+        len -= fill;
+        s->buflen = 0;
+    }
+    while (len >= 64) {
+        sha256_block(s->h, p);
+        p += 64;
+        len -= 64;
+    }
+    memcpy(s->buf, p, len);
+    s->buflen = len;
+}
+
+void fm_sha256_final(fm_sha256_state *s, unsigned char digest[32]) {
+    uint64_t bits = s->total * 8;
+    unsigned char pad[72] = { 0x80 };
+    size_t padlen = (s->buflen < 56 ? 56 : 120) - s->buflen;
+    fm_sha256_update(s, pad, padlen);
+    for (int i = 0; i < 8; ++i) pad[i] = (unsigned char)(bits >> (56 - 8 * i));
+    fm_sha256_update(s, pad, 8);
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i] = s->h[i] >> 24;
+        digest[4 * i + 1] = s->h[i] >> 16;
+        digest[4 * i + 2] = s->h[i] >> 8;
+        digest[4 * i + 3] = s->h[i];
+    }
+}
@@ -0,0 +1,487 @@
+#define _XOPEN_SOURCE 700
+#include "index.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char index_magic[8] = "FMINDEX";
+
+int fm_index_default_file(char *buf, size_t size, int create) {
+    const char *env = getenv("FM_INDEX_FILE");
+    if (env && *env) return snprintf(buf, size, "%s", env) < (int)size ? 0 : -1;
+
+    char dir[PATH_MAX];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && *xdg) snprintf(dir, sizeof(dir), "%s", xdg);
+    else if (home && *home) snprintf(dir, sizeof(dir), "%s/.cache", home);
+    else { errno = ENOENT; return -1; }
+    if (create) mkdir(dir, 0700);
+    size_t len = strlen(dir);
+    if (snprintf(dir + len, sizeof(dir) - len, "/filemgr") >= (int)(sizeof(dir) - len)) return -1;
+    if (create && mkdir(dir, 0700) != 0 && errno != EEXIST) return -1;
+    return snprintf(buf, size, "%s/index", dir) < (int)size ? 0 : -1;
+}
+
+/* Every offset and range is checked once here so lookups can trust the file */
+static int validate(const fm_index *ix) {
+    uint64_t n = ix->hdr->nodes;
+    for (uint64_t i = 0; i < n; ++i) {
+        const fm_index_node *nd = &ix->nodes[i];
+        if (nd->name >= ix->hdr->names_size) return -1;
+        if (i == 0 ? nd->parent != FM_INDEX_NONE : nd->parent >= i) return -1;
+        if (nd->nchildren && ((uint64_t)nd->first_child <= i || (uint64_t)nd->first_child + nd->nchildren > n)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int fm_index_open(fm_index *ix, const char *file) {
+    memset(ix, 0, sizeof(*ix));
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    if ((size_t)st.st_size < sizeof(fm_index_header)) { close(fd); errno = EINVAL; return -1; }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const fm_index_header *h = map;
+    ix->map = map;
+    ix->map_size = st.st_size;
+    ix->hdr = h;
+    ix->nodes = (const fm_index_node *)(h + 1);
+    int ok = memcmp(h->magic, index_magic, sizeof(index_magic)) == 0 && h->version == FM_INDEX_VERSION &&
+             h->node_size == sizeof(fm_index_node) && h->nodes > 0 && h->nodes < FM_INDEX_NONE &&
+             h->names_size > 0 &&
+             sizeof(*h) + h->nodes * sizeof(fm_index_node) + h->names_size == (uint64_t)st.st_size;
+    if (ok) {
+        ix->names = (const char *)(ix->nodes + h->nodes);
+        ok = ix->names[h->names_size - 1] == '\0' && validate(ix) == 0;
+    }
+    if (!ok) {
+        fm_index_close(ix);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void fm_index_close(fm_index *ix) {
+    if (ix->map) munmap(ix->map, ix->map_size);
+    memset(ix, 0, sizeof(*ix));
+}
+
+const char *fm_index_name(const fm_index *ix, uint32_t id) {
+    return ix->names + ix->nodes[id].name;
+}
+
+int fm_index_path(const fm_index *ix, uint32_t id, char *buf, size_t size) {
+    /* Measure first, then fill from the end */
+    size_t len = 0;
+    for (uint32_t i = id; i != FM_INDEX_NONE; i = ix->nodes[i].parent) {
+        len += strlen(fm_index_name(ix, i)) + (i != id);
+    }
+    if (len >= size) return -1;
+    buf[len] = '\0';
+    size_t pos = len;
+    for (uint32_t i = id; i != FM_INDEX_NONE; i = ix->nodes[i].parent) {
+        const char *name = fm_index_name(ix, i);
+        size_t nl = strlen(name);
+        if (i != id) buf[--pos] = '/';
+        pos -= nl;
+        memcpy(buf + pos, name, nl);
+    }
+    /* A root of "/" would otherwise produce "//name" */
+    if (len > 1 && buf[0] == '/' && buf[1] == '/') memmove(buf, buf + 1, len);
+    return 0;
+}
+
+uint32_t fm_index_find_dir(const fm_index *ix, const char *path) {
+    const char *root = fm_index_name(ix, 0);
+    size_t rl = strlen(root);
+    if (strcmp(root, "/") == 0) rl = 0;
+    if (strncmp(path, root, rl) != 0 || (path[rl] != '/' && path[rl] != '\0')) return FM_INDEX_NONE;
+    uint32_t cur = 0;
+    const char *p = path + rl;
+    while (*p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        size_t cl = strcspn(p, "/");
+        const fm_index_node *d = &ix->nodes[cur];
+        uint32_t next = FM_INDEX_NONE;
+        for (uint32_t c = d->first_child; c < d->first_child + d->nchildren; ++c) {
+            const char *name = fm_index_name(ix, c);
+            if (S_ISDIR(ix->nodes[c].mode) && strncmp(name, p, cl) == 0 && name[cl] == '\0') { next = c; break; }
+        }
+        if (next == FM_INDEX_NONE) return FM_INDEX_NONE;
+        cur = next;
+        p += cl;
+    }
+    return cur;
+}
+
+static void node_to_stat(const fm_index *ix, const fm_index_node *n, struct stat *st) {
+    memset(st, 0, sizeof(*st));
+    st->st_dev = ix->hdr->dev;
+    st->st_ino = n->ino;
+    st->st_mode = n->mode;
+    st->st_nlink = n->nlink;
+    st->st_uid = n->uid;
+    st->st_gid = n->gid;
+    st->st_size = n->size;
+    st->st_mtim.tv_sec = n->mtime_sec;
+    st->st_mtim.tv_nsec = n->mtime_nsec;
+}
+
+int fm_index_listing(const fm_index *ix, uint32_t dir, fm_entry **entries_out, struct timespec *mtime) {
+    const fm_index_node *d = &ix->nodes[dir];
+    char path[PATH_MAX];
+    /* Entry paths are built as fm_read_dir does; a directory whose paths would not fit is
+     * left to fm_read_dir */
+    if (fm_index_path(ix, dir, path, sizeof(path)) != 0 ||
+        strlen(path) + NAME_MAX + 2 > sizeof(((fm_entry *)0)->path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    fm_entry *arr = malloc((d->nchildren + 1) * sizeof(*arr));
+    if (!arr) return -1;
+
+    /* ".." is not indexed; fm_read_dir lists it, so take it from the parent node or disk */
+    fm_entry *up = &arr[0];
+    snprintf(up->name, sizeof(up->name), "..");
+    snprintf(up->path, sizeof(up->path), "%.*s/..", (int)(sizeof(up->path) - 4), path);
+    if (d->parent != FM_INDEX_NONE) node_to_stat(ix, &ix->nodes[d->parent], &up->st);
+    else if (lstat(up->path, &up->st) != 0) memset(&up->st, 0, sizeof(up->st));
+    up->is_dir = 1;
+
+    int n = 1;
+    for (uint32_t c = d->first_child; c < d->first_child + d->nchildren; ++c) {
+        fm_entry *e = &arr[n++];
+        const char *name = fm_index_name(ix, c);
+        snprintf(e->name, sizeof(e->name), "%s", name);
+        snprintf(e->path, sizeof(e->path), "%.*s/%.*s", (int)(sizeof(e->path) - NAME_MAX - 2), path,
+                 NAME_MAX, name);
+        node_to_stat(ix, &ix->nodes[c], &e->st);
+        e->is_dir = S_ISDIR(e->st.st_mode);
+    }
+    /* Children are stored in listing order; slide ".." into its place */
+    int pos = 0;
+    while (pos + 1 < n && fm_entry_cmp(&arr[0], &arr[pos + 1]) > 0) pos++;
+    if (pos > 0) {
+        fm_entry tmp = arr[0];
+        memmove(&arr[0], &arr[1], pos * sizeof(*arr));
+        arr[pos] = tmp;
+    }
+    mtime->tv_sec = d->mtime_sec;
+    mtime->tv_nsec = d->mtime_nsec;
+    *entries_out = arr;
+    return n;
+}
+
+/* needle is already lowercase */
+static int contains_nocase(const char *hay, const char *needle, size_t nl) {
+    for (; *hay; ++hay) {
+        size_t i = 0;
+        while (i < nl && hay[i] && tolower((unsigned char)hay[i]) == needle[i]) i++;
+        if (i == nl) return 1;
+    }
+    return nl == 0;
+}
+
+int fm_index_search(const fm_index *ix, const char *pattern, uint32_t *out, int max) {
+    int glob = strpbrk(pattern, "*?[") != NULL;
+    char lower[NAME_MAX + 1];
+    size_t nl = 0;
+    if (!glob) {
+        for (; pattern[nl] && nl < NAME_MAX; ++nl) lower[nl] = tolower((unsigned char)pattern[nl]);
+        lower[nl] = '\0';
+    }
+    int found = 0;
+    for (uint32_t i = 1; i < ix->hdr->nodes; ++i) {
+        const char *name = fm_index_name(ix, i);
+        int hit = glob ? fnmatch(pattern, name, 0) == 0 : contains_nocase(name, lower, nl);
+        if (!hit) continue;
+        if (found < max) out[found] = i;
+        found++;
+    }
+    return found;
+}
+
+/* ---- building ---- */
+
+typedef struct builder {
+    fm_index_node *nodes;
+    uint32_t n, cap;
+    char **paths;            /* directories still to expand, NULL otherwise */
+    uint32_t *old;           /* same directory in the previous index, FM_INDEX_NONE if none */
+    char *names;
+    size_t names_len, names_cap;
+    const fm_index *prev;    /* NULL for a full build */
+    dev_t dev;
+    fm_index_stats stats;
+} builder;
+
+static int add_node(builder *b, uint32_t parent, const char *name) {
+    if (b->n == b->cap) {
+        uint32_t cap = b->cap ? b->cap * 2 : 4096;
+        /* Node ids are 32-bit with FM_INDEX_NONE reserved */
+        if (cap <= b->cap || cap >= FM_INDEX_NONE) { errno = EFBIG; return -1; }
+        fm_index_node *nn = realloc(b->nodes, cap * sizeof(*nn));
+        if (nn) b->nodes = nn;
+        char **np = realloc(b->paths, cap * sizeof(*np));
+        if (np) b->paths = np;
+        uint32_t *no = realloc(b->old, cap * sizeof(*no));
+        if (no) b->old = no;
+        if (!nn || !np || !no) return -1;
+        b->cap = cap;
+    }
+    size_t nl = strlen(name) + 1;
+    if (b->names_len + nl > b->names_cap) {
+        size_t cap = b->names_cap ? b->names_cap * 2 : 65536;
+        while (cap < b->names_len + nl) cap *= 2;
+        /* Name offsets are 32-bit */
+        if (cap > UINT32_MAX) { errno = EFBIG; return -1; }
+        char *nn = realloc(b->names, cap);
+        if (!nn) return -1;
+        b->names = nn;
+        b->names_cap = cap;
+    }
+    uint32_t id = b->n++;
+    fm_index_node *nd = &b->nodes[id];
+    memset(nd, 0, sizeof(*nd));
+    nd->parent = parent;
+    nd->name = (uint32_t)b->names_len;
+    memcpy(b->names + b->names_len, name, nl);
+    b->names_len += nl;
+    b->paths[id] = NULL;
+    b->old[id] = FM_INDEX_NONE;
+    return 0;
+}
+
+static void fill_stat(fm_index_node *nd, const struct stat *st) {
+    nd->mode = st->st_mode;
+    nd->nlink = st->st_nlink;
+    nd->uid = st->st_uid;
+    nd->gid = st->st_gid;
+    nd->ino = st->st_ino;
+    nd->size = st->st_size;
+    nd->mtime_sec = st->st_mtim.tv_sec;
+    nd->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+/* Queue a child directory for expansion; other volumes are recorded but not entered */
+static int queue_dir(builder *b, uint32_t id, const char *path, const char *name, uint32_t old) {
+    if (!S_ISDIR(b->nodes[id].mode)) return 0;
+    size_t len = strlen(path) + strlen(name) + 2;
+    char *p = malloc(len);
+    if (!p) return -1;
+    snprintf(p, len, "%s%s%s", path, strcmp(path, "/") == 0 ? "" : "/", name);
+    b->paths[id] = p;
+    b->old[id] = old;
+    return 0;
+}
+
+/* Ordering of fm_read_dir (directories first, then case-insensitive) for old nodes */
+static int cmp_old(const fm_index *ix, uint32_t id, const fm_entry *e) {
+    int dir = S_ISDIR(ix->nodes[id].mode) != 0;
+    if (dir != e->is_dir) return dir ? -1 : 1;
+    return strcasecmp(fm_index_name(ix, id), e->name);
+}
+
+static int expand(builder *b, uint32_t d) {
+    char *path = b->paths[d];
+    b->paths[d] = NULL;
+    const fm_index *prev = b->prev;
+    const fm_index_node *on = (prev && b->old[d] != FM_INDEX_NONE) ? &prev->nodes[b->old[d]] : NULL;
+    const fm_index_node *dn = &b->nodes[d];
+    uint32_t first = b->n;
+    int rc = 0;
+
+    if (on && S_ISDIR(on->mode) && on->ino == dn->ino && on->mtime_sec == dn->mtime_sec &&
+        on->mtime_nsec == dn->mtime_nsec) {
+        /* Unchanged entry set: copy the children, re-stat only subdirectories */
+        b->stats.reused++;
+        for (uint32_t c = on->first_child; c < on->first_child + on->nchildren && rc == 0; ++c) {
+            const char *name = fm_index_name(prev, c);
+            if (add_node(b, d, name) != 0) { rc = -1; break; }
+            uint32_t id = b->n - 1;
+            fm_index_node *nd = &b->nodes[id];
+            uint32_t keep_parent = nd->parent, keep_name = nd->name;
+            *nd = prev->nodes[c];
+            nd->parent = keep_parent;
+            nd->name = keep_name;
+            nd->first_child = nd->nchildren = 0;
+            if (!S_ISDIR(nd->mode)) continue;
+            char sub[PATH_MAX];
+            struct stat st;
+            snprintf(sub, sizeof(sub), "%s%s%s", path, strcmp(path, "/") == 0 ? "" : "/", name);
+            if (lstat(sub, &st) != 0) continue;
+            fill_stat(nd, &st);
+            if (S_ISDIR(st.st_mode) && st.st_dev == b->dev) rc = queue_dir(b, id, path, name, c);
+        }
+    } else {
+        b->stats.scanned++;
+        fm_entry *ents = NULL;
+        int k = fm_read_dir(path, &ents);
+        if (k < 0) {
+            b->stats.errors++;
+        } else {
+            /* Both listings are in fm_read_dir order, so old children are matched by a merge */
+            uint32_t oi = 0, oend = 0;
+            if (on && S_ISDIR(on->mode)) { oi = on->first_child; oend = oi + on->nchildren; }
+            for (int i = 0; i < k && rc == 0; ++i) {
+                const fm_entry *e = &ents[i];
+                if (strcmp(e->name, "..") == 0) continue;
+                if (add_node(b, d, e->name) != 0) { rc = -1; break; }
+                uint32_t id = b->n - 1;
+                fill_stat(&b->nodes[id], &e->st);
+                if (!e->is_dir || e->st.st_dev != b->dev) continue;
+                uint32_t match = FM_INDEX_NONE;
+                while (oi < oend && cmp_old(prev, oi, e) < 0) oi++;
+                if (oi < oend && strcmp(fm_index_name(prev, oi), e->name) == 0) match = oi;
+                rc = queue_dir(b, id, path, e->name, match);
+            }
+            free(ents);
+        }
+    }
+    b->nodes[d].first_child = b->n > first ? first : 0;
+    b->nodes[d].nchildren = b->n - first;
+    free(path);
+    return rc;
+}
+
+static int write_index(const builder *b, const char *file) {
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp%ld", file, (long)getpid()) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+    fm_index_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, index_magic, sizeof(index_magic));
+    h.version = FM_INDEX_VERSION;
+    h.node_size = sizeof(fm_index_node);
+    h.nodes = b->n;
+    h.names_size = b->names_len;
+    h.dev = b->dev;
+    h.built = time(NULL);
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(b->nodes, sizeof(*b->nodes), b->n, f) == b->n &&
+             fwrite(b->names, 1, b->names_len, f) == b->names_len;
+    if (fclose(f) != 0) ok = 0;
+    /* Readers keep their mapping of the old file; new opens see the new one */
+    if (!ok || rename(tmp, file) != 0) {
+        int saved = errno;
+        unlink(tmp);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+static int build(const char *file, const char *root_in, fm_index_stats *stats, atomic_int *cancel) {
+    char root[PATH_MAX];
+    struct stat st;
+    if (!realpath(root_in, root) || lstat(root, &st) != 0) return -1;
+    if (!S_ISDIR(st.st_mode)) { errno = ENOTDIR; return -1; }
+
+    fm_index prev;
+    int have_prev = fm_index_open(&prev, file) == 0;
+    builder b;
+    memset(&b, 0, sizeof(b));
+    b.dev = st.st_dev;
+    if (have_prev && prev.hdr->dev == (uint64_t)st.st_dev && strcmp(fm_index_name(&prev, 0), root) == 0) {
+        b.prev = &prev;
+    }
+
+    int rc = add_node(&b, FM_INDEX_NONE, root);
+    if (rc == 0) {
+        fill_stat(&b.nodes[0], &st);
+        b.old[0] = b.prev ? 0 : FM_INDEX_NONE;
+        b.paths[0] = strdup(root);
+        if (!b.paths[0]) rc = -1;
+    }
+    /* Breadth-first: each directory's children are appended as one run */
+    for (uint32_t d = 0; rc == 0 && d < b.n; ++d) {
+        if (cancel && atomic_load(cancel)) { errno = ECANCELED; rc = -1; break; }
+        if (b.paths[d]) rc = expand(&b, d);
+    }
+    if (rc == 0) rc = write_index(&b, file);
+
+    int saved = errno;
+    for (uint32_t i = 0; i < b.n; ++i) {
+        if (S_ISDIR(b.nodes[i].mode)) b.stats.dirs++;
+        free(b.paths[i]);
+    }
+    b.stats.nodes = b.n;
+    if (stats) *stats = b.stats;
+    free(b.nodes);
+    free(b.paths);
+    free(b.old);
+    free(b.names);
+    if (have_prev) fm_index_close(&prev);
+    errno = saved;
+    return rc;
+}
+
+int fm_index_build(const char *file, const char *root, fm_index_stats *stats) {
+    return build(file, root, stats, NULL);
+}
+
+/* ---- background refresh ---- */
+
+static pthread_t refresh_thread;
+static int refresh_running;
+static atomic_int refresh_cancel;
+static atomic_int refresh_finished;
+static int refresh_rc;
+static char refresh_file[PATH_MAX];
+static char refresh_root[PATH_MAX];
+
+static void *refresh_main(void *arg) {
+    (void)arg;
+    refresh_rc = build(refresh_file, refresh_root, NULL, &refresh_cancel);
+    atomic_store(&refresh_finished, 1);
+    return NULL;
+}
+
+int fm_index_refresh_start(const char *file, const char *root) {
+    if (refresh_running) return 0;
+    snprintf(refresh_file, sizeof(refresh_file), "%s", file);
+    snprintf(refresh_root, sizeof(refresh_root), "%s", root);
+    atomic_store(&refresh_cancel, 0);
+    atomic_store(&refresh_finished, 0);
+    if (pthread_create(&refresh_thread, NULL, refresh_main, NULL) != 0) return -1;
+    refresh_running = 1;
+    return 0;
+}
+
+int fm_index_refresh_poll(void) {
+    if (!refresh_running || !atomic_load(&refresh_finished)) return 0;
+    pthread_join(refresh_thread, NULL);
+    refresh_running = 0;
+    return refresh_rc == 0 ? 1 : -1;
+}
+
+void fm_index_refresh_stop(void) {
+    if (!refresh_running) return;
+    atomic_store(&refresh_cancel, 1);
+    pthread_join(refresh_thread, NULL);
+    refresh_running = 0;
+}
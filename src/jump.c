@@ -0,0 +1,237 @@
+#define _XOPEN_SOURCE 700
+#include "jump.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+int fm_jump_default_file(char *buf, size_t size, int create) {
+    const char *env = getenv("FM_JUMP_FILE");
+    if (env && *env) return snprintf(buf, size, "%s", env) < (int)size ? 0 : -1;
+
+    char dir[PATH_MAX];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && *xdg) snprintf(dir, sizeof(dir), "%s", xdg);
+    else if (home && *home) snprintf(dir, sizeof(dir), "%s/.cache", home);
+    else { errno = ENOENT; return -1; }
+    if (create) mkdir(dir, 0700);
+    size_t len = strlen(dir);
+    if (snprintf(dir + len, sizeof(dir) - len, "/filemgr") >= (int)(sizeof(dir) - len)) return -1;
+    if (create && mkdir(dir, 0700) != 0 && errno != EEXIST) return -1;
+    return snprintf(buf, size, "%s/jumps", dir) < (int)size ? 0 : -1;
+}
+
+static int find(const fm_jumps *db, const char *path) {
+    for (int i = 0; i < db->count; ++i) {
+        if (strcmp(db->items[i].path, path) == 0) return i;
+    }
+    return -1;
+}
+
+static int add(fm_jumps *db, const char *path, double rank, time_t last) {
+    if (db->count == db->cap) {
+        int cap = db->cap ? db->cap * 2 : 64;
+        fm_jump_entry *tmp = realloc(db->items, cap * sizeof(*tmp));
+        if (!tmp) return -1;
+        db->items = tmp;
+        db->cap = cap;
+    }
+    char *copy = strdup(path);
+    if (!copy) return -1;
+    db->items[db->count].path = copy;
+    db->items[db->count].rank = rank;
+    db->items[db->count].last = last;
+    db->count++;
+    db->total += rank;
+    return 0;
+}
+
+static void drop(fm_jumps *db, int i) {
+    db->total -= db->items[i].rank;
+    free(db->items[i].path);
+    db->items[i] = db->items[--db->count];
+    db->dirty = 1;
+}
+
+int fm_jump_load(fm_jumps *db, const char *file) {
+    memset(db, 0, sizeof(*db));
+    FILE *f = fopen(file, "r");
+    if (!f) return errno == ENOENT ? 0 : -1;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &cap, f)) > 0) {
+        if (line[len - 1] == '\n') line[--len] = '\0';
+        char *end;
+        double rank = strtod(line, &end);
+        if (*end != '\t' || !(rank > 0)) continue;
+        long long last = strtoll(end + 1, &end, 10);
+        /* Malformed lines and duplicates are dropped */
+        if (*end != '\t' || end[1] != '/' || find(db, end + 1) >= 0) continue;
+        if (add(db, end + 1, rank, (time_t)last) != 0) {
+            free(line);
+            fclose(f);
+            fm_jump_free(db);
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    free(line);
+    fclose(f);
+    return 0;
+}
+
+int fm_jump_save(fm_jumps *db, const char *file) {
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp%ld", file, (long)getpid()) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    FILE *f = fopen(tmp, "w");
+    if (!f) return -1;
+    for (int i = 0; i < db->count; ++i) {
+        fprintf(f, "%.3f\t%lld\t%s\n", db->items[i].rank, (long long)db->items[i].last, db->items[i].path);
+    }
+    int ok = !ferror(f);
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, file) != 0) {
+        int saved = ok ? errno : EIO;
+        unlink(tmp);
+        errno = saved;
+        return -1;
+    }
+    db->dirty = 0;
+    return 0;
+}
+
+void fm_jump_free(fm_jumps *db) {
+    for (int i = 0; i < db->count; ++i) free(db->items[i].path);
+    free(db->items);
+    memset(db, 0, sizeof(*db));
+}
+
+double fm_jump_frecency(const fm_jump_entry *e, time_t now) {
+    double age = difftime(now, e->last);
+    if (age < 3600) return e->rank * 4;
+    if (age < 86400) return e->rank * 2;
+    if (age < 7 * 86400) return e->rank / 2;
+    return e->rank / 4;
+}
+
+void fm_jump_visit(fm_jumps *db, const char *path, time_t now) {
+    /* The file is line based */
+    if (path[0] != '/' || strchr(path, '\n') || strchr(path, '\t')) return;
+    int i = find(db, path);
+    if (i >= 0) {
+        db->items[i].rank += 1;
+        db->items[i].last = now;
+        db->total += 1;
+    } else {
+        if (db->count >= FM_JUMP_MAX_ENTRIES) {
+            /* Make room by dropping the least useful entry */
+            int worst = 0;
+            for (int j = 1; j < db->count; ++j) {
+                if (fm_jump_frecency(&db->items[j], now) < fm_jump_frecency(&db->items[worst], now)) worst = j;
+            }
+            drop(db, worst);
+        }
+        if (add(db, path, 1, now) != 0) return;
+    }
+    db->dirty = 1;
+    if (db->total > FM_JUMP_MAX_RANK) {
+        /* Age everything so old favourites give way to new ones */
+        db->total = 0;
+        for (int j = 0; j < db->count; ++j) {
+            db->items[j].rank *= 0.9;
+            db->total += db->items[j].rank;
+        }
+        for (int j = db->count - 1; j >= 0; --j) {
+            if (db->items[j].rank < 1) drop(db, j);
+        }
+    }
+}
+
+void fm_jump_forget(fm_jumps *db, const char *path) {
+    int i = find(db, path);
+    if (i >= 0) drop(db, i);
+}
+
+/* ---- matching ---- */
+
+/* Just past the end of word (len bytes) found in s as a case-insensitive subsequence, or
+ * NULL; taking each character at its first occurrence finds a match whenever there is one */
+static const char *subseq(const char *s, const char *word, size_t len) {
+    size_t i = 0;
+    for (; *s && i < len; ++s) {
+        if (tolower((unsigned char)*s) == tolower((unsigned char)word[i])) i++;
+    }
+    return i == len ? s : NULL;
+}
+
+static int substr(const char *s, const char *word, size_t len) {
+    for (; *s; ++s) {
+        if (strncasecmp(s, word, len) == 0) return 1;
+    }
+    return 0;
+}
+
+/* Weight of a path for query, 0 if it does not match */
+static double match_weight(const char *path, const char *query) {
+    const char *at = path, *last = NULL;
+    size_t lastlen = 0;
+    for (const char *q = query; *q; ) {
+        if (*q == ' ') { q++; continue; }
+        size_t len = strcspn(q, " ");
+        if (!(at = subseq(at, q, len))) return 0;
+        last = q;
+        lastlen = len;
+        q += len;
+    }
+    if (!last) return 1;
+    const char *base = strrchr(path, '/');
+    base = base && base[1] ? base + 1 : path;
+    if (substr(base, last, lastlen)) return 4;
+    if (subseq(base, last, lastlen)) return 2;
+    return 1;
+}
+
+typedef struct scored {
+    int idx;
+    double score;
+    size_t len;
+} scored;
+
+static int scored_cmp(const void *pa, const void *pb) {
+    const scored *a = pa, *b = pb;
+    if (a->score != b->score) return a->score > b->score ? -1 : 1;
+    /* Shorter paths first, then stable by index */
+    if (a->len != b->len) return a->len < b->len ? -1 : 1;
+    return a->idx - b->idx;
+}
+
+int fm_jump_match(const fm_jumps *db, const char *query, time_t now, const int *cand, int ncand, int *out) {
+    int n = cand ? ncand : db->count;
+    scored *s = malloc((n ? n : 1) * sizeof(*s));
+    if (!s) { errno = ENOMEM; return -1; }
+    int found = 0;
+    for (int i = 0; i < n; ++i) {
+        int idx = cand ? cand[i] : i;
+        const fm_jump_entry *e = &db->items[idx];
+        double w = match_weight(e->path, query);
+        if (w == 0) continue;
+        s[found].idx = idx;
+        s[found].score = w * fm_jump_frecency(e, now);
+        s[found].len = strlen(e->path);
+        found++;
+    }
+    qsort(s, found, sizeof(*s), scored_cmp);
+    for (int i = 0; i < found; ++i) out[i] = s[i].idx;
+    free(s);
+    return found;
+}
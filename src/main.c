@@ -1,8 +1,12 @@
 #include "ui.h"
+#include "cli.h"
 #include <stdio.h>
 #include <stdlib.h>
 
 int main(int argc, char **argv) {
+    /* Subcommands run headless against the fs engine, without ncurses */
+    if (argc > 1 && fm_cli_is_command(argv[1])) return fm_cli_run(argc - 1, argv + 1);
+
     const char *start = argc > 1 ? argv[1] : ".";
     if (fm_ui_run(start) != 0) {
         fprintf(stderr, "Error running UI\n");
@@ -0,0 +1,102 @@
+#define _XOPEN_SOURCE 700
+#include "perf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+
+_Thread_local int fm_perf_enabled;
+fm_perf fm_perf_frame;
+
+static fm_perf totals;
+static unsigned long frames;
+static FILE *log_file;
+static unsigned long long log_start;
+
+unsigned long long fm_perf_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int fm_perf_open_log(const char *path) {
+    fm_perf_close_log();
+    log_file = fopen(path, "a");
+    if (!log_file) return -1;
+    log_start = fm_perf_now();
+    fm_perf_enabled = 1;
+    return 0;
+}
+
+void fm_perf_close_log(void) {
+    if (log_file) fclose(log_file);
+    log_file = NULL;
+}
+
+static void add(fm_perf *dst, const fm_perf *src) {
+    dst->scan_ns += src->scan_ns;
+    dst->sort_ns += src->sort_ns;
+    dst->render_ns += src->render_ns;
+    dst->output_ns += src->output_ns;
+    dst->load_ns += src->load_ns;
+    dst->term_bytes += src->term_bytes;
+    dst->entries += src->entries;
+    dst->stat_calls += src->stat_calls;
+    dst->name_lookups += src->name_lookups;
+    dst->name_hits += src->name_hits;
+    dst->dir_hits += src->dir_hits;
+    dst->dir_misses += src->dir_misses;
+    dst->rows += src->rows;
+}
+
+void fm_perf_end_frame(const char *op, fm_perf *last) {
+    const fm_perf *f = &fm_perf_frame;
+    add(&totals, f);
+    frames++;
+    if (log_file) {
+        /* logfmt: one key=value line per frame */
+        fprintf(log_file, "t=%.3f op=\"%s\" scan_ms=%.3f entries=%lu stat=%lu sort_ms=%.3f name_lookups=%lu "
+                          "name_hits=%lu dir_hits=%lu dir_misses=%lu load_ms=%.3f render_ms=%.3f rows=%lu "
+                          "output_ms=%.3f term_bytes=%llu rss_kb=%ld\n",
+                (fm_perf_now() - log_start) / 1e9, op, f->scan_ns / 1e6, f->entries, f->stat_calls,
+                f->sort_ns / 1e6, f->name_lookups, f->name_hits, f->dir_hits, f->dir_misses,
+                f->load_ns / 1e6, f->render_ns / 1e6, f->rows, f->output_ns / 1e6, f->term_bytes,
+                fm_perf_rss_kb());
+        fflush(log_file);
+    }
+    if (last) *last = *f;
+    memset(&fm_perf_frame, 0, sizeof(fm_perf_frame));
+}
+
+const fm_perf *fm_perf_totals(unsigned long *nframes) {
+    if (nframes) *nframes = frames;
+    return &totals;
+}
+
+long fm_perf_rss_kb(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        long size, resident;
+        int ok = fscanf(f, "%ld %ld", &size, &resident) == 2;
+        fclose(f);
+        if (ok) return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) return ru.ru_maxrss;
+    return 0;
+}
+
+long long fm_perf_wchar(void) {
+    static int fd = -2;
+    if (fd == -2) fd = open("/proc/self/io", O_RDONLY);
+    if (fd < 0) return -1;
+    char buf[512];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    const char *p = strstr(buf, "wchar:");
+    return p ? atoll(p + 6) : -1;
+}
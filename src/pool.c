@@ -0,0 +1,63 @@
+#define _XOPEN_SOURCE 700
+#include "pool.h"
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define POOL_MAX_THREADS 8
+
+typedef struct pool {
+    fm_job_fn fn;
+    void *ctx;
+    size_t bufsize;
+    int n;
+    atomic_int next;
+    atomic_int done;
+} pool;
+
+static void *worker(void *arg) {
+    pool *p = arg;
+    void *buf = NULL;
+    /* Page-aligned so large reads take the kernel's fast copy path */
+    if (p->bufsize && posix_memalign(&buf, 4096, p->bufsize) != 0) buf = NULL;
+    int i;
+    while ((i = atomic_fetch_add(&p->next, 1)) < p->n) {
+        p->fn(p->ctx, i, buf);
+        atomic_fetch_add(&p->done, 1);
+    }
+    free(buf);
+    return NULL;
+}
+
+static int pool_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    /* At least two so one thread's I/O wait overlaps another's hashing */
+    if (n < 2) n = 2;
+    if (n > POOL_MAX_THREADS) n = POOL_MAX_THREADS;
+    return (int)n;
+}
+
+void fm_pool_run(int n, fm_job_fn fn, void *ctx, size_t bufsize, fm_progress_fn progress, void *pctx) {
+    if (n <= 0) return;
+    pool p = { fn, ctx, bufsize, n, 0, 0 };
+    pthread_t tids[POOL_MAX_THREADS];
+    int nthreads = pool_threads();
+    if (nthreads > n) nthreads = n;
+    int started = 0;
+    for (; started < nthreads; ++started) {
+        if (pthread_create(&tids[started], NULL, worker, &p) != 0) break;
+    }
+    if (started == 0) {
+        worker(&p);
+    } else {
+        struct timespec tick = { 0, 50 * 1000000L };
+        while (atomic_load(&p.done) < n) {
+            if (progress) progress(pctx, atomic_load(&p.done), n);
+            nanosleep(&tick, NULL);
+        }
+        for (int i = 0; i < started; ++i) pthread_join(tids[i], NULL);
+    }
+    if (progress) progress(pctx, n, n);
+}
@@ -0,0 +1,265 @@
+#define _XOPEN_SOURCE 700
+#include "prefetch.h"
+#include "perf.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define PREFETCH_SLOTS 8
+/* Wait this long after the last request before loading, so a held key loads nothing */
+#define PREFETCH_DEBOUNCE_NS (60 * 1000000ULL)
+/* Results older than this are read again when wanted and never adopted as a listing:
+ * editing a file changes its size and mtime but not the directory mtime checked on adoption */
+#define PREFETCH_MAX_AGE_NS (2000 * 1000000ULL)
+/* Bytes of a file kept for its preview */
+#define PREVIEW_BYTES (16 * 1024)
+
+typedef enum slot_state { SLOT_FREE, SLOT_PENDING, SLOT_LOADING, SLOT_READY } slot_state;
+
+typedef struct slot {
+    slot_state state;
+    int prio;                 /* position in the wanted set, -1 if no longer wanted */
+    unsigned long used;       /* request tick that last wanted it */
+    unsigned long long loaded; /* fm_perf_now() when it became ready */
+    fm_preview p;
+} slot;
+
+static slot slots[PREFETCH_SLOTS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake;
+static pthread_t thread;
+static int running, quit;
+static unsigned long long deadline;
+static unsigned long tick, seq;
+
+static void preview_clear(fm_preview *p) {
+    free(p->entries);
+    free(p->text);
+    p->entries = NULL;
+    p->text = NULL;
+    p->count = 0;
+    p->len = 0;
+    p->err = 0;
+    p->binary = 0;
+}
+
+/* Runs without the lock; only the local copy is written */
+static void load(fm_preview *p) {
+    if (p->is_dir) {
+        struct stat st;
+        /* mtime first, as in the directory cache, so a concurrent change shows as stale */
+        if (stat(p->path, &st) != 0) { p->err = errno; return; }
+        p->mtime = st.st_mtim;
+        int n = fm_read_dir(p->path, &p->entries);
+        if (n < 0) { p->err = errno; p->entries = NULL; return; }
+        p->count = n;
+        return;
+    }
+    /* O_NONBLOCK so a FIFO cannot stall the loader; only regular files are read */
+    int fd = open(p->path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0) { p->err = errno; return; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        p->err = errno ? errno : EINVAL;
+        close(fd);
+        return;
+    }
+    p->text = malloc(PREVIEW_BYTES);
+    if (!p->text) { p->err = ENOMEM; close(fd); return; }
+    ssize_t r;
+    while (p->len < PREVIEW_BYTES && (r = read(fd, p->text + p->len, PREVIEW_BYTES - p->len)) != 0) {
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            p->err = errno;
+            break;
+        }
+        p->len += r;
+    }
+    p->binary = memchr(p->text, '\0', p->len) != NULL;
+    close(fd);
+}
+
+/* Most wanted pending slot, NULL if none */
+static slot *next_job(void) {
+    slot *best = NULL;
+    for (int i = 0; i < PREFETCH_SLOTS; ++i) {
+        slot *s = &slots[i];
+        if (s->state == SLOT_PENDING && s->prio >= 0 && (!best || s->prio < best->prio)) best = s;
+    }
+    return best;
+}
+
+static void *loader(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    while (!quit) {
+        slot *s = next_job();
+        if (!s) {
+            pthread_cond_wait(&wake, &lock);
+            continue;
+        }
+        unsigned long long now = fm_perf_now();
+        if (now < deadline) {
+            /* Still debouncing: sleep until the requests settle (or change again) */
+            struct timespec ts = { (time_t)(deadline / 1000000000ULL), (long)(deadline % 1000000000ULL) };
+            pthread_cond_timedwait(&wake, &lock, &ts);
+            continue;
+        }
+        fm_preview p;
+        memset(&p, 0, sizeof(p));
+        memcpy(p.path, s->p.path, sizeof(p.path));
+        p.is_dir = s->p.is_dir;
+        s->state = SLOT_LOADING;
+        pthread_mutex_unlock(&lock);
+
+        load(&p);
+
+        pthread_mutex_lock(&lock);
+        /* A loading slot is never reused, so it still describes the same path */
+        s->p = p;
+        s->state = SLOT_READY;
+        s->loaded = fm_perf_now();
+        seq++;
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+int fm_prefetch_start(void) {
+    if (running) return 0;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    /* Deadlines come from fm_perf_now (CLOCK_MONOTONIC) */
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wake, &attr);
+    pthread_condattr_destroy(&attr);
+    quit = 0;
+    if (pthread_create(&thread, NULL, loader, NULL) != 0) {
+        pthread_cond_destroy(&wake);
+        return -1;
+    }
+    running = 1;
+    return 0;
+}
+
+void fm_prefetch_stop(void) {
+    if (!running) return;
+    pthread_mutex_lock(&lock);
+    quit = 1;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    pthread_cond_destroy(&wake);
+    running = 0;
+    for (int i = 0; i < PREFETCH_SLOTS; ++i) {
+        preview_clear(&slots[i].p);
+        slots[i].state = SLOT_FREE;
+    }
+}
+
+static slot *find(const char *path) {
+    for (int i = 0; i < PREFETCH_SLOTS; ++i) {
+        if (slots[i].state != SLOT_FREE && strcmp(slots[i].p.path, path) == 0) return &slots[i];
+    }
+    return NULL;
+}
+
+/* A free slot, else the least recently wanted finished one; never a loading slot */
+static slot *alloc_slot(void) {
+    slot *victim = NULL;
+    for (int i = 0; i < PREFETCH_SLOTS; ++i) {
+        slot *s = &slots[i];
+        if (s->state == SLOT_FREE) return s;
+        if (s->state == SLOT_READY && s->prio < 0 && (!victim || s->used < victim->used)) victim = s;
+    }
+    if (victim) {
+        preview_clear(&victim->p);
+        victim->state = SLOT_FREE;
+    }
+    return victim;
+}
+
+void fm_prefetch_want(const char *const *paths, const int *is_dir, int n) {
+    if (!running) return;
+    pthread_mutex_lock(&lock);
+    tick++;
+    unsigned long long now = fm_perf_now();
+    for (int i = 0; i < PREFETCH_SLOTS; ++i) {
+        slot *s = &slots[i];
+        s->prio = -1;
+        /* Cancel requests that never started */
+        if (s->state == SLOT_PENDING) s->state = SLOT_FREE;
+    }
+    for (int i = 0; i < n; ++i) {
+        slot *s = find(paths[i]);
+        if (!s) {
+            if (!(s = alloc_slot())) continue;
+            memset(&s->p, 0, sizeof(s->p));
+            snprintf(s->p.path, sizeof(s->p.path), "%s", paths[i]);
+            s->p.is_dir = is_dir[i];
+            s->state = SLOT_PENDING;
+        } else if (s->state == SLOT_READY && now - s->loaded > PREFETCH_MAX_AGE_NS) {
+            /* Too old to show as current: load it again */
+            preview_clear(&s->p);
+            s->state = SLOT_PENDING;
+        }
+        s->prio = i;
+        s->used = tick;
+    }
+    deadline = now + PREFETCH_DEBOUNCE_NS;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+}
+
+const fm_preview *fm_prefetch_lookup(const char *path) {
+    if (!running) return NULL;
+    pthread_mutex_lock(&lock);
+    slot *s = find(path);
+    /* Ready slots are only changed by this (the UI) thread, so the pointer stays valid */
+    const fm_preview *p = s && s->state == SLOT_READY ? &s->p : NULL;
+    pthread_mutex_unlock(&lock);
+    return p;
+}
+
+int fm_prefetch_take_dir(const char *path, fm_entry **entries, int *count, struct timespec *mtime) {
+    if (!running) return -1;
+    pthread_mutex_lock(&lock);
+    slot *s = find(path);
+    int ok = s && s->state == SLOT_READY && s->p.is_dir && !s->p.err &&
+             fm_perf_now() - s->loaded <= PREFETCH_MAX_AGE_NS;
+    if (s && s->state == SLOT_READY && !ok) {
+        preview_clear(&s->p);
+        s->state = SLOT_FREE;
+    } else if (ok) {
+        *entries = s->p.entries;
+        *count = s->p.count;
+        *mtime = s->p.mtime;
+        s->p.entries = NULL;
+        preview_clear(&s->p);
+        s->state = SLOT_FREE;
+    }
+    pthread_mutex_unlock(&lock);
+    return ok ? 0 : -1;
+}
+
+unsigned long fm_prefetch_seq(void) {
+    pthread_mutex_lock(&lock);
+    unsigned long v = seq;
+    pthread_mutex_unlock(&lock);
+    return v;
+}
+
+int fm_prefetch_busy(void) {
+    int busy = 0;
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < PREFETCH_SLOTS; ++i) {
+        if (slots[i].prio >= 0 && (slots[i].state == SLOT_PENDING || slots[i].state == SLOT_LOADING)) busy = 1;
+    }
+    pthread_mutex_unlock(&lock);
+    return busy;
+}
@@ -0,0 +1,112 @@
+#define _XOPEN_SOURCE 700
+#include "select.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+
+#define WORD_BITS (8 * (int)sizeof(unsigned long))
+
+/* ".." is shown in every listing but is never part of a bulk operation */
+static int selectable(const fm_entry *e) {
+    return strcmp(e->name, "..") != 0;
+}
+
+static void set_bit(fm_selection *s, int i) {
+    unsigned long m = 1UL << (i % WORD_BITS);
+    if (!(s->bits[i / WORD_BITS] & m)) {
+        s->bits[i / WORD_BITS] |= m;
+        s->count++;
+    }
+}
+
+void fm_sel_init(fm_selection *s) {
+    s->bits = NULL;
+    s->nbits = 0;
+    s->count = 0;
+    s->anchor = -1;
+}
+
+void fm_sel_free(fm_selection *s) {
+    free(s->bits);
+    fm_sel_init(s);
+}
+
+int fm_sel_resize(fm_selection *s, int n) {
+    int words = (n + WORD_BITS - 1) / WORD_BITS;
+    int old_words = (s->nbits + WORD_BITS - 1) / WORD_BITS;
+    if (words > old_words || !s->bits) {
+        unsigned long *tmp = realloc(s->bits, (words ? words : 1) * sizeof(unsigned long));
+        if (!tmp) return -1;
+        s->bits = tmp;
+    }
+    s->nbits = n;
+    fm_sel_clear(s);
+    return 0;
+}
+
+void fm_sel_clear(fm_selection *s) {
+    int words = (s->nbits + WORD_BITS - 1) / WORD_BITS;
+    if (s->bits) memset(s->bits, 0, words * sizeof(unsigned long));
+    s->count = 0;
+    s->anchor = -1;
+}
+
+int fm_sel_test(const fm_selection *s, int i) {
+    if (i < 0 || i >= s->nbits) return 0;
+    return (s->bits[i / WORD_BITS] >> (i % WORD_BITS)) & 1UL;
+}
+
+void fm_sel_toggle(fm_selection *s, const fm_entry *items, int i) {
+    if (i < 0 || i >= s->nbits || !selectable(&items[i])) return;
+    unsigned long m = 1UL << (i % WORD_BITS);
+    s->bits[i / WORD_BITS] ^= m;
+    s->count += (s->bits[i / WORD_BITS] & m) ? 1 : -1;
+    s->anchor = i;
+}
+
+void fm_sel_range(fm_selection *s, const fm_entry *items, int i) {
+    if (i < 0 || i >= s->nbits) return;
+    int from = s->anchor >= 0 && s->anchor < s->nbits ? s->anchor : i;
+    int lo = from < i ? from : i;
+    int hi = from < i ? i : from;
+    for (int k = lo; k <= hi; ++k) {
+        if (selectable(&items[k])) set_bit(s, k);
+    }
+    s->anchor = i;
+}
+
+void fm_sel_invert(fm_selection *s, const fm_entry *items) {
+    int words = (s->nbits + WORD_BITS - 1) / WORD_BITS;
+    for (int w = 0; w < words; ++w) s->bits[w] = ~s->bits[w];
+    /* Mask off the tail past nbits and re-clear ".." */
+    if (s->nbits % WORD_BITS) s->bits[words - 1] &= (1UL << (s->nbits % WORD_BITS)) - 1;
+    s->count = 0;
+    for (int w = 0; w < words; ++w) s->count += __builtin_popcountl(s->bits[w]);
+    for (int k = 0; k < s->nbits; ++k) {
+        if (!selectable(&items[k]) && fm_sel_test(s, k)) {
+            s->bits[k / WORD_BITS] &= ~(1UL << (k % WORD_BITS));
+            s->count--;
+        }
+    }
+}
+
+int fm_sel_match(fm_selection *s, const fm_entry *items, const char *pattern) {
+    int before = s->count;
+    for (int k = 0; k < s->nbits; ++k) {
+        if (selectable(&items[k]) && fnmatch(pattern, items[k].name, FNM_PERIOD) == 0) set_bit(s, k);
+    }
+    return s->count - before;
+}
+
+int fm_sel_next(const fm_selection *s, int from) {
+    if (from < 0) from = 0;
+    if (from >= s->nbits) return -1;
+    int w = from / WORD_BITS;
+    unsigned long word = s->bits[w] & (~0UL << (from % WORD_BITS));
+    int words = (s->nbits + WORD_BITS - 1) / WORD_BITS;
+    while (!word) {
+        if (++w >= words) return -1;
+        word = s->bits[w];
+    }
+    return w * WORD_BITS + __builtin_ctzl(word);
+}
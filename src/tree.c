@@ -0,0 +1,241 @@
+#define _XOPEN_SOURCE 700
+#include "tree.h"
+#include "perf.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* ---- row gap buffer ---- */
+
+static fm_tree_node **slot(const fm_tree *t, int row) {
+    return &t->rows[row < t->gap ? row : row + t->gaplen];
+}
+
+fm_tree_node *fm_tree_row(const fm_tree *t, int row) {
+    return row >= 0 && row < t->nrows ? *slot(t, row) : NULL;
+}
+
+/* Put the gap right before row `to`; costs the distance it moves */
+static void move_gap(fm_tree *t, int to) {
+    if (to < t->gap)
+        memmove(t->rows + to + t->gaplen, t->rows + to, (t->gap - to) * sizeof(*t->rows));
+    else if (to > t->gap)
+        memmove(t->rows + t->gap, t->rows + t->gap + t->gaplen, (to - t->gap) * sizeof(*t->rows));
+    t->gap = to;
+}
+
+/* Make room for n more rows, doubling the buffer */
+static int reserve(fm_tree *t, int n) {
+    if (t->gaplen >= n) return 0;
+    int cap = t->nrows + t->gaplen;
+    int ncap = cap ? cap * 2 : 256;
+    while (ncap < t->nrows + n) ncap *= 2;
+    fm_tree_node **rows = realloc(t->rows, ncap * sizeof(*rows));
+    if (!rows) { errno = ENOMEM; return -1; }
+    int tail = t->nrows - t->gap;
+    memmove(rows + ncap - tail, rows + t->gap + t->gaplen, tail * sizeof(*rows));
+    t->rows = rows;
+    t->gaplen = ncap - t->nrows;
+    return 0;
+}
+
+/* ---- nodes ---- */
+
+/* Same order as fm_entry_cmp */
+static int node_cmp(const void *pa, const void *pb) {
+    const fm_tree_node *a = pa, *b = pb;
+    int ad = S_ISDIR(a->mode), bd = S_ISDIR(b->mode);
+    if (ad != bd) return ad ? -1 : 1;
+    return strcasecmp(a->name, b->name);
+}
+
+static void free_children(fm_tree_node *n) {
+    for (int i = 0; i < n->nchildren; ++i) {
+        free_children(&n->children[i]);
+        free(n->children[i].name);
+    }
+    free(n->children);
+    n->children = NULL;
+    n->nchildren = 0;
+    n->loaded = 0;
+    n->expanded = 0;
+}
+
+int fm_tree_path(const fm_tree_node *n, char *buf, size_t size) {
+    if (!n->parent) {
+        int w = snprintf(buf, size, "%s", n->name);
+        return w < 0 || (size_t)w >= size ? -1 : 0;
+    }
+    if (fm_tree_path(n->parent, buf, size) != 0) return -1;
+    size_t len = strlen(buf);
+    int w = snprintf(buf + len, size - len, "%s%s", len && buf[len - 1] == '/' ? "" : "/", n->name);
+    return w < 0 || (size_t)w >= size - len ? -1 : 0;
+}
+
+/* Read the children of a directory node */
+static int load(fm_tree *t, fm_tree_node *n) {
+    char path[PATH_MAX];
+    if (fm_tree_path(n, path, sizeof(path)) != 0) { errno = ENAMETOOLONG; return -1; }
+    FM_PERF_START(scan_t0);
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    DIR *d = fdopendir(fd);
+    if (!d) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    fm_tree_node *kids = NULL;
+    int count = 0, cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 32;
+            fm_tree_node *tmp = realloc(kids, cap * sizeof(*kids));
+            if (!tmp) goto nomem;
+            kids = tmp;
+        }
+        fm_tree_node *k = &kids[count];
+        memset(k, 0, sizeof(*k));
+        if (!(k->name = strdup(ent->d_name))) goto nomem;
+        count++;
+        k->parent = n;
+        k->depth = n->depth + 1;
+        struct stat st;
+        FM_PERF_ADD(stat_calls, 1);
+        if (fstatat(fd, ent->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            k->mode = st.st_mode;
+            k->size = st.st_size;
+            k->mtime = st.st_mtime;
+        }
+    }
+    closedir(d);
+    FM_PERF_STOP(scan_t0, scan_ns);
+    FM_PERF_ADD(entries, count);
+    FM_PERF_START(sort_t0);
+    if (count > 1) qsort(kids, count, sizeof(*kids), node_cmp);
+    FM_PERF_STOP(sort_t0, sort_ns);
+    n->children = kids;
+    n->nchildren = count;
+    n->loaded = 1;
+    t->reads++;
+    return 0;
+nomem:
+    for (int i = 0; i < count; ++i) free(kids[i].name);
+    free(kids);
+    closedir(d);
+    errno = ENOMEM;
+    return -1;
+}
+
+/* Rows shown below an expanded node */
+static int count_visible(const fm_tree_node *n) {
+    if (!n->expanded) return 0;
+    int c = n->nchildren;
+    for (int i = 0; i < n->nchildren; ++i) c += count_visible(&n->children[i]);
+    return c;
+}
+
+static fm_tree_node **emit(fm_tree_node *n, fm_tree_node **out) {
+    for (int i = 0; i < n->nchildren; ++i) {
+        *out++ = &n->children[i];
+        if (n->children[i].expanded) out = emit(&n->children[i], out);
+    }
+    return out;
+}
+
+/* ---- tree ---- */
+
+int fm_tree_init(fm_tree *t, const char *root) {
+    memset(t, 0, sizeof(*t));
+    struct stat st;
+    if (stat(root, &st) != 0) return -1;
+    if (!S_ISDIR(st.st_mode)) { errno = ENOTDIR; return -1; }
+    if (!(t->root.name = strdup(root)) || reserve(t, 1) != 0) {
+        free(t->root.name);
+        errno = ENOMEM;
+        return -1;
+    }
+    t->root.mode = st.st_mode;
+    t->root.size = st.st_size;
+    t->root.mtime = st.st_mtime;
+    t->rows[0] = &t->root;
+    t->gap = 1;
+    t->gaplen--;
+    t->nrows = 1;
+    if (fm_tree_expand(t, 0) < 0) {
+        int saved = errno;
+        fm_tree_free(t);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+void fm_tree_free(fm_tree *t) {
+    free_children(&t->root);
+    free(t->root.name);
+    free(t->rows);
+    memset(t, 0, sizeof(*t));
+}
+
+int fm_tree_expand(fm_tree *t, int row) {
+    fm_tree_node *n = fm_tree_row(t, row);
+    if (!n || !S_ISDIR(n->mode) || n->expanded) return 0;
+    if (!n->loaded && load(t, n) != 0) {
+        n->err = errno;
+        return -1;
+    }
+    n->err = 0;
+    n->expanded = 1;
+    int k = count_visible(n);
+    if (reserve(t, k) != 0) {
+        n->expanded = 0;
+        return -1;
+    }
+    move_gap(t, row + 1);
+    emit(n, t->rows + t->gap);
+    t->gap += k;
+    t->gaplen -= k;
+    t->nrows += k;
+    return k;
+}
+
+int fm_tree_collapse(fm_tree *t, int row) {
+    fm_tree_node *n = fm_tree_row(t, row);
+    if (!n || !n->expanded) return 0;
+    int k = count_visible(n);
+    /* The hidden rows simply become part of the gap */
+    move_gap(t, row + 1);
+    t->gaplen += k;
+    t->nrows -= k;
+    n->expanded = 0;
+    return k;
+}
+
+int fm_tree_reload(fm_tree *t, int row) {
+    fm_tree_node *n = fm_tree_row(t, row);
+    if (!n || !S_ISDIR(n->mode)) return 0;
+    int was = n->expanded;
+    fm_tree_collapse(t, row);
+    free_children(n);
+    return was && fm_tree_expand(t, row) < 0 ? -1 : 0;
+}
+
+int fm_tree_parent_row(const fm_tree *t, int row) {
+    const fm_tree_node *n = fm_tree_row(t, row);
+    if (!n || !n->parent) return -1;
+    for (int r = row - 1; r >= 0; --r) {
+        if (fm_tree_row(t, r) == n->parent) return r;
+    }
+    return -1;
+}
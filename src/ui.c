@@ -1,5 +1,17 @@
 #define _XOPEN_SOURCE 700
 #include "ui.h"
+#include "select.h"
+#include "cache.h"
+#include "perf.h"
+#include "dupes.h"
+#include "checksum.h"
+#include "prefetch.h"
+#include "index.h"
+#include "archive.h"
+#include "gzview.h"
+#include "compare.h"
+#include "tree.h"
+#include "jump.h"
 #include <ncurses.h>
 #include <stdlib.h>
 #include <string.h>
@@ -47,48 +59,50 @@ static void format_perms(mode_t mode, char *buf) {
 }
 
 /* Draw top header (single row) */
-static void draw_header(WINDOW *win, const char *path, int count) {
+static void draw_header(WINDOW *win, const char *path, int count, int marked) {
     int w = getmaxx(win);
     werase(win);
     wattron(win, COLOR_PAIR(1) | A_BOLD);
     mvwprintw(win, 0, 0, " File Manager - Path: %s", path);
+    if (marked > 0) mvwprintw(win, 0, w - 34, "Sel: %d", marked);
     mvwprintw(win, 0, w - 20, "Items: %d", count);
     wattroff(win, COLOR_PAIR(1) | A_BOLD);
     wnoutrefresh(win);
 }
 
-/* Draw file list into list window (row 0 reserved for column headers) */
-static void draw_list(WINDOW *win, fm_entry *items, int count, int sel, int offset) {
+/* Below this width (e.g. one half of a dual-pane layout) only type, size and name are shown */
+#define COMPACT_WIDTH 100
+
+/* Draw file list into list window (row 0 reserved for column headers).
+ * The inactive pane of a dual-pane layout shows its cursor underlined instead of reversed. */
+static void draw_list(WINDOW *win, const fm_entry *items, int count, int sel, int offset,
+                      const fm_selection *marks, int active) {
+    FM_PERF_START(render_t0);
     int h = getmaxy(win), w = getmaxx(win);
+    int compact = w < COMPACT_WIDTH;
+    attr_t cursor_attr = active ? A_REVERSE : A_UNDERLINE;
     werase(win);
 
     /* Column headers on row 0 - Type Links Perms Size Owner Group Modified Name */
-    wattron(win, COLOR_PAIR(2) | A_BOLD);
-    mvwprintw(win, 0, 0, " %s %5s %-9s %7s %-12s %-10s %-16s %s",
-              "T", "Links", "Perms", "Size", "Owner", "Group", "Modified", "Name");
-    wattroff(win, COLOR_PAIR(2) | A_BOLD);
+    wattron(win, COLOR_PAIR(2) | (active ? A_BOLD : A_NORMAL));
+    if (compact) {
+        mvwprintw(win, 0, 0, " %s %7s %s", "T", "Size", "Name");
+    } else {
+        mvwprintw(win, 0, 0, " %s %5s %-9s %7s %-12s %-10s %-16s %s",
+                  "T", "Links", "Perms", "Size", "Owner", "Group", "Modified", "Name");
+    }
+    wattroff(win, COLOR_PAIR(2) | (active ? A_BOLD : A_NORMAL));
 
     /* Items from row 1 .. h-1 */
     for (int row = 1; row < h && (row - 1 + offset) < count; ++row) {
         int idx = row - 1 + offset;
-        fm_entry *e = &items[idx];
+        const fm_entry *e = &items[idx];
+        FM_PERF_ADD(rows, 1);
 
         char file_type = get_file_type(e->st.st_mode);
-        nlink_t links = e->st.st_nlink;
-        char perms[12] = {0}, size_str[16] = {0}, owner[32] = {0}, group[32] = {0}, mtime[32] = {0};
-        format_perms(e->st.st_mode, perms);
+        char size_str[16] = {0};
         format_size(e->st.st_size, size_str, sizeof(size_str));
 
-        struct passwd *pw = getpwuid(e->st.st_uid);
-        struct group *gr = getgrgid(e->st.st_gid);
-        snprintf(owner, sizeof(owner), "%s", pw ? pw->pw_name : "?");
-        snprintf(group, sizeof(group), "%s", gr ? gr->gr_name : "?");
-
-        struct tm tm_buf;
-        struct tm *tm = localtime_r(&e->st.st_mtime, &tm_buf);
-        if (tm) strftime(mtime, sizeof(mtime), "%Y-%m-%d %H:%M", tm);
-        else snprintf(mtime, sizeof(mtime), "0000-00-00 00:00");
-
         /* Determine color based on file type */
         int color_pair;
         if (S_ISDIR(e->st.st_mode)) {
@@ -99,43 +113,167 @@ static void draw_list(WINDOW *win, fm_entry *items, int count, int sel, int offs
             color_pair = 6;  /* Green for regular files */
         }
 
+        /* Marked entries are bold with a '*' in the leading column */
+        int marked = fm_sel_test(marks, idx);
+        attr_t mark_attr = marked ? A_BOLD : A_NORMAL;
+
         /* Apply selection highlight or type color */
         if (idx == sel) {
-            wattron(win, COLOR_PAIR(3) | A_REVERSE);
+            wattron(win, COLOR_PAIR(3) | cursor_attr | mark_attr);
         } else {
-            wattron(win, COLOR_PAIR(color_pair));
+            wattron(win, COLOR_PAIR(color_pair) | mark_attr);
         }
 
-        /* Print fixed fields: Type(1) Links(5) Perms(9) Size(7) Owner(12) Group(10) Modified(16) */
-        mvwprintw(win, row, 0, " %c %5lu %-9s %7s %-12s %-10s %-16s ",
-                  file_type, (unsigned long)links, perms, size_str, owner, group, mtime);
+        if (compact) {
+            mvwprintw(win, row, 0, "%c%c %7s ", marked ? '*' : ' ', file_type, size_str);
+        } else {
+            char perms[12] = {0}, mtime[32] = {0};
+            format_perms(e->st.st_mode, perms);
+            struct tm tm_buf;
+            struct tm *tm = localtime_r(&e->st.st_mtime, &tm_buf);
+            if (tm) strftime(mtime, sizeof(mtime), "%Y-%m-%d %H:%M", tm);
+            else snprintf(mtime, sizeof(mtime), "0000-00-00 00:00");
+
+            /* Print fixed fields: Type(1) Links(5) Perms(9) Size(7) Owner(12) Group(10) Modified(16) */
+            mvwprintw(win, row, 0, "%c%c %5lu %-9s %7s %-12s %-10s %-16s ",
+                      marked ? '*' : ' ', file_type, (unsigned long)e->st.st_nlink, perms, size_str,
+                      fm_user_name(e->st.st_uid), fm_group_name(e->st.st_gid), mtime);
+        }
 
         /* Print name; ensure it doesn't overflow window width */
         int x = getcurx(win);
         int avail = w - x - 1;
         if (avail > 0) {
-            char truncated[PATH_MAX+1];
-            if ((int)strlen(e->name) > avail) {
-                strncpy(truncated, e->name, avail-3);
-                truncated[avail-3] = '\0';
-                strcat(truncated, "...");
-                mvwprintw(win, row, x, "%s", truncated);
-            } else {
-                mvwprintw(win, row, x, "%s", e->name);
-            }
+            if ((int)strlen(e->name) <= avail) mvwprintw(win, row, x, "%s", e->name);
+            else if (avail > 3) mvwprintw(win, row, x, "%.*s...", avail - 3, e->name);
+            else mvwprintw(win, row, x, "%.*s", avail, e->name);
         }
 
         /* Turn off attributes */
         if (idx == sel) {
-            wattroff(win, COLOR_PAIR(3) | A_REVERSE);
+            wattroff(win, COLOR_PAIR(3) | cursor_attr | mark_attr);
         } else {
-            wattroff(win, COLOR_PAIR(color_pair));
+            wattroff(win, COLOR_PAIR(color_pair) | mark_attr);
         }
     }
 
     wnoutrefresh(win);
+    FM_PERF_STOP(render_t0, render_ns);
+}
+
+
+/* Preview column: the highlighted directory's listing or the first lines of a file,
+ * served from the directory cache or the background prefetcher ("Loading..." until it
+ * has the result) */
+static void draw_preview(WINDOW *win, const fm_entry *e) {
+    FM_PERF_START(render_t0);
+    int h = getmaxy(win), w = getmaxx(win);
+    werase(win);
+    mvwvline(win, 0, 0, ACS_VLINE, h);
+    if (!e || w < 4) { wnoutrefresh(win); FM_PERF_STOP(render_t0, render_ns); return; }
+
+    wattron(win, COLOR_PAIR(1) | A_BOLD);
+    mvwprintw(win, 0, 2, "%.*s", w - 3, e->name);
+    wattroff(win, COLOR_PAIR(1) | A_BOLD);
+
+    const fm_dirlist *cached = e->is_dir ? fm_dircache_peek(e->path) : NULL;
+    const fm_preview *pv = !cached && (e->is_dir || S_ISREG(e->st.st_mode)) ? fm_prefetch_lookup(e->path) : NULL;
+    if (!e->is_dir && !S_ISREG(e->st.st_mode)) {
+        mvwprintw(win, 2, 2, "(no preview)");
+    } else if (!cached && !pv) {
+        mvwprintw(win, 2, 2, "Loading...");
+    } else if (!cached && pv->err) {
+        mvwprintw(win, 2, 2, "%.*s", w - 3, strerror(pv->err));
+    } else if (cached || pv->is_dir) {
+        const fm_entry *entries = cached ? cached->entries : pv->entries;
+        int count = cached ? cached->count : pv->count;
+        int row = 1;
+        for (int i = 0; i < count && row < h; ++i) {
+            const fm_entry *c = &entries[i];
+            if (strcmp(c->name, "..") == 0) continue;
+            int color = c->is_dir ? 5 : S_ISLNK(c->st.st_mode) ? 7 : 6;
+            wattron(win, COLOR_PAIR(color));
+            mvwprintw(win, row++, 2, "%.*s%s", w - 4, c->name, c->is_dir ? "/" : "");
+            wattroff(win, COLOR_PAIR(color));
+            FM_PERF_ADD(rows, 1);
+        }
+        if (row == 1) mvwprintw(win, 2, 2, "(empty)");
+    } else if (pv->binary) {
+        char size[16];
+        format_size(e->st.st_size, size, sizeof(size));
+        mvwprintw(win, 2, 2, "(binary file, %s)", size);
+    } else {
+        /* Control characters would move the cursor; show them as '.' */
+        const char *p = pv->text, *end = pv->text + pv->len;
+        for (int row = 1; row < h && p < end; ++row) {
+            wmove(win, row, 2);
+            int col = 2;
+            for (; p < end && *p != '\n'; ++p) {
+                if (col >= w) continue;
+                unsigned char c = *p;
+                if (c == '\t') { do waddch(win, ' '); while (++col < w && (col - 2) % 4); }
+                else { waddch(win, c < 32 || c == 127 ? '.' : c); col++; }
+            }
+            if (p < end) p++;
+            FM_PERF_ADD(rows, 1);
+        }
+    }
+    wnoutrefresh(win);
+    FM_PERF_STOP(render_t0, render_ns);
 }
 
+/* Push pending changes to the terminal (refresh() of stdscr, or doupdate() of the
+ * wnoutrefresh'ed windows), accounting output time and bytes when perf counters are on */
+static void screen_update(int stdscr_refresh) {
+#ifndef FM_NO_PERF
+    if (fm_perf_enabled) {
+        long long before = fm_perf_wchar();
+        unsigned long long t0 = fm_perf_now();
+        if (stdscr_refresh) refresh();
+        else doupdate();
+        fm_perf_frame.output_ns += fm_perf_now() - t0;
+        long long after = fm_perf_wchar();
+        if (before >= 0 && after >= before) fm_perf_frame.term_bytes += after - before;
+        return;
+    }
+#endif
+    if (stdscr_refresh) refresh();
+    else doupdate();
+}
+
+#define PERF_OVERLAY_H 11
+#define PERF_OVERLAY_W 50
+
+/* Performance overlay: counters of the last frame plus cache hit rates since start */
+static void draw_perf_overlay(WINDOW *win, const fm_perf *f, const char *op) {
+    werase(win);
+    wattron(win, COLOR_PAIR(1));
+    box(win, 0, 0);
+    mvwprintw(win, 0, 2, " Perf ");
+    wattroff(win, COLOR_PAIR(1));
+#ifdef FM_NO_PERF
+    (void)f; (void)op;
+    mvwprintw(win, 2, 2, "Counters compiled out (FM_NO_PERF)");
+#else
+    unsigned long frames;
+    const fm_perf *t = fm_perf_totals(&frames);
+    unsigned long names = t->name_hits + t->name_lookups, dirs = t->dir_hits + t->dir_misses;
+    mvwprintw(win, 1, 2, "last op: %-14.14s frames: %lu", op, frames);
+    mvwprintw(win, 2, 2, "scan   %8.2f ms %8lu ent %6lu stat", f->scan_ns / 1e6, f->entries, f->stat_calls);
+    mvwprintw(win, 3, 2, "sort   %8.2f ms", f->sort_ns / 1e6);
+    mvwprintw(win, 4, 2, "names  %8lu NSS  id cache %5.1f%% hit", f->name_lookups,
+              names ? 100.0 * t->name_hits / names : 0.0);
+    mvwprintw(win, 5, 2, "dirs   %8lu scan dir cache %5.1f%% hit", f->dir_misses,
+              dirs ? 100.0 * t->dir_hits / dirs : 0.0);
+    mvwprintw(win, 6, 2, "load   %8.2f ms", f->load_ns / 1e6);
+    mvwprintw(win, 7, 2, "render %8.2f ms %8lu rows", f->render_ns / 1e6, f->rows);
+    mvwprintw(win, 8, 2, "output %8.2f ms %8llu bytes", f->output_ns / 1e6, f->term_bytes);
+    mvwprintw(win, 9, 2, "RSS    %8.1f MB", fm_perf_rss_kb() / 1024.0);
+#endif
+    /* Panes underneath may have been repainted; always put the overlay back on top */
+    touchwin(win);
+    wnoutrefresh(win);
+}
 
 /* Show one-line status message at bottom */
 static void show_status(WINDOW *win, const char *msg) {
@@ -151,8 +289,6 @@ static void view_file_info(const fm_entry *e) {
     char perms[12], size_str[16];
     format_perms(e->st.st_mode, perms);
     format_size(e->st.st_size, size_str, sizeof(size_str));
-    struct passwd *pw = getpwuid(e->st.st_uid);
-    struct group *gr = getgrgid(e->st.st_gid);
     struct tm *tm_mtime = localtime(&e->st.st_mtime);
     struct tm *tm_atime = localtime(&e->st.st_atime);
     char mtime_str[64], atime_str[64];
@@ -174,12 +310,19 @@ static void view_file_info(const fm_entry *e) {
         mvprintw(row++, 2, "Size:       %s", size_str);
     }
     mvprintw(row++, 2, "Perms:      %s", perms);
-    mvprintw(row++, 2, "Owner:      %s", pw ? pw->pw_name : "?");
-    mvprintw(row++, 2, "Group:      %s", gr ? gr->gr_name : "?");
+    mvprintw(row++, 2, "Owner:      %s", fm_user_name(e->st.st_uid));
+    mvprintw(row++, 2, "Group:      %s", fm_group_name(e->st.st_gid));
     mvprintw(row++, 2, "Inode:      %llu", (unsigned long long)e->st.st_ino);
     mvprintw(row++, 2, "Modified:   %s", mtime_str);
     mvprintw(row++, 2, "Accessed:   %s", atime_str);
     mvprintw(row++, 2, "Path:       %s", e->path);
+    /* Digests already computed for this exact file version; 'h' computes new ones */
+    if (S_ISREG(e->st.st_mode)) {
+        for (int a = 0; a < FM_SUM_ALGOS; ++a) {
+            char hex[FM_SUM_HEX_MAX];
+            if (fm_sum_cached(&e->st, a, hex) == 0) mvprintw(row++, 2, "%-12s%s", fm_sum_name(a), hex);
+        }
+    }
     attroff(COLOR_PAIR(2));
 
     attron(COLOR_PAIR(4));
@@ -196,7 +339,7 @@ static void view_file_info(const fm_entry *e) {
 static void draw_help_bar(WINDOW *win) {
     werase(win);
     wattron(win, COLOR_PAIR(4));
-    mvwprintw(win, 0, 0, " [q]Quit [Enter]Open [Bksp]Up [n]NewDir [f]NewFile [d]Del [r]Rename [m]Move [c]Copy [i]Info [o]View [e]Edit");
+    mvwprintw(win, 0, 0, " [q]Quit [Enter]Open [Bksp]Up [n]NewDir [f]NewFile [d]Del [r]Rename [m]Move [c]Copy [i]Info [o]View [e]Edit [p]Chmod [v]Preview [Spc]Mark [a]Range [+]Glob [*]Invert [-]Unmark [h]Checksum [k]Verify [u]Dupes [g]Search [s]Compare [t]Tree [j]Jump");
     wattroff(win, COLOR_PAIR(4));
     wnoutrefresh(win);
 }
@@ -267,42 +410,355 @@ static void show_status_and_wait(WINDOW *win, const char *msg) {
     wgetch(stdscr);
 }
 
-/* Resize windows when terminal changes size */
-static void resize_windows(WINDOW **header, WINDOW **listw, WINDOW **status) {
+/* Resolve a user-supplied directory relative to cwd; 0 if it is an existing directory */
+static int resolve_dir(char *dest, size_t dest_size, const char *cwd, const char *input) {
+    if (input[0] == '/') {
+        if (snprintf(dest, dest_size, "%s", input) >= (int)dest_size) return -1;
+    } else if (build_path(dest, dest_size, cwd, input) == -1) {
+        return -1;
+    }
+    struct stat st;
+    if (stat(dest, &st) != 0 || !S_ISDIR(st.st_mode)) return -2;
+    return 0;
+}
+
+/* Progress state for a batched job shown in the status bar */
+typedef struct batch_progress {
+    WINDOW *win;
+    const char *verb;
+} batch_progress;
+
+/* Repaint the status bar only every few hundred entries to keep the job syscall-bound */
+static void batch_progress_cb(void *ctx, int done, int total) {
+    batch_progress *bp = ctx;
+    if (done % 256 != 0 && done != total) return;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%s %d/%d...", bp->verb, done, total);
+    show_status(bp->win, msg);
+    doupdate();
+}
+
+/* Run one batched job over the given entries and show a single summary line */
+static void run_batch(WINDOW *status, fm_batch_op op, const char *cwd, const char *dest, mode_t mode,
+                      const fm_entry *const *set, int n) {
+    static const char *verbs[] = { "Deleting", "Moving", "Copying", "Changing mode of" };
+    static const char *titles[] = { "Delete", "Move", "Copy", "Chmod" };
+    batch_progress bp = { status, verbs[op] };
+    fm_batch job = { op, cwd, dest, mode, batch_progress_cb, &bp };
+    fm_batch_result res;
+    fm_batch_run(&job, set, n, &res);
+
+    char msg[1024];
+    if (res.failed == 0) {
+        snprintf(msg, sizeof(msg), "✓ %s: %d done, %d skipped. Press any key...",
+                 titles[op], res.done, res.skipped);
+    } else {
+        snprintf(msg, sizeof(msg), "✗ %s: %d done, %d failed, %d skipped (first: %s: %s). Press any key...",
+                 titles[op], res.done, res.failed, res.skipped,
+                 res.first_failed[0] ? res.first_failed : cwd, strerror(res.first_errno));
+    }
+    show_status_and_wait(status, msg);
+}
+
+/* Collect pointers to the marked entries; caller frees. Returns count or -1 */
+static int collect_marked(const fm_selection *marks, const fm_entry *items, const fm_entry ***set_out) {
+    const fm_entry **set = malloc((marks->count ? marks->count : 1) * sizeof(*set));
+    if (!set) return -1;
+    int n = 0;
+    for (int i = fm_sel_next(marks, 0); i >= 0 && n < marks->count; i = fm_sel_next(marks, i + 1)) {
+        set[n++] = &items[i];
+    }
+    *set_out = set;
+    return n;
+}
+
+/* Delete, move or copy every marked entry as one job with a single prompt.
+ * An empty destination means default_dir (the other pane) when one is given. */
+static void batch_marked(WINDOW *status, fm_batch_op op, const char *cwd, const fm_entry *items,
+                         fm_selection *marks, const char *default_dir) {
+    char dest[PATH_MAX * 2] = "";
+    if (op == FM_BATCH_DELETE) {
+        char q[128];
+        snprintf(q, sizeof(q), "Delete %d marked items? [y/n]", marks->count);
+        show_status(status, q);
+        doupdate();
+        int c = wgetch(stdscr);
+        if (c != 'y' && c != 'Y') return;
+    } else {
+        char input[PATH_MAX];
+        char q[128];
+        snprintf(q, sizeof(q), "%s %d marked items to directory (path%s):",
+                 op == FM_BATCH_MOVE ? "Move" : "Copy", marks->count,
+                 default_dir ? ", Enter: other pane" : "");
+        if (prompt_input(status, q, input, sizeof(input)) != 0) return;
+        if (strlen(input) == 0) {
+            if (!default_dir) return;
+            snprintf(input, sizeof(input), "%s", default_dir);
+        }
+        int rc = resolve_dir(dest, sizeof(dest), cwd, input);
+        if (rc == -1) { show_status_and_wait(status, "✗ Path too long. Press any key..."); return; }
+        if (rc == -2) { show_status_and_wait(status, "✗ Destination directory does not exist. Press any key..."); return; }
+    }
+
+    const fm_entry **set = NULL;
+    int n = collect_marked(marks, items, &set);
+    if (n < 0) { show_status_and_wait(status, "✗ Out of memory. Press any key..."); return; }
+    run_batch(status, op, cwd, dest, 0, set, n);
+    free(set);
+    fm_sel_clear(marks);
+}
+
+/* One directory listing view; dual-pane mode shows two side by side */
+typedef struct pane {
+    WINDOW *win;
+    char cwd[PATH_MAX];
+    fm_dirlist *list;      /* shared with the other pane when both show one directory */
+    fm_tar *arc;           /* archive being browsed (list is then private to the pane), or NULL */
+    unsigned long gen;     /* listing generation last seen */
+    int sel, offset;
+    fm_selection marks;
+    int dirty;             /* needs repaint */
+} pane;
+
+/* Metadata index (optional); directories it covers render from it before they are read */
+static fm_index index_map;
+static int index_mapped;
+
+static void index_reopen(const char *file) {
+    if (index_mapped) fm_index_close(&index_map);
+    index_mapped = fm_index_open(&index_map, file) == 0;
+}
+
+/* Path of an archive member relative to the archive root, NULL if path is outside t */
+static const char *archive_rel(const fm_tar *t, const char *path) {
+    size_t len = strlen(t->path);
+    if (strncmp(path, t->path, len) != 0) return NULL;
+    if (path[len] == '\0') return path + len;
+    return path[len] == '/' ? path + len + 1 : NULL;
+}
+
+/* Find the tar archive that path is, or lies inside of: 1 with *t referenced and rel set to
+ * the member directory, 0 if there is none, -1 if it cannot be read */
+static int archive_for(const char *path, fm_tar **t, char *rel, size_t relsize) {
+    char buf[PATH_MAX], real[PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s", path);
+    while (1) {
+        struct stat st;
+        if (fm_tar_is_archive(buf) && stat(buf, &st) == 0 && S_ISREG(st.st_mode)) {
+            const char *rest = path + strlen(buf);
+            snprintf(rel, relsize, "%s", *rest == '/' ? rest + 1 : rest);
+            *t = realpath(buf, real) ? fm_tar_get(real) : NULL;
+            return *t ? 1 : -1;
+        }
+        char *slash = strrchr(buf, '/');
+        if (!slash || slash == buf) return 0;
+        *slash = '\0';
+    }
+}
+
+/* Drop the pane's listing: a shared cache reference, or its private archive listing */
+static void pane_release_list(pane *p) {
+    if (!p->list) return;
+    if (p->arc) {
+        free(p->list->entries);
+        free(p->list);
+    } else {
+        fm_dircache_release(p->list);
+    }
+    p->list = NULL;
+}
+
+/* Install a listing in a pane; arc is the archive it came from, whose reference the pane keeps */
+static void pane_set_list(pane *p, fm_dirlist *l, fm_tar *arc) {
+    pane_release_list(p);
+    fm_tar_release(p->arc);
+    p->arc = arc;
+    p->list = l;
+    p->gen = l->gen;
+    snprintf(p->cwd, sizeof(p->cwd), "%s", l->path);
+    p->sel = p->offset = 0;
+    fm_sel_resize(&p->marks, l->count);
+    p->dirty = 1;
+}
+
+/* List member directory rel of archive t in a pane; consumes one reference to t */
+static int pane_list_archive(pane *p, fm_tar *t, const char *rel) {
+    fm_entry *entries;
+    int n = fm_tar_list(t, rel, &entries);
+    fm_dirlist *l = n >= 0 ? calloc(1, sizeof(*l)) : NULL;
+    if (!l) {
+        int saved = errno;
+        if (n >= 0) free(entries);
+        fm_tar_release(t);
+        errno = saved;
+        return -1;
+    }
+    if (snprintf(l->path, sizeof(l->path), "%s%s%s", t->path, *rel ? "/" : "", rel) >= (int)sizeof(l->path)) {
+        free(entries);
+        free(l);
+        fm_tar_release(t);
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    l->entries = entries;
+    l->count = n;
+    l->refs = 1;
+    l->wd = -1;
+    pane_set_list(p, l, t);
+    return 0;
+}
+
+/* Point a pane at a new directory; the old listing is kept on failure. Tar archives and
+ * directories inside them are listed from the archive's member index */
+static int pane_chdir(pane *p, const char *path) {
+    char rel[PATH_MAX];
+    const char *inside = p->arc ? archive_rel(p->arc, path) : NULL;
+    if (inside) {
+        /* The new listing holds its own reference; pane_set_list drops the old one */
+        p->arc->refs++;
+        return pane_list_archive(p, p->arc, inside);
+    }
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        int saved = errno;
+        fm_tar *t;
+        int found = archive_for(path, &t, rel, sizeof(rel));
+        if (found > 0) return pane_list_archive(p, t, rel);
+        if (found < 0) return -1;
+        errno = saved;
+    }
+
+    char resolved[PATH_MAX];
+    if (realpath(path, resolved) == NULL) {
+        /* fallback to given path (maybe relative) */
+        strncpy(resolved, path, sizeof(resolved)-1);
+        resolved[sizeof(resolved)-1] = '\0';
+    }
+    /* A listing the prefetcher already read is adopted instead of scanning again */
+    fm_entry *pre;
+    int pre_count;
+    struct timespec pre_mtime;
+    if (fm_prefetch_take_dir(resolved, &pre, &pre_count, &pre_mtime) == 0) {
+        fm_dircache_adopt(resolved, pre, pre_count, &pre_mtime);
+    } else if (index_mapped && !fm_dircache_contains(resolved)) {
+        /* Otherwise an indexed directory is shown from the index and re-read in the background */
+        uint32_t id = fm_index_find_dir(&index_map, resolved);
+        if (id != FM_INDEX_NONE && (pre_count = fm_index_listing(&index_map, id, &pre, &pre_mtime)) >= 0) {
+            fm_dircache_seed(resolved, pre, pre_count, &pre_mtime);
+        }
+    }
+    fm_dirlist *l = fm_dircache_get(resolved);
+    if (!l) return -1;
+    pane_set_list(p, l, NULL);
+    return 0;
+}
+
+/* Pick up a rescanned listing; only panes whose directory changed get repainted */
+static void pane_sync(pane *p) {
+    if (p->list->stale && fm_dircache_revalidate(p->list) != 0) return;
+    if (p->gen == p->list->gen) return;
+    p->gen = p->list->gen;
+    int count = p->list->count;
+    /* Marks are indices into the listing; a changed listing invalidates them even when the
+     * count is unchanged (a rename or a replaced file), so they are always dropped */
+    fm_sel_resize(&p->marks, count);
+    if (p->sel >= count) p->sel = count > 0 ? count - 1 : 0;
+    if (p->offset > p->sel) p->offset = p->sel;
+    p->dirty = 1;
+}
+
+/* Scroll so the cursor stays visible (row 0 holds the column headers) */
+static void pane_follow(pane *p) {
+    int visible_rows = getmaxy(p->win) - 1;
+    if (visible_rows < 1) visible_rows = 1;
+    if (p->sel < p->offset) p->offset = p->sel;
+    if (p->sel - p->offset >= visible_rows) p->offset = p->sel - visible_rows + 1;
+}
+
+/* Ask the prefetcher for the highlighted entry and its neighbours: directories not in the
+ * directory cache (so Enter is instant), regular files only while their preview is shown. A listing
+ * seeded from the index comes first, since it is on screen until its re-read lands */
+static void pane_prefetch(const pane *p, int files) {
+    const char *paths[5];
+    int dirs[5], n = 0;
+    if (p->list->provisional) {
+        paths[n] = p->cwd;
+        dirs[n++] = 1;
+    }
+    static const int around[] = { 0, 1, -1, 2 };
+    /* Archive members are not on disk; nothing to prefetch */
+    for (int k = 0; k < 4 && !p->arc; ++k) {
+        int i = p->sel + around[k];
+        if (i < 0 || i >= p->list->count) continue;
+        const fm_entry *e = &p->list->entries[i];
+        /* ".." is keyed "<cwd>/..", which never matches a realpath'd listing */
+        if (strcmp(e->name, "..") == 0) continue;
+        if (!e->is_dir && !(files && S_ISREG(e->st.st_mode))) continue;
+        /* A fresh cached listing is already kept current by the watcher */
+        if (e->is_dir && fm_dircache_peek(e->path)) continue;
+        paths[n] = e->path;
+        dirs[n++] = e->is_dir;
+    }
+    fm_prefetch_want(paths, dirs, n);
+}
+
+/* Lay out header, pane(s), preview column (NULL when hidden) and status for the current terminal size */
+static void resize_windows(WINDOW *header, pane *panes, int dual, int active, WINDOW *preview, WINDOW *status) {
     int h, w; getmaxyx(stdscr, h, w);
 
     /* Resize header (1 row) */
-    wresize(*header, 1, w);
-    mvwin(*header, 0, 0);
+    wresize(header, 1, w);
+    mvwin(header, 0, 0);
 
-    /* Resize list window between header and status */
+    /* Resize list window(s) between header and status */
     int list_h = (h >= 3) ? (h - 2) : 1;
-    wresize(*listw, list_h, w);
-    mvwin(*listw, 1, 0);
+    if (dual) {
+        int left_w = w / 2;
+        wresize(panes[0].win, list_h, left_w);
+        mvwin(panes[0].win, 1, 0);
+        wresize(panes[1].win, list_h, w - left_w);
+        mvwin(panes[1].win, 1, left_w);
+    } else if (preview) {
+        int preview_w = w * 2 / 5;
+        wresize(panes[active].win, list_h, w - preview_w);
+        mvwin(panes[active].win, 1, 0);
+        wresize(preview, list_h, preview_w);
+        mvwin(preview, 1, w - preview_w);
+    } else {
+        wresize(panes[active].win, list_h, w);
+        mvwin(panes[active].win, 1, 0);
+    }
+    panes[0].dirty = panes[1].dirty = 1;
 
     /* Resize status (1 row) at bottom */
-    wresize(*status, 1, w);
-    mvwin(*status, h - 1, 0);
+    wresize(status, 1, w);
+    mvwin(status, h - 1, 0);
 
     /* Make sure curses redraws everything */
     clear();
     refresh();
 }
 
-/* View file content with scrolling capability */
-static void view_file_content(const char *filepath) {
+/* File content split into lines for the built-in viewer */
+typedef struct viewer_doc {
+    char **lines;
+    int count;
+} viewer_doc;
+
+/* Largest part of an archive member loaded into the viewer */
+#define ARCHIVE_VIEW_MAX (64 * 1024 * 1024)
+
+/* Load a file (or, with arc, an archive member read in place) and split it into lines;
+ * returns 0 on success, -1 on error */
+static int viewer_load(const char *filepath, const fm_tar *arc, viewer_doc *doc) {
+    FM_PERF_START(load_t0);
     char *content = NULL;
-    ssize_t size = fm_read_file(filepath, &content);
-    
-    if (size < 0 || !content) {
-        /* Show error message */
-        clear();
-        mvprintw(0, 0, "Error: Unable to read file '%s'", filepath);
-        mvprintw(1, 0, "Press any key to return...");
-        refresh();
-        getch();
-        return;
-    }
+    const char *member = arc ? archive_rel(arc, filepath) : NULL;
+    ssize_t size = member ? fm_tar_read(arc, fm_tar_find(arc, member), ARCHIVE_VIEW_MAX, &content)
+                          : fm_read_file(filepath, &content);
+    doc->lines = NULL;
+    doc->count = 0;
+    if (size < 0 || !content) return -1;
     
     /* Split content into lines */
     int line_count = 0;
@@ -310,7 +766,7 @@ static void view_file_content(const char *filepath) {
     char **lines = malloc(line_cap * sizeof(char*));
     if (!lines) {
         free(content);
-        return;
+        return -1;
     }
     
     char *p = content;
@@ -349,51 +805,87 @@ static void view_file_content(const char *filepath) {
     }
     
     free(content);
-    
-    /* Display file content with scrolling */
-    int offset = 0;
+    doc->lines = lines;
+    doc->count = line_count;
+    FM_PERF_STOP(load_t0, load_ns);
+    return 0;
+}
+
+static void viewer_free(viewer_doc *doc) {
+    for (int i = 0; i < doc->count; i++) {
+        free(doc->lines[i]);
+    }
+    free(doc->lines);
+    doc->lines = NULL;
+    doc->count = 0;
+}
+
+/* Draw one screen of the viewer starting at line offset (stdscr, not yet refreshed) */
+static void viewer_draw(const char *filepath, const viewer_doc *doc, int offset) {
+    FM_PERF_START(render_t0);
     int h, w;
+    getmaxyx(stdscr, h, w);
+    clear();
     
-    while (1) {
-        getmaxyx(stdscr, h, w);
-        clear();
-        
-        /* Header */
-        attron(COLOR_PAIR(1) | A_BOLD);
-        mvprintw(0, 0, " File Viewer: %s", filepath);
-        mvprintw(0, w - 30, " Lines: %d", line_count);
-        attroff(COLOR_PAIR(1) | A_BOLD);
+    /* Header */
+    attron(COLOR_PAIR(1) | A_BOLD);
+    mvprintw(0, 0, " File Viewer: %s", filepath);
+    mvprintw(0, w - 30, " Lines: %d", doc->count);
+    attroff(COLOR_PAIR(1) | A_BOLD);
+    
+    /* Content area (leave 2 rows for header and footer) */
+    int content_h = h - 2;
+    for (int i = 0; i < content_h && (i + offset) < doc->count; i++) {
+        int line_idx = i + offset;
+        FM_PERF_ADD(rows, 1);
+        /* Show line number and content */
+        attron(COLOR_PAIR(2));
+        mvprintw(i + 1, 0, "%5d ", line_idx + 1);
+        attroff(COLOR_PAIR(2));
         
-        /* Content area (leave 2 rows for header and footer) */
-        int content_h = h - 2;
-        for (int i = 0; i < content_h && (i + offset) < line_count; i++) {
-            int line_idx = i + offset;
-            /* Show line number and content */
-            attron(COLOR_PAIR(2));
-            mvprintw(i + 1, 0, "%5d ", line_idx + 1);
-            attroff(COLOR_PAIR(2));
-            
-            /* Truncate line if too long */
-            if (strlen(lines[line_idx]) > (size_t)(w - 7)) {
-                char truncated[4096];
-                strncpy(truncated, lines[line_idx], w - 10);
-                truncated[w - 10] = '\0';
-                strcat(truncated, "...");
-                printw("%s", truncated);
-            } else {
-                printw("%s", lines[line_idx]);
-            }
+        /* Truncate line if too long */
+        if (strlen(doc->lines[line_idx]) > (size_t)(w - 7)) {
+            char truncated[4096];
+            strncpy(truncated, doc->lines[line_idx], w - 10);
+            truncated[w - 10] = '\0';
+            strcat(truncated, "...");
+            printw("%s", truncated);
+        } else {
+            printw("%s", doc->lines[line_idx]);
         }
-        
-        /* Footer / Help bar */
-        attron(COLOR_PAIR(4));
-        mvprintw(h - 1, 0, " [q]Quit [UP/DOWN]Scroll [PgUp/PgDn]Page [Home]Top [End]Bottom");
-        /* Pad rest of line */
-        for (int x = getcurx(stdscr); x < w; x++) addch(' ');
-        attroff(COLOR_PAIR(4));
-        
+    }
+    
+    /* Footer / Help bar */
+    attron(COLOR_PAIR(4));
+    mvprintw(h - 1, 0, " [q]Quit [UP/DOWN]Scroll [PgUp/PgDn]Page [Home]Top [End]Bottom");
+    /* Pad rest of line */
+    for (int x = getcurx(stdscr); x < w; x++) addch(' ');
+    attroff(COLOR_PAIR(4));
+    FM_PERF_STOP(render_t0, render_ns);
+}
+
+/* View file content with scrolling capability; arc is the archive filepath lies in, if any */
+static void view_file_content(const char *filepath, const fm_tar *arc) {
+    viewer_doc doc;
+    if (viewer_load(filepath, arc, &doc) != 0) {
+        /* Show error message */
+        clear();
+        mvprintw(0, 0, "Error: Unable to read file '%s'", filepath);
+        mvprintw(1, 0, "Press any key to return...");
         refresh();
+        getch();
+        return;
+    }
+    
+    /* Display file content with scrolling */
+    int offset = 0;
+    int line_count = doc.count;
+    
+    while (1) {
+        viewer_draw(filepath, &doc, offset);
+        screen_update(1);
         
+        int content_h = getmaxy(stdscr) - 2;
         int ch = getch();
         if (ch == 'q' || ch == 'Q' || ch == 27) break; /* ESC also exits */
         else if (ch == KEY_DOWN) {
@@ -423,148 +915,1305 @@ static void view_file_content(const char *filepath) {
     }
     
     /* Cleanup */
-    for (int i = 0; i < line_count; i++) {
-        free(lines[i]);
-    }
-    free(lines);
+    viewer_free(&doc);
     
     /* Force complete redraw when returning to main UI */
     clear();
     refresh();
 }
 
-/* Main UI loop */
-int fm_ui_run(const char *startpath) {
-    if (!startpath) startpath = ".";
-
-    initscr();
-    if (!has_colors()) {
-        endwin();
-        fprintf(stderr, "Terminal does not support colors\n");
-        return 1;
-    }
-    start_color();
-    use_default_colors();
-    init_pair(1, COLOR_CYAN, -1);    /* header */
-    init_pair(2, COLOR_YELLOW, -1);  /* column headers */
-    init_pair(3, COLOR_WHITE, -1);   /* selection */
-    init_pair(4, COLOR_BLACK, COLOR_WHITE); /* status/help bar */
-    init_pair(5, COLOR_BLUE, -1);    /* directory */
-    init_pair(6, COLOR_GREEN, -1);   /* regular file */
-    init_pair(7, COLOR_CYAN, -1);    /* symbolic link */
+/* Bytes decompressed per screen of the gzip viewer; longer lines are cut */
+#define GZ_VIEW_READ (64 * 1024)
 
-    noecho();
-    curs_set(0);
+/* Start of the line after the one starting at top, or top on the last line */
+static off_t gz_next_line(fm_gz *gz, off_t top, char *buf) {
+    ssize_t n = fm_gz_pread(gz, buf, GZ_VIEW_READ, top);
+    if (n <= 0) return top;
+    char *nl = memchr(buf, '\n', n);
+    if (!nl) return n == GZ_VIEW_READ ? top + n : top;
+    off_t next = top + (nl - buf) + 1;
+    return (nl - buf) + 1 < n || n == GZ_VIEW_READ ? next : top;
+}
 
-    /* IMPORTANT: keep stdscr leaveok = FALSE so initial draw causes proper cursor movement/scroll */
-    keypad(stdscr, TRUE);
-    scrollok(stdscr, FALSE);
-    leaveok(stdscr, FALSE);
+/* Start of the line before the one starting at top (gz_prev_line(x + 1) is the start of
+ * the line holding byte x); steps back at most GZ_VIEW_READ bytes */
+static off_t gz_prev_line(fm_gz *gz, off_t top, char *buf) {
+    if (top <= 1) return 0;
+    off_t from = top - 1 > GZ_VIEW_READ ? top - 1 - GZ_VIEW_READ : 0;
+    ssize_t n = fm_gz_pread(gz, buf, (size_t)(top - 1 - from), from);
+    if (n <= 0) return 0;
+    for (ssize_t i = n; i > 0; --i)
+        if (buf[i - 1] == '\n') return from + i;
+    return from;
+}
 
-    int h, w; getmaxyx(stdscr, h, w);
-    WINDOW *header = newwin(1, w, 0, 0);
-    WINDOW *listw = newwin((h >= 3) ? (h - 2) : 1, w, 1, 0);
-    WINDOW *status = newwin(1, w, h - 1, 0);
+/* Footer progress for a full gzip scan; any key cancels */
+static int gz_scan_progress(void *ctx, off_t in, off_t total) {
+    int *last = ctx;
+    int pct = total > 0 ? (int)(in * 100 / total) : 100;
+    if (pct != *last) {
+        *last = pct;
+        int h = getmaxy(stdscr);
+        attron(COLOR_PAIR(4));
+        mvprintw(h - 1, 0, " Decompressing... %d%%  (any key to cancel)", pct);
+        clrtoeol();
+        attroff(COLOR_PAIR(4));
+        refresh();
+    }
+    wtimeout(stdscr, 0);
+    int ch = getch();
+    wtimeout(stdscr, -1);
+    return ch != ERR;
+}
 
-    /* For the child windows, also prefer normal cursor movements (leaveok FALSE) */
-    scrollok(header, FALSE); leaveok(header, FALSE);
-    scrollok(listw, FALSE); leaveok(listw, FALSE);
-    scrollok(status, FALSE); leaveok(status, FALSE);
+/* Decode the whole file once so its length is known; 0 when it is */
+static int gz_view_scan(fm_gz *gz) {
+    int last = -1;
+    return fm_gz_scan(gz, gz_scan_progress, &last) == 0 && gz->complete ? 0 : -1;
+}
 
-    /* Draw initial blank screen so user sees app immediately */
+static void gz_view_draw(const char *filepath, fm_gz *gz, off_t top, char *buf) {
+    FM_PERF_START(render_t0);
+    int h, w;
+    getmaxyx(stdscr, h, w);
     clear();
-    refresh();
 
-    char cwd[PATH_MAX];
-    if (realpath(startpath, cwd) == NULL) {
-        /* fallback to given path (maybe relative) */
-        strncpy(cwd, startpath, sizeof(cwd)-1);
-        cwd[sizeof(cwd)-1] = '\0';
+    ssize_t n = fm_gz_pread(gz, buf, GZ_VIEW_READ, top);
+    char pos[64], size[32];
+    if (gz->complete) {
+        format_size(gz->size, size, sizeof(size));
+        snprintf(pos, sizeof(pos), " %d%% of %s", gz->size ? (int)(top * 100 / gz->size) : 100, size);
+    } else {
+        format_size(gz->frontier, size, sizeof(size));
+        snprintf(pos, sizeof(pos), " %s+ decompressed", size);
     }
+    attron(COLOR_PAIR(1) | A_BOLD);
+    mvprintw(0, 0, " Gzip Viewer: %s", filepath);
+    mvprintw(0, w - 30, "%s", pos);
+    attroff(COLOR_PAIR(1) | A_BOLD);
 
-    fm_entry *items = NULL;
-    int count = 0;
-    int sel = 0, offset = 0;
-
-    while (1) {
-        int r = fm_read_dir(cwd, &items);
-        if (r < 0) {
-            char errbuf[256];
-            snprintf(errbuf, sizeof(errbuf), "Error reading directory: %s", strerror(errno));
-            show_status(status, errbuf);
-            wnoutrefresh(header);
-            wnoutrefresh(listw);
-            wnoutrefresh(status);
-            doupdate();
-            wgetch(stdscr);
-            break;
+    if (n < 0) {
+        mvprintw(1, 0, "✗ Decompression error: %s", strerror(errno));
+    } else {
+        const char *p = buf, *end = buf + n;
+        for (int row = 1; row < h - 1 && p < end; ++row) {
+            const char *nl = memchr(p, '\n', end - p);
+            const char *eol = nl ? nl : end;
+            FM_PERF_ADD(rows, 1);
+            move(row, 0);
+            if (eol - p > w - 1) {
+                addnstr(p, w - 4);
+                addstr("...");
+            } else {
+                addnstr(p, eol - p);
+            }
+            p = nl ? nl + 1 : end;
         }
-        count = r;
-        if (count == 0) { sel = 0; offset = 0; }
-        if (sel >= count) sel = count > 0 ? count - 1 : 0;
-        if (sel < 0) sel = 0;
-        if (offset < 0) offset = 0;
+    }
 
-        /* Draw UI using wnoutrefresh then doupdate for flicker-free update */
-        draw_header(header, cwd, count);
-        draw_list(listw, items, count, sel, offset);
-        draw_help_bar(status);
-        doupdate();
+    attron(COLOR_PAIR(4));
+    mvprintw(h - 1, 0, " [q]Quit [UP/DOWN]Scroll [PgUp/PgDn]Page [Home]Top [End]Bottom [%%]Jump to percent");
+    for (int x = getcurx(stdscr); x < w; x++) addch(' ');
+    attroff(COLOR_PAIR(4));
+    FM_PERF_STOP(render_t0, render_ns);
+}
 
-        int ch = wgetch(stdscr);
+/* View a gzip file without unpacking it: only the screen being shown is decompressed,
+ * from the nearest checkpoint the reader recorded on its way through the file */
+static void view_gzip(const char *filepath) {
+    fm_gz *gz = fm_gz_open(filepath);
+    char *buf = gz ? malloc(GZ_VIEW_READ) : NULL;
+    if (!buf) {
+        clear();
+        mvprintw(0, 0, "Error: Unable to read file '%s'", filepath);
+        mvprintw(1, 0, "Press any key to return...");
+        refresh();
+        getch();
+        fm_gz_close(gz);
+        return;
+    }
 
-        if (ch == 'q' || ch == 'Q') break;
+    off_t top = 0;
+    while (1) {
+        gz_view_draw(filepath, gz, top, buf);
+        screen_update(1);
+
+        int content_h = getmaxy(stdscr) - 2;
+        int ch = getch();
+        if (ch == 'q' || ch == 'Q' || ch == 27) break;
         else if (ch == KEY_DOWN) {
-            if (sel + 1 < count) sel++;
-            /* if selection would fall off visible area, advance offset */
-            int visible_rows = getmaxy(listw) - 1; /* row 0 is headers */
-            if (sel - offset >= visible_rows) offset = sel - visible_rows + 1;
+            top = gz_next_line(gz, top, buf);
         }
         else if (ch == KEY_UP) {
-            if (sel > 0) sel--;
-            if (sel < offset) offset = sel;
+            top = gz_prev_line(gz, top, buf);
         }
-        else if (ch == 10 || ch == KEY_ENTER) {
-            if (count == 0) continue;
-            fm_entry *e = &items[sel];
-            if (e->is_dir) {
-                if (realpath(e->path, cwd) == NULL) {
-                    strncpy(cwd, e->path, sizeof(cwd)-1);
-                    cwd[sizeof(cwd)-1] = '\0';
-                }
-                sel = offset = 0;
+        else if (ch == KEY_NPAGE) {
+            for (int i = 0; i < content_h; i++) top = gz_next_line(gz, top, buf);
+        }
+        else if (ch == KEY_PPAGE) {
+            for (int i = 0; i < content_h && top > 0; i++) top = gz_prev_line(gz, top, buf);
+        }
+        else if (ch == KEY_HOME) {
+            top = 0;
+        }
+        else if (ch == KEY_END) {
+            if (gz_view_scan(gz) != 0) continue;
+            top = gz->size;
+            for (int i = 0; i < content_h && top > 0; i++) top = gz_prev_line(gz, top, buf);
+        }
+        else if (ch == '%') {
+            char input[8] = "";
+            int h = getmaxy(stdscr);
+            attron(COLOR_PAIR(4));
+            mvprintw(h - 1, 0, " Jump to percent (0-100): ");
+            clrtoeol();
+            attroff(COLOR_PAIR(4));
+            echo();
+            curs_set(1);
+            getnstr(input, sizeof(input) - 1);
+            noecho();
+            curs_set(0);
+            char *endp;
+            long pct = strtol(input, &endp, 10);
+            if (endp == input || pct < 0 || pct > 100) continue;
+            if (gz_view_scan(gz) != 0) continue;
+            top = gz->size * pct / 100;
+            if (top >= gz->size) {
+                top = gz->size;
+                for (int i = 0; i < content_h && top > 0; i++) top = gz_prev_line(gz, top, buf);
             } else {
-                char buf[512];
-                char perms[12], size_str[16];
-                format_perms(e->st.st_mode, perms);
-                format_size(e->st.st_size, size_str, sizeof(size_str));
-                struct passwd *pw = getpwuid(e->st.st_uid);
-                struct group *gr = getgrgid(e->st.st_gid);
-                struct tm tm_buf;
-                struct tm *tm = localtime_r(&e->st.st_mtime, &tm_buf);
-                snprintf(buf, sizeof(buf), "%s | %s | %s:%s | %04d-%02d-%02d %02d:%02d | Inode: %llu | Press any key...",
-                         perms, size_str,
-                         pw ? pw->pw_name : "?", gr ? gr->gr_name : "?",
-                         tm ? (tm->tm_year+1900) : 0, tm ? (tm->tm_mon+1) : 0, tm ? tm->tm_mday : 0,
-                         tm ? tm->tm_hour : 0, tm ? tm->tm_min : 0,
-                         (unsigned long long)e->st.st_ino);
-                show_status(status, buf);
-                doupdate();
-                wgetch(stdscr);
+                top = gz_prev_line(gz, top + 1, buf);
             }
         }
-        else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8) {
-            /* go up one directory */
-            char *p = strrchr(cwd, '/');
-            if (p && p != cwd) *p = '\0';
-            else strcpy(cwd, "/");
-            sel = offset = 0;
-        }
-        else if (ch == 'n' || ch == 'N') {
-            char name[PATH_MAX];
-            if (prompt_input(status, "New directory name:", name, sizeof(name)) == 0 && strlen(name) > 0) {
+    }
+
+    free(buf);
+    fm_gz_close(gz);
+    clear();
+    refresh();
+}
+
+/* Status-bar progress for a checksum run */
+static void sum_progress_cb(void *ctx, int done, int total) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Hashing %d/%d...", done, total);
+    show_status(ctx, msg);
+    doupdate();
+}
+
+static void sums_draw(const char *title, const char *base, const fm_sum_job *jobs, int n, int verify,
+                      int offset) {
+    int h, w;
+    getmaxyx(stdscr, h, w);
+    erase();
+    attron(COLOR_PAIR(1) | A_BOLD);
+    mvprintw(0, 0, " %s", title);
+    attroff(COLOR_PAIR(1) | A_BOLD);
+
+    size_t baselen = strlen(base);
+    for (int i = 0; i < h - 2 && offset + i < n; ++i) {
+        const fm_sum_job *j = &jobs[offset + i];
+        const char *name = j->path;
+        if (strncmp(name, base, baselen) == 0 && name[baselen] == '/') name += baselen + 1;
+        if (verify) {
+            int ok = !j->err && strcmp(j->hex, j->expected) == 0;
+            const char *tag = ok ? "OK" : j->err == ENOENT ? "MISSING" : j->err ? "ERROR" : "FAILED";
+            if (!ok) attron(A_BOLD);
+            mvprintw(i + 1, 0, " %-8s%-7s %.*s", tag, fm_sum_name(j->algo), w > 18 ? w - 18 : 1, name);
+            if (!ok) attroff(A_BOLD);
+        } else if (j->err) {
+            mvprintw(i + 1, 0, " %-16s  %s (%s)", "-", name, strerror(j->err));
+        } else {
+            mvprintw(i + 1, 0, " %s  %.*s", j->hex, w > 4 ? w - 4 : 1, name);
+        }
+    }
+
+    attron(COLOR_PAIR(4));
+    mvprintw(h - 1, 0, verify ? " [q]Back [UP/DOWN]Scroll [PgUp/PgDn]Page"
+                              : " [q]Back [UP/DOWN]Scroll [PgUp/PgDn]Page [w]Write manifest");
+    for (int x = getcurx(stdscr); x < w; x++) addch(' ');
+    attroff(COLOR_PAIR(4));
+}
+
+/* Full-screen list of checksum or verification results; base is stripped from paths */
+static void view_sums(WINDOW *status, const char *title, const char *base, const fm_sum_job *jobs, int n,
+                      int verify) {
+    int offset = 0;
+    while (1) {
+        int page = getmaxy(stdscr) - 2;
+        if (page < 1) page = 1;
+        int max_off = n > page ? n - page : 0;
+        if (offset > max_off) offset = max_off;
+        sums_draw(title, base, jobs, n, verify, offset);
+        screen_update(1);
+
+        int ch = getch();
+        if (ch == 'q' || ch == 'Q' || ch == 27) break;
+        else if (ch == KEY_DOWN) offset++;
+        else if (ch == KEY_UP && offset > 0) offset--;
+        else if (ch == KEY_NPAGE) offset += page;
+        else if (ch == KEY_PPAGE) offset = offset > page ? offset - page : 0;
+        else if (ch == KEY_HOME) offset = 0;
+        else if (ch == KEY_END) offset = max_off;
+        else if ((ch == 'w' || ch == 'W') && !verify && n > 0) {
+            char name[PATH_MAX], q[128], path[PATH_MAX * 2];
+            snprintf(q, sizeof(q), "Manifest name (Enter: CHECKSUMS.%s):", fm_sum_name(jobs[0].algo));
+            if (prompt_input(status, q, name, sizeof(name)) != 0) continue;
+            if (strlen(name) == 0) snprintf(name, sizeof(name), "CHECKSUMS.%s", fm_sum_name(jobs[0].algo));
+            if ((name[0] == '/' ? snprintf(path, sizeof(path), "%s", name) >= (int)sizeof(path)
+                                : build_path(path, sizeof(path), base, name) == -1)) {
+                show_status_and_wait(status, "✗ Path too long. Press any key...");
+            } else if (fm_sum_write_manifest(path, jobs, n) == 0) {
+                show_status_and_wait(status, "✓ Manifest written. Press any key...");
+            } else {
+                char msg[256];
+                snprintf(msg, sizeof(msg), "✗ Cannot write manifest: %s. Press any key...", strerror(errno));
+                show_status_and_wait(status, msg);
+            }
+        }
+    }
+    clear();
+    refresh();
+}
+
+/* Checksum the marked files (or the file under the cursor) with an algorithm chosen by key */
+static void checksum_entries(WINDOW *status, const char *cwd, const fm_entry *items, int sel,
+                             const fm_selection *marks) {
+    show_status(status, "Checksum with [x]xxh64 [c]crc32c [s]sha256 (Enter: xxh64, other key cancels)");
+    doupdate();
+    int c = wgetch(stdscr);
+    fm_sum_algo algo;
+    if (c == 'x' || c == 'X' || c == 10 || c == KEY_ENTER) algo = FM_SUM_XXH64;
+    else if (c == 'c' || c == 'C') algo = FM_SUM_CRC32C;
+    else if (c == 's' || c == 'S') algo = FM_SUM_SHA256;
+    else return;
+
+    int cap = marks->count > 0 ? marks->count : 1;
+    fm_sum_job *jobs = calloc(cap, sizeof(*jobs));
+    if (!jobs) { show_status_and_wait(status, "✗ Out of memory. Press any key..."); return; }
+    int n = 0;
+    for (int i = marks->count > 0 ? fm_sel_next(marks, 0) : sel; i >= 0 && n < cap;
+         i = marks->count > 0 ? fm_sel_next(marks, i + 1) : -1) {
+        if (items[i].is_dir) continue;
+        if (!(jobs[n].path = strdup(items[i].path))) break;
+        jobs[n++].algo = algo;
+    }
+    if (n == 0) {
+        fm_sum_jobs_free(jobs, n);
+        show_status_and_wait(status, "✗ Nothing to checksum (directories are skipped). Press any key...");
+        return;
+    }
+    fm_sum_files(jobs, n, sum_progress_cb, status);
+
+    if (n == 1 && !jobs[0].err) {
+        char msg[PATH_MAX + 128];
+        snprintf(msg, sizeof(msg), "✓ %s %s  %s%s. Press any key...", fm_sum_name(algo), jobs[0].hex,
+                 strrchr(jobs[0].path, '/') ? strrchr(jobs[0].path, '/') + 1 : jobs[0].path,
+                 jobs[0].cached ? " (cached)" : "");
+        show_status_and_wait(status, msg);
+    } else {
+        char title[PATH_MAX + 64];
+        snprintf(title, sizeof(title), "Checksums (%s): %d files in %s", fm_sum_name(algo), n, cwd);
+        view_sums(status, title, cwd, jobs, n, 0);
+    }
+    fm_sum_jobs_free(jobs, n);
+}
+
+/* Re-hash every file listed in a manifest and show which ones still match */
+static void verify_manifest(WINDOW *status, const char *manifest) {
+    fm_sum_job *jobs = NULL;
+    int malformed = 0;
+    int n = fm_sum_read_manifest(manifest, &jobs, &malformed);
+    if (n < 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "✗ Cannot read manifest: %s. Press any key...", strerror(errno));
+        show_status_and_wait(status, msg);
+        return;
+    }
+    if (n == 0) {
+        fm_sum_jobs_free(jobs, n);
+        show_status_and_wait(status, "✗ No checksum lines found. Press any key...");
+        return;
+    }
+    fm_sum_files(jobs, n, sum_progress_cb, status);
+
+    int ok = 0, failed = 0, missing = 0;
+    for (int i = 0; i < n; ++i) {
+        if (jobs[i].err == ENOENT) missing++;
+        else if (!jobs[i].err && strcmp(jobs[i].hex, jobs[i].expected) == 0) ok++;
+        else failed++;
+    }
+    char base[PATH_MAX];
+    snprintf(base, sizeof(base), "%s", manifest);
+    char *slash = strrchr(base, '/');
+    if (slash) *slash = '\0';
+    char title[PATH_MAX + 128];
+    snprintf(title, sizeof(title), "Verify %s: %d ok, %d failed, %d missing, %d malformed lines",
+             slash ? slash + 1 : manifest, ok, failed, missing, malformed);
+    view_sums(status, title, base, jobs, n, 1);
+    fm_sum_jobs_free(jobs, n);
+}
+
+/* Status-bar progress for a duplicate scan */
+static void dupes_progress_cb(void *ctx, const char *stage, long done, long total) {
+    char msg[128];
+    if (total > 0) snprintf(msg, sizeof(msg), "%s %ld/%ld...", stage, done, total);
+    else snprintf(msg, sizeof(msg), "%s: %ld files...", stage, done);
+    show_status(ctx, msg);
+    doupdate();
+}
+
+/* One screen row of the duplicates view: a group title (file < 0) or one of its files */
+typedef struct dupe_row {
+    int group;
+    int file;
+} dupe_row;
+
+static void dupes_draw(const char *root, const fm_dupes *d, const dupe_row *rows, int nrows,
+                       const unsigned char *marks, int sel, int offset) {
+    int h, w;
+    getmaxyx(stdscr, h, w);
+    erase();
+    char wasted[16];
+    format_size((off_t)d->wasted, wasted, sizeof(wasted));
+    attron(COLOR_PAIR(1) | A_BOLD);
+    mvprintw(0, 0, " Duplicates: %s  (%d groups, %s reclaimable, %lu hardlinks skipped)",
+             root, d->ngroups, wasted, d->hardlinks);
+    attroff(COLOR_PAIR(1) | A_BOLD);
+
+    size_t rootlen = strlen(root);
+    for (int i = 0; i < h - 2 && offset + i < nrows; ++i) {
+        const dupe_row *r = &rows[offset + i];
+        const fm_dupe_group *g = &d->groups[r->group];
+        if (i + offset == sel) attron(A_REVERSE);
+        if (r->file < 0) {
+            char size[16];
+            format_size(d->files[g->first].size, size, sizeof(size));
+            attron(COLOR_PAIR(2) | A_BOLD);
+            mvprintw(i + 1, 0, " %d copies x %s", g->count, size);
+            attroff(COLOR_PAIR(2) | A_BOLD);
+        } else {
+            const fm_dupe_file *f = &d->files[r->file];
+            /* Paths are shown relative to the scanned directory */
+            const char *name = f->path;
+            if (strncmp(name, root, rootlen) == 0 && name[rootlen] == '/') name += rootlen + 1;
+            const char *state = f->state == FM_DUPE_DELETED ? " (deleted)" :
+                                f->state == FM_DUPE_LINKED ? " (linked)" : "";
+            if (marks[r->file]) attron(A_BOLD);
+            mvprintw(i + 1, 0, "   %c %.*s%s", marks[r->file] ? '*' : ' ', w > 16 ? w - 16 : 1, name, state);
+            if (marks[r->file]) attroff(A_BOLD);
+        }
+        if (i + offset == sel) attroff(A_REVERSE);
+    }
+
+    attron(COLOR_PAIR(4));
+    mvprintw(h - 1, 0, " [q]Back [Spc]Mark [a]Mark all but first [-]Unmark [d]Delete marked [l]Hardlink marked");
+    for (int x = getcurx(stdscr); x < w; x++) addch(' ');
+    attroff(COLOR_PAIR(4));
+}
+
+/* Delete (link = 0) or hardlink every marked copy. The first unmarked copy of a group is
+ * kept; a group with every copy marked is left alone so no content is ever lost. */
+static void dupes_apply(WINDOW *status, fm_dupes *d, unsigned char *marks, int link) {
+    int done = 0, failed = 0, skipped = 0, first_errno = 0;
+    unsigned long long freed = 0;
+    for (int g = 0; g < d->ngroups; ++g) {
+        fm_dupe_file *files = &d->files[d->groups[g].first];
+        unsigned char *gm = &marks[d->groups[g].first];
+        int n = d->groups[g].count;
+        fm_dupe_file *keep = NULL;
+        int marked = 0;
+        for (int i = 0; i < n; ++i) {
+            if (files[i].state == FM_DUPE_DELETED) continue;
+            if (gm[i]) marked++;
+            else if (!keep) keep = &files[i];
+        }
+        if (!marked) continue;
+        if (!keep || fm_dupe_unchanged(keep) != 0) { skipped += marked; continue; }
+        for (int i = 0; i < n; ++i) {
+            fm_dupe_file *f = &files[i];
+            if (!gm[i] || f->state == FM_DUPE_DELETED) continue;
+            int rc;
+            /* Content may have changed since it was hashed */
+            if (fm_dupe_unchanged(f) != 0) { skipped++; continue; }
+            if (link && f->dev != keep->dev) { rc = -1; errno = EXDEV; }
+            else rc = link ? fm_link_replace(keep->path, f->path) : fm_remove(f->path);
+            if (rc == 0) {
+                f->state = link ? FM_DUPE_LINKED : FM_DUPE_DELETED;
+                if (link) { f->ino = keep->ino; f->mtime = keep->mtime; }
+                gm[i] = 0;
+                freed += f->size;
+                done++;
+            } else {
+                if (!first_errno) first_errno = errno;
+                failed++;
+            }
+        }
+    }
+
+    char msg[256], size[16];
+    format_size((off_t)freed, size, sizeof(size));
+    if (failed == 0) {
+        snprintf(msg, sizeof(msg), "✓ %s: %d done, %s freed, %d skipped. Press any key...",
+                 link ? "Hardlink" : "Delete", done, size, skipped);
+    } else {
+        snprintf(msg, sizeof(msg), "✗ %s: %d done, %d failed (%s), %d skipped. Press any key...",
+                 link ? "Hardlink" : "Delete", done, failed, strerror(first_errno), skipped);
+    }
+    show_status_and_wait(status, msg);
+}
+
+/* Find duplicate files below root and let the user delete or hardlink copies */
+static void view_dupes(WINDOW *status, const char *root) {
+    fm_dupes d;
+    if (fm_find_dupes(root, &d, dupes_progress_cb, status) != 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "✗ Duplicate scan failed: %s. Press any key...", strerror(errno));
+        show_status_and_wait(status, msg);
+        return;
+    }
+    if (d.ngroups == 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "✓ No duplicates among %lu files. Press any key...", d.scanned);
+        show_status_and_wait(status, msg);
+        fm_dupes_free(&d);
+        return;
+    }
+
+    int nrows = d.ngroups + d.nfiles;
+    dupe_row *rows = malloc(nrows * sizeof(*rows));
+    unsigned char *marks = calloc(d.nfiles, 1);
+    if (!rows || !marks) {
+        free(rows);
+        free(marks);
+        fm_dupes_free(&d);
+        show_status_and_wait(status, "✗ Out of memory. Press any key...");
+        return;
+    }
+    int r = 0;
+    for (int g = 0; g < d.ngroups; ++g) {
+        rows[r++] = (dupe_row){ g, -1 };
+        for (int i = 0; i < d.groups[g].count; ++i) rows[r++] = (dupe_row){ g, d.groups[g].first + i };
+    }
+
+    int sel = 1, offset = 0;
+    while (1) {
+        int page = getmaxy(stdscr) - 2;
+        if (page < 1) page = 1;
+        if (sel < offset) offset = sel;
+        if (sel >= offset + page) offset = sel - page + 1;
+        dupes_draw(root, &d, rows, nrows, marks, sel, offset);
+        screen_update(1);
+
+        int ch = getch();
+        if (ch == 'q' || ch == 'Q' || ch == 27) break;
+        else if (ch == KEY_DOWN && sel + 1 < nrows) sel++;
+        else if (ch == KEY_UP && sel > 0) sel--;
+        else if (ch == KEY_NPAGE) sel = sel + page < nrows ? sel + page : nrows - 1;
+        else if (ch == KEY_PPAGE) sel = sel > page ? sel - page : 0;
+        else if (ch == KEY_HOME) sel = 0;
+        else if (ch == KEY_END) sel = nrows - 1;
+        else if (ch == ' ') {
+            int f = rows[sel].file;
+            if (f >= 0 && d.files[f].state != FM_DUPE_DELETED) marks[f] = !marks[f];
+            if (sel + 1 < nrows) sel++;
+        }
+        else if (ch == 'a' || ch == 'A') {
+            for (int g = 0; g < d.ngroups; ++g) {
+                int kept = 0;
+                for (int i = d.groups[g].first; i < d.groups[g].first + d.groups[g].count; ++i) {
+                    if (d.files[i].state == FM_DUPE_DELETED) continue;
+                    marks[i] = kept++ > 0;
+                }
+            }
+        }
+        else if (ch == '-') {
+            memset(marks, 0, d.nfiles);
+        }
+        else if (ch == 'd' || ch == 'D' || ch == 'l' || ch == 'L') {
+            int link = ch == 'l' || ch == 'L', n = 0;
+            for (int i = 0; i < d.nfiles; ++i) n += marks[i];
+            if (n == 0) continue;
+            char q[128];
+            snprintf(q, sizeof(q), "%s %d marked copies? [y/n]", link ? "Replace with hardlinks" : "Delete", n);
+            show_status(status, q);
+            doupdate();
+            int c = wgetch(stdscr);
+            if (c == 'y' || c == 'Y') dupes_apply(status, &d, marks, link);
+        }
+        else if (ch == KEY_RESIZE) {
+            clear();
+        }
+    }
+
+    free(rows);
+    free(marks);
+    fm_dupes_free(&d);
+    clear();
+    refresh();
+}
+
+/* Status-bar progress for a tree comparison */
+static void compare_progress_cb(void *ctx, int done, int total) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Comparing: %d/%d directories...", done, total);
+    show_status(ctx, msg);
+    doupdate();
+}
+
+/* Report a finished sync on the status bar */
+static void sync_report(WINDOW *status, const fm_sync_stats *st) {
+    char msg[PATH_MAX + 256], size[16];
+    format_size((off_t)st->bytes, size, sizeof(size));
+    if (st->failed == 0) {
+        snprintf(msg, sizeof(msg), "✓ Sync finished: %d/%d done, %s copied, %d skipped. Press any key...",
+                 st->done, st->total, size, st->skipped);
+    } else {
+        snprintf(msg, sizeof(msg), "✗ Sync: %d/%d done, %d failed (%.*s: %s), %d skipped. Press any key...",
+                 st->done, st->total, st->failed, 200, st->first_failed, strerror(st->first_errno), st->skipped);
+    }
+    show_status_and_wait(status, msg);
+}
+
+static void compare_draw(const fm_compare *c, int sel, int offset, const fm_sync_stats *sync) {
+    int h, w;
+    getmaxyx(stdscr, h, w);
+    erase();
+    attron(COLOR_PAIR(1) | A_BOLD);
+    mvprintw(0, 0, " Compare: %s -> %s", c->left, c->right);
+    attroff(COLOR_PAIR(1) | A_BOLD);
+    attron(COLOR_PAIR(2));
+    mvprintw(1, 0, " %lu only left  %lu only right  %lu different  %lu same  (%lu directories on both sides)",
+             c->counts[FM_CMP_ONLY_LEFT], c->counts[FM_CMP_ONLY_RIGHT], c->counts[FM_CMP_DIFFERENT],
+             c->counts[FM_CMP_SAME], c->dirs);
+    attroff(COLOR_PAIR(2));
+
+    int namew = w > 50 ? w - 46 : 4;
+    for (int i = 0; i < h - 3 && offset + i < c->count; ++i) {
+        const fm_cmp_item *it = &c->items[offset + i];
+        char mark = '?', lsize[16] = "-", rsize[16] = "-";
+        const char *note = "";
+        switch (it->state) {
+        case FM_CMP_ONLY_LEFT:  mark = '<'; note = "only left"; break;
+        case FM_CMP_ONLY_RIGHT: mark = '>'; note = "only right"; break;
+        case FM_CMP_SAME:       mark = '='; note = "same content"; break;
+        case FM_CMP_ERROR:      mark = '?'; note = strerror(it->err); break;
+        default:
+            mark = '!';
+            if ((it->lmode & S_IFMT) != (it->rmode & S_IFMT)) note = "type differs";
+            else if (it->hashed) note = "content differs";
+            else if (fm_cmp_hashable(it)) { mark = '~'; note = "mtime differs"; }
+            else if (S_ISLNK(it->lmode)) note = "target differs";
+            else note = "size differs";
+        }
+        if (it->lmode) format_size(it->lsize, lsize, sizeof(lsize));
+        if (it->rmode) format_size(it->rsize, rsize, sizeof(rsize));
+        int dir = S_ISDIR(it->lmode) || S_ISDIR(it->rmode);
+        char name[PATH_MAX + 2];
+        snprintf(name, sizeof(name), "%s%s", it->rel[0] ? it->rel : ".", dir ? "/" : "");
+        if (offset + i == sel) attron(A_REVERSE);
+        if (dir) attron(COLOR_PAIR(5));
+        mvprintw(i + 2, 0, " %c %-*.*s %9s %9s  %.16s", mark, namew, namew, name, lsize, rsize, note);
+        if (dir) attroff(COLOR_PAIR(5));
+        if (offset + i == sel) attroff(A_REVERSE);
+    }
+    if (c->count == 0) mvprintw(2, 0, " The trees are identical.");
+
+    attron(COLOR_PAIR(4));
+    if (sync) {
+        char size[16];
+        format_size((off_t)sync->bytes, size, sizeof(size));
+        mvprintw(h - 1, 0, " Syncing: %d/%d done, %d failed, %s copied   [x]Cancel [q]Back (keeps running)",
+                 sync->done, sync->total, sync->failed, size);
+    } else {
+        mvprintw(h - 1, 0, " [q]Back [h]Hash mtime-only differences [s]Sync left -> right [r]Rescan");
+    }
+    for (int x = getcurx(stdscr); x < w; x++) addch(' ');
+    attroff(COLOR_PAIR(4));
+}
+
+/* Compare left with right and offer a one-way sync; the sync keeps running in the background
+ * if the view is left, and fm_ui_run reports it when it ends */
+static void view_compare(WINDOW *status, const char *left, const char *right) {
+    fm_compare c;
+    if (fm_compare_run(left, right, &c, compare_progress_cb, status) != 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "✗ Compare failed: %s. Press any key...", strerror(errno));
+        show_status_and_wait(status, msg);
+        return;
+    }
+
+    int sel = 0, offset = 0, syncing = 0;
+    fm_sync_stats sst;
+    memset(&sst, 0, sizeof(sst));
+    while (1) {
+        int page = getmaxy(stdscr) - 3;
+        if (page < 1) page = 1;
+        if (sel >= c.count) sel = c.count > 0 ? c.count - 1 : 0;
+        if (sel < offset) offset = sel;
+        if (sel >= offset + page) offset = sel - page + 1;
+        compare_draw(&c, sel, offset, syncing ? &sst : NULL);
+        screen_update(1);
+
+        /* Tick while a sync runs so its progress stays current */
+        wtimeout(stdscr, syncing ? 200 : -1);
+        int ch = getch();
+        wtimeout(stdscr, -1);
+        if (syncing) {
+            int rc = fm_sync_poll(&sst);
+            if (rc != 0) {
+                syncing = 0;
+                if (rc == 1) sync_report(status, &sst);
+                /* Show what is left to do */
+                fm_compare_free(&c);
+                if (fm_compare_run(left, right, &c, compare_progress_cb, status) != 0) {
+                    char msg[256];
+                    snprintf(msg, sizeof(msg), "✗ Compare failed: %s. Press any key...", strerror(errno));
+                    show_status_and_wait(status, msg);
+                    break;
+                }
+                continue;
+            }
+        }
+        if (ch == ERR) continue;
+        if (ch == 'q' || ch == 'Q' || ch == 27) break;
+        else if (ch == KEY_DOWN && sel + 1 < c.count) sel++;
+        else if (ch == KEY_UP && sel > 0) sel--;
+        else if (ch == KEY_NPAGE) sel = sel + page < c.count ? sel + page : c.count - 1;
+        else if (ch == KEY_PPAGE) sel = sel > page ? sel - page : 0;
+        else if (ch == KEY_HOME) sel = 0;
+        else if (ch == KEY_END) sel = c.count > 0 ? c.count - 1 : 0;
+        else if ((ch == 'x' || ch == 'X') && syncing) {
+            fm_sync_stop();
+        }
+        else if (syncing) {
+            continue;
+        }
+        else if (ch == 'h' || ch == 'H') {
+            int n = fm_compare_hash(&c, sum_progress_cb, status);
+            if (n < 0) {
+                show_status_and_wait(status, "✗ Out of memory. Press any key...");
+            } else if (n == 0) {
+                show_status_and_wait(status, "✓ No same-size files differ by mtime alone. Press any key...");
+            }
+        }
+        else if (ch == 'r' || ch == 'R') {
+            fm_compare_free(&c);
+            if (fm_compare_run(left, right, &c, compare_progress_cb, status) != 0) {
+                char msg[256];
+                snprintf(msg, sizeof(msg), "✗ Compare failed: %s. Press any key...", strerror(errno));
+                show_status_and_wait(status, msg);
+                break;
+            }
+        }
+        else if (ch == 's' || ch == 'S') {
+            int copies = 0, updates = 0, conflicts = 0, extra = 0;
+            for (int i = 0; i < c.count; ++i) {
+                const fm_cmp_item *it = &c.items[i];
+                if (it->state == FM_CMP_ONLY_LEFT) copies++;
+                else if (it->state == FM_CMP_ONLY_RIGHT) extra++;
+                else if (it->state != FM_CMP_DIFFERENT) continue;
+                else if ((it->lmode & S_IFMT) == (it->rmode & S_IFMT) && (S_ISREG(it->lmode) || S_ISLNK(it->lmode))) updates++;
+                else conflicts++;
+            }
+            if (copies + updates + extra == 0) {
+                show_status_and_wait(status, "✓ Nothing to sync. Press any key...");
+                continue;
+            }
+            char q[256];
+            snprintf(q, sizeof(q), "Sync: copy %d new, update %d (%d conflicts skipped)? [y]es [m]irror (+delete %d) [n]o",
+                     copies, updates, conflicts, extra);
+            show_status(status, q);
+            doupdate();
+            int a = wgetch(stdscr);
+            if (a != 'y' && a != 'Y' && a != 'm' && a != 'M') continue;
+            if (fm_sync_start(&c, a == 'm' || a == 'M') != 0) {
+                char msg[256];
+                snprintf(msg, sizeof(msg), "✗ Cannot sync: %s. Press any key...",
+                         errno == EINVAL ? "one tree contains the other" : strerror(errno));
+                show_status_and_wait(status, msg);
+                continue;
+            }
+            syncing = 1;
+            memset(&sst, 0, sizeof(sst));
+        }
+        else if (ch == KEY_RESIZE) {
+            clear();
+        }
+    }
+
+    fm_compare_free(&c);
+    clear();
+    refresh();
+}
+
+#define SEARCH_MAX_HITS 10000
+
+static void search_draw(const char *pattern, const uint32_t *hits, int nhits, int total, int sel, int offset) {
+    int h, w;
+    getmaxyx(stdscr, h, w);
+    erase();
+    attron(COLOR_PAIR(1) | A_BOLD);
+    if (total > nhits) mvprintw(0, 0, " Search '%s': %d matches (first %d shown)", pattern, total, nhits);
+    else mvprintw(0, 0, " Search '%s': %d matches", pattern, total);
+    attroff(COLOR_PAIR(1) | A_BOLD);
+
+    for (int i = 0; i < h - 2 && offset + i < nhits; ++i) {
+        const fm_index_node *nd = &index_map.nodes[hits[offset + i]];
+        char path[PATH_MAX];
+        if (fm_index_path(&index_map, hits[offset + i], path, sizeof(path)) != 0) {
+            snprintf(path, sizeof(path), ".../%s", fm_index_name(&index_map, hits[offset + i]));
+        }
+        int color = S_ISDIR(nd->mode) ? 5 : S_ISLNK(nd->mode) ? 7 : 6;
+        if (offset + i == sel) attron(A_REVERSE);
+        attron(COLOR_PAIR(color));
+        mvprintw(i + 1, 0, " %c %.*s%s", get_file_type(nd->mode), w > 5 ? w - 5 : 1, path,
+                 S_ISDIR(nd->mode) ? "/" : "");
+        attroff(COLOR_PAIR(color));
+        if (offset + i == sel) attroff(A_REVERSE);
+    }
+
+    attron(COLOR_PAIR(4));
+    mvprintw(h - 1, 0, " [q]Back [UP/DOWN]Move [PgUp/PgDn]Page [Enter]Go to");
+    for (int x = getcurx(stdscr); x < w; x++) addch(' ');
+    attroff(COLOR_PAIR(4));
+}
+
+/* Search every indexed name; on Enter the containing directory and entry name of the
+ * chosen hit are stored and 1 is returned */
+static int view_search(WINDOW *status, char *dir, size_t dirsize, char *name, size_t namesize) {
+    char pattern[256];
+    if (prompt_input(status, "Search index (glob or substring):", pattern, sizeof(pattern)) != 0 ||
+        strlen(pattern) == 0) {
+        return 0;
+    }
+    uint32_t *hits = malloc(SEARCH_MAX_HITS * sizeof(*hits));
+    if (!hits) { show_status_and_wait(status, "✗ Out of memory. Press any key..."); return 0; }
+    int total = fm_index_search(&index_map, pattern, hits, SEARCH_MAX_HITS);
+    int nhits = total < SEARCH_MAX_HITS ? total : SEARCH_MAX_HITS;
+    if (nhits == 0) {
+        free(hits);
+        show_status_and_wait(status, "✗ No matches in the index. Press any key...");
+        return 0;
+    }
+
+    int sel = 0, offset = 0, chosen = 0;
+    while (1) {
+        int page = getmaxy(stdscr) - 2;
+        if (page < 1) page = 1;
+        if (sel < offset) offset = sel;
+        if (sel >= offset + page) offset = sel - page + 1;
+        search_draw(pattern, hits, nhits, total, sel, offset);
+        screen_update(1);
+
+        int ch = getch();
+        if (ch == 'q' || ch == 'Q' || ch == 27) break;
+        else if (ch == KEY_DOWN && sel + 1 < nhits) sel++;
+        else if (ch == KEY_UP && sel > 0) sel--;
+        else if (ch == KEY_NPAGE) sel = sel + page < nhits ? sel + page : nhits - 1;
+        else if (ch == KEY_PPAGE) sel = sel > page ? sel - page : 0;
+        else if (ch == KEY_HOME) sel = 0;
+        else if (ch == KEY_END) sel = nhits - 1;
+        else if (ch == 10 || ch == KEY_ENTER) {
+            uint32_t parent = index_map.nodes[hits[sel]].parent;
+            if (parent == FM_INDEX_NONE) parent = hits[sel];
+            if (fm_index_path(&index_map, parent, dir, dirsize) != 0) continue;
+            snprintf(name, namesize, "%s", fm_index_name(&index_map, hits[sel]));
+            chosen = 1;
+            break;
+        }
+        else if (ch == KEY_RESIZE) {
+            clear();
+        }
+    }
+    free(hits);
+    clear();
+    refresh();
+    return chosen;
+}
+
+static void tree_draw(const fm_tree *t, int sel, int offset) {
+    int h, w;
+    getmaxyx(stdscr, h, w);
+    erase();
+    attron(COLOR_PAIR(1) | A_BOLD);
+    mvprintw(0, 0, " Tree: %.*s  (%d rows, %lu directories read)", w > 50 ? w - 50 : 1, t->root.name,
+             t->nrows, t->reads);
+    attroff(COLOR_PAIR(1) | A_BOLD);
+
+    /* Only the visible rows are touched */
+    for (int i = 0; i < h - 2 && offset + i < t->nrows; ++i) {
+        const fm_tree_node *n = fm_tree_row(t, offset + i);
+        int isdir = S_ISDIR(n->mode);
+        int color = isdir ? 5 : S_ISLNK(n->mode) ? 7 : 6;
+        int indent = 2 * n->depth < w / 2 ? 2 * n->depth : w / 2;
+        char size[32] = "";
+        if (n->err) snprintf(size, sizeof(size), "%s", strerror(n->err));
+        else if (!isdir) format_size(n->size, size, sizeof(size));
+        int room = w - indent - (int)strlen(size) - 6;
+        if (offset + i == sel) attron(A_REVERSE);
+        attron(COLOR_PAIR(color));
+        mvprintw(i + 1, 0, " %*s%c %.*s%s", indent, "", isdir ? (n->expanded ? '-' : '+') : ' ',
+                 room > 1 ? room : 1, n->name, isdir && n->depth ? "/" : "");
+        attroff(COLOR_PAIR(color));
+        mvprintw(i + 1, w - (int)strlen(size) - 1, "%s", size);
+        if (offset + i == sel) attroff(A_REVERSE);
+    }
+
+    attron(COLOR_PAIR(4));
+    mvprintw(h - 1, 0, " [q]Back [UP/DOWN]Move [RIGHT]Expand [LEFT]Collapse [Enter]Toggle/Go to [g]Open [r]Reload");
+    for (int x = getcurx(stdscr); x < w; x++) addch(' ');
+    attroff(COLOR_PAIR(4));
+}
+
+/* Browse the hierarchy below root, expanding directories in place; on Enter on a file (or
+ * g on any entry) the directory to open and the entry to select are stored and 1 is
+ * returned. Subtrees are read once and kept while the view is open */
+static int view_tree(WINDOW *status, const char *root, char *dir, size_t dirsize, char *name, size_t namesize) {
+    fm_tree t;
+    if (fm_tree_init(&t, root) != 0) {
+        char msg[PATH_MAX + 64];
+        snprintf(msg, sizeof(msg), "✗ Cannot read %s: %s. Press any key...", root, strerror(errno));
+        show_status_and_wait(status, msg);
+        return 0;
+    }
+
+    int sel = 0, offset = 0, chosen = 0;
+    while (1) {
+        int page = getmaxy(stdscr) - 2;
+        if (page < 1) page = 1;
+        if (sel >= t.nrows) sel = t.nrows - 1;
+        if (sel < offset) offset = sel;
+        if (sel >= offset + page) offset = sel - page + 1;
+        FM_PERF_START(render_t0);
+        tree_draw(&t, sel, offset);
+        FM_PERF_STOP(render_t0, render_ns);
+        screen_update(1);
+
+        fm_tree_node *n = fm_tree_row(&t, sel);
+        int ch = getch();
+        if (ch == 'q' || ch == 'Q' || ch == 27) break;
+        else if (ch == KEY_DOWN && sel + 1 < t.nrows) sel++;
+        else if (ch == KEY_UP && sel > 0) sel--;
+        else if (ch == KEY_NPAGE) sel = sel + page < t.nrows ? sel + page : t.nrows - 1;
+        else if (ch == KEY_PPAGE) sel = sel > page ? sel - page : 0;
+        else if (ch == KEY_HOME) sel = 0;
+        else if (ch == KEY_END) sel = t.nrows - 1;
+        else if (ch == KEY_RIGHT) {
+            /* A second Right steps into an expanded directory */
+            if (n->expanded) { if (n->nchildren && sel + 1 < t.nrows) sel++; }
+            else fm_tree_expand(&t, sel);
+        }
+        else if (ch == KEY_LEFT) {
+            if (n->expanded) fm_tree_collapse(&t, sel);
+            else {
+                int up = fm_tree_parent_row(&t, sel);
+                if (up >= 0) sel = up;
+            }
+        }
+        else if ((ch == 10 || ch == KEY_ENTER) && S_ISDIR(n->mode)) {
+            if (n->expanded) fm_tree_collapse(&t, sel);
+            else fm_tree_expand(&t, sel);
+        }
+        else if (ch == 10 || ch == KEY_ENTER || ch == 'g' || ch == 'G') {
+            /* A directory is opened itself, anything else is selected in its directory */
+            const fm_tree_node *at = S_ISDIR(n->mode) || !n->parent ? n : n->parent;
+            if (fm_tree_path(at, dir, dirsize) != 0) continue;
+            snprintf(name, namesize, "%s", at == n ? "" : n->name);
+            chosen = 1;
+            break;
+        }
+        else if (ch == 'r' || ch == 'R') {
+            /* Reload the directory at the cursor, or the one holding it */
+            int row = S_ISDIR(n->mode) ? sel : fm_tree_parent_row(&t, sel);
+            if (row >= 0 && fm_tree_reload(&t, row) != 0) {
+                char msg[128];
+                snprintf(msg, sizeof(msg), "✗ Reload failed: %s. Press any key...", strerror(errno));
+                show_status_and_wait(status, msg);
+            }
+        }
+        else if (ch == KEY_RESIZE) {
+            clear();
+        }
+    }
+    fm_tree_free(&t);
+    clear();
+    refresh();
+    return chosen;
+}
+
+static void jump_draw(const fm_jumps *db, const char *query, const int *res, int nres, int sel, int offset) {
+    int h, w;
+    getmaxyx(stdscr, h, w);
+    erase();
+    time_t now = time(NULL);
+    attron(COLOR_PAIR(1) | A_BOLD);
+    mvprintw(0, 0, " Jump: %s_", query);
+    attroff(COLOR_PAIR(1) | A_BOLD);
+    printw("  (%d of %d)", nres, db->count);
+
+    for (int i = 0; i < h - 2 && offset + i < nres; ++i) {
+        const fm_jump_entry *e = &db->items[res[offset + i]];
+        if (offset + i == sel) attron(A_REVERSE);
+        mvprintw(i + 1, 0, " %7.1f ", fm_jump_frecency(e, now));
+        attron(COLOR_PAIR(5));
+        printw("%.*s", w > 11 ? w - 11 : 1, e->path);
+        attroff(COLOR_PAIR(5));
+        if (offset + i == sel) attroff(A_REVERSE);
+    }
+
+    attron(COLOR_PAIR(4));
+    mvprintw(h - 1, 0, " [ESC]Back [type]Filter [Bksp]Erase [UP/DOWN]Move [Enter]Jump [Del]Forget");
+    for (int x = getcurx(stdscr); x < w; x++) addch(' ');
+    attroff(COLOR_PAIR(4));
+}
+
+/* Pick a visited directory by typing part of its path; the result list is re-ranked on
+ * every key, and a key that extends the query only filters the current results. On Enter
+ * the chosen path is stored in dir and 1 is returned */
+static int view_jump(WINDOW *status, fm_jumps *db, char *dir, size_t dirsize) {
+    int *res = malloc((db->count ? db->count : 1) * sizeof(*res));
+    if (!res) { show_status_and_wait(status, "✗ Out of memory. Press any key..."); return 0; }
+    char query[256] = "";
+    size_t qlen = 0;
+    int nres = 0, sel = 0, offset = 0, chosen = 0;
+    int stale = 1, refine = 0;
+    while (1) {
+        if (stale) {
+            int n = fm_jump_match(db, query, time(NULL), refine ? res : NULL, nres, res);
+            nres = n < 0 ? 0 : n;
+            sel = offset = 0;
+            stale = refine = 0;
+        }
+        int page = getmaxy(stdscr) - 2;
+        if (page < 1) page = 1;
+        if (sel < offset) offset = sel;
+        if (sel >= offset + page) offset = sel - page + 1;
+        jump_draw(db, query, res, nres, sel, offset);
+        screen_update(1);
+
+        int ch = getch();
+        if (ch == 27) break;
+        else if (ch == KEY_DOWN && sel + 1 < nres) sel++;
+        else if (ch == KEY_UP && sel > 0) sel--;
+        else if (ch == KEY_NPAGE) sel = sel + page < nres ? sel + page : (nres ? nres - 1 : 0);
+        else if (ch == KEY_PPAGE) sel = sel > page ? sel - page : 0;
+        else if (ch == 10 || ch == KEY_ENTER) {
+            if (nres == 0) continue;
+            snprintf(dir, dirsize, "%s", db->items[res[sel]].path);
+            chosen = 1;
+            break;
+        }
+        else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8) {
+            if (qlen == 0) continue;
+            query[--qlen] = '\0';
+            stale = 1;
+        }
+        else if (ch == 21) {
+            /* Ctrl-U clears the query */
+            qlen = 0;
+            query[0] = '\0';
+            stale = 1;
+        }
+        else if (ch == KEY_DC) {
+            /* Entries move when one is dropped, so rank everything again */
+            if (nres == 0) continue;
+            fm_jump_forget(db, db->items[res[sel]].path);
+            stale = 1;
+        }
+        else if (ch >= 32 && ch < 256 && ch != 127 && qlen + 1 < sizeof(query)) {
+            query[qlen++] = (char)ch;
+            query[qlen] = '\0';
+            stale = refine = 1;
+        }
+        else if (ch == KEY_RESIZE) {
+            clear();
+        }
+    }
+    free(res);
+    clear();
+    refresh();
+    return chosen;
+}
+
+/* Main UI loop */
+int fm_ui_run(const char *startpath) {
+    if (!startpath) startpath = ".";
+
+    initscr();
+    if (!has_colors()) {
+        endwin();
+        fprintf(stderr, "Terminal does not support colors\n");
+        return 1;
+    }
+    start_color();
+    use_default_colors();
+    init_pair(1, COLOR_CYAN, -1);    /* header */
+    init_pair(2, COLOR_YELLOW, -1);  /* column headers */
+    init_pair(3, COLOR_WHITE, -1);   /* selection */
+    init_pair(4, COLOR_BLACK, COLOR_WHITE); /* status/help bar */
+    init_pair(5, COLOR_BLUE, -1);    /* directory */
+    init_pair(6, COLOR_GREEN, -1);   /* regular file */
+    init_pair(7, COLOR_CYAN, -1);    /* symbolic link */
+
+    noecho();
+    curs_set(0);
+
+    /* IMPORTANT: keep stdscr leaveok = FALSE so initial draw causes proper cursor movement/scroll */
+    keypad(stdscr, TRUE);
+    scrollok(stdscr, FALSE);
+    leaveok(stdscr, FALSE);
+
+    int h, w; getmaxyx(stdscr, h, w);
+    WINDOW *header = newwin(1, w, 0, 0);
+    WINDOW *status = newwin(1, w, h - 1, 0);
+
+    /* Both panes share one directory cache, id-name cache and watcher */
+    fm_cache_init();
+    pane panes[2];
+    memset(panes, 0, sizeof(panes));
+    for (int i = 0; i < 2; ++i) {
+        panes[i].win = newwin((h >= 3) ? (h - 2) : 1, w, 1, 0);
+        /* For the child windows, also prefer normal cursor movements (leaveok FALSE) */
+        scrollok(panes[i].win, FALSE); leaveok(panes[i].win, FALSE);
+        fm_sel_init(&panes[i].marks);
+    }
+    int dual = 0, active = 0;
+
+    /* Preview column ('v') fed by the background prefetcher */
+    WINDOW *prevw = newwin(1, 1, 1, 0);
+    int show_preview = 0, preview_dirty = 0;
+    unsigned long prefetch_seq = 0;
+    const fm_dirlist *want_list = NULL;
+    unsigned long want_gen = 0;
+    int want_sel = -1, want_files = 0;
+    fm_prefetch_start();
+
+    /* An existing index serves listings at once and is refreshed in the background */
+    char index_file[PATH_MAX];
+    int have_index_file = fm_index_default_file(index_file, sizeof(index_file), 0) == 0;
+    if (have_index_file) {
+        index_reopen(index_file);
+        if (index_mapped) fm_index_refresh_start(index_file, fm_index_name(&index_map, 0));
+    }
+
+    /* Frecency database of visited directories for the jump list ('j') */
+    char jump_file[PATH_MAX];
+    fm_jumps jumps;
+    char jump_seen[2][PATH_MAX] = { "", "" };
+    if (fm_jump_default_file(jump_file, sizeof(jump_file), 0) != 0 || fm_jump_load(&jumps, jump_file) != 0) {
+        memset(&jumps, 0, sizeof(jumps));
+    }
+
+    /* Performance overlay ('#') and optional per-frame log (FM_PERF_LOG=path) */
+    WINDOW *perfw = newwin(PERF_OVERLAY_H, PERF_OVERLAY_W, 1, w > PERF_OVERLAY_W ? w - PERF_OVERLAY_W : 0);
+    int show_perf = 0;
+    fm_perf perf_last;
+    memset(&perf_last, 0, sizeof(perf_last));
+    char op[32] = "start", perf_op[32] = "";
+    const char *perf_log = getenv("FM_PERF_LOG");
+    int perf_logging = perf_log && *perf_log && fm_perf_open_log(perf_log) == 0;
+
+    scrollok(header, FALSE); leaveok(header, FALSE);
+    scrollok(status, FALSE); leaveok(status, FALSE);
+
+    /* Draw initial blank screen so user sees app immediately */
+    clear();
+    refresh();
+
+    if (pane_chdir(&panes[0], startpath) != 0) {
+        char errbuf[256];
+        snprintf(errbuf, sizeof(errbuf), "Error reading directory: %s", strerror(errno));
+        show_status(status, errbuf);
+        doupdate();
+        wgetch(stdscr);
+        goto cleanup;
+    }
+
+    while (1) {
+        /* Background reads that landed: replace listings seeded from the index, redraw the preview */
+        if (fm_prefetch_seq() != prefetch_seq) {
+            prefetch_seq = fm_prefetch_seq();
+            for (int i = 0; i < 2; ++i) {
+                fm_entry *pre;
+                int pre_count;
+                struct timespec pre_mtime;
+                pane *q = &panes[i];
+                if (q->list && q->list->provisional &&
+                    fm_prefetch_take_dir(q->cwd, &pre, &pre_count, &pre_mtime) == 0) {
+                    fm_dircache_adopt(q->cwd, pre, pre_count, &pre_mtime);
+                }
+            }
+            preview_dirty = 1;
+        }
+        if (fm_index_refresh_poll() == 1) index_reopen(index_file);
+        /* A sync left running by the compare view has finished */
+        fm_sync_stats sync_done;
+        if (fm_sync_poll(&sync_done) == 1) {
+            sync_report(status, &sync_done);
+            fm_dircache_invalidate(panes[active].cwd);
+            if (dual) fm_dircache_invalidate(panes[!active].cwd);
+            panes[0].dirty = panes[1].dirty = 1;
+        }
+
+        /* Apply watcher events; a changed directory is rescanned once for both panes */
+        fm_cache_poll();
+        for (int i = 0; i < 2; ++i) {
+            if (panes[i].list && (dual || i == active)) pane_sync(&panes[i]);
+        }
+
+        /* A pane that settled in a new directory counts as a visit */
+        for (int i = 0; i < 2; ++i) {
+            pane *q = &panes[i];
+            if (q->list && !q->arc && strcmp(q->cwd, jump_seen[i]) != 0) {
+                snprintf(jump_seen[i], sizeof(jump_seen[i]), "%s", q->cwd);
+                fm_jump_visit(&jumps, q->cwd, time(NULL));
+            }
+        }
+
+        pane *p = &panes[active];
+        const fm_entry *items = p->list->entries;
+        int count = p->list->count;
+        pane *other = dual ? &panes[!active] : NULL;
+        int preview_on = show_preview && !dual;
+
+        /* Re-request only when the highlighted entry changed, so idle ticks don't extend the debounce */
+        if (p->list != want_list || p->list->gen != want_gen || p->sel != want_sel || preview_on != want_files) {
+            pane_prefetch(p, preview_on);
+            want_list = p->list;
+            want_gen = p->list->gen;
+            want_sel = p->sel;
+            want_files = preview_on;
+            preview_dirty = 1;
+        }
+
+        /* Draw UI using wnoutrefresh then doupdate for flicker-free update;
+         * a pane is only re-rendered when its own state or listing changed */
+        draw_header(header, p->cwd, count, p->marks.count);
+        int drawn = 0;
+        for (int i = 0; i < 2; ++i) {
+            pane *q = &panes[i];
+            if (!q->dirty || !(dual || i == active)) continue;
+            draw_list(q->win, q->list->entries, q->list->count, q->sel, q->offset, &q->marks,
+                      !dual || i == active);
+            q->dirty = 0;
+            drawn++;
+        }
+        if (preview_on && (preview_dirty || drawn)) {
+            draw_preview(prevw, count > 0 && !p->arc ? &items[p->sel] : NULL);
+            preview_dirty = 0;
+        }
+        draw_help_bar(status);
+        if (show_perf) draw_perf_overlay(perfw, &perf_last, perf_op);
+        screen_update(0);
+
+        /* A frame is one key's work plus its redraw; idle ticks only count when they repainted */
+        if (fm_perf_enabled && (op[0] || drawn)) {
+            snprintf(perf_op, sizeof(perf_op), "%s", op[0] ? op : "watch");
+            fm_perf_end_frame(perf_op, &perf_last);
+        }
+        op[0] = '\0';
+
+        /* Wake up periodically so changes made by other processes show up */
+        wtimeout(stdscr, fm_prefetch_busy() ? 20 : 500);
+        int ch = wgetch(stdscr);
+        wtimeout(stdscr, -1);
+        if (ch == ERR) continue;
+
+        /* Every remaining key acts on the active pane */
+        p->dirty = 1;
+        snprintf(op, sizeof(op), "%s", ch == ' ' ? "SPACE" : keyname(ch) ? keyname(ch) : "?");
+
+        if (ch == 'q' || ch == 'Q') break;
+        else if (p->arc && ch > 0 && ch < 128 && strchr("nNfFdDrRmMcCpPeEhHkKuUsStT", ch)) {
+            show_status_and_wait(status, "✗ Archives are browsed read-only. Press any key...");
+        }
+        else if (ch == KEY_DOWN) {
+            if (p->sel + 1 < count) p->sel++;
+            /* if selection would fall off visible area, advance offset */
+            pane_follow(p);
+        }
+        else if (ch == KEY_UP) {
+            if (p->sel > 0) p->sel--;
+            pane_follow(p);
+        }
+        else if (ch == '\t') {
+            if (!dual) continue;
+            active = !active;
+            panes[0].dirty = panes[1].dirty = 1;
+        }
+        else if (ch == '#') {
+            show_perf = !show_perf;
+            /* Counting runs while the overlay is shown or a log is open */
+            fm_perf_enabled = show_perf || perf_logging;
+            if (!show_perf) {
+                panes[0].dirty = panes[1].dirty = 1;
+                touchwin(stdscr);
+                wnoutrefresh(stdscr);
+            }
+        }
+        else if (ch == 'v' || ch == 'V') {
+            show_preview = !show_preview;
+            resize_windows(header, panes, dual, active, show_preview && !dual ? prevw : NULL, status);
+        }
+        else if (ch == 'w' || ch == 'W') {
+            dual = !dual;
+            if (dual && !panes[!active].list) {
+                /* The new pane starts in the same directory, served from the shared cache */
+                if (pane_chdir(&panes[!active], p->cwd) != 0) {
+                    dual = 0;
+                    show_status_and_wait(status, "✗ Cannot open second pane. Press any key...");
+                    continue;
+                }
+            }
+            resize_windows(header, panes, dual, active, show_preview && !dual ? prevw : NULL, status);
+        }
+        else if (ch == 10 || ch == KEY_ENTER) {
+            if (count == 0) continue;
+            const fm_entry *e = &items[p->sel];
+            /* A tar archive opens as a read-only directory of its members */
+            int archive = S_ISREG(e->st.st_mode) && fm_tar_is_archive(e->name);
+            if (e->is_dir || archive) {
+                if (pane_chdir(p, e->path) != 0) {
+                    char errbuf[256];
+                    snprintf(errbuf, sizeof(errbuf), "✗ Error reading %s: %s. Press any key...",
+                             archive ? "archive" : "directory", strerror(errno));
+                    show_status_and_wait(status, errbuf);
+                }
+            } else {
+                char buf[512];
+                char perms[12], size_str[16];
+                format_perms(e->st.st_mode, perms);
+                format_size(e->st.st_size, size_str, sizeof(size_str));
+                struct tm tm_buf;
+                struct tm *tm = localtime_r(&e->st.st_mtime, &tm_buf);
+                snprintf(buf, sizeof(buf), "%s | %s | %s:%s | %04d-%02d-%02d %02d:%02d | Inode: %llu | Press any key...",
+                         perms, size_str,
+                         fm_user_name(e->st.st_uid), fm_group_name(e->st.st_gid),
+                         tm ? (tm->tm_year+1900) : 0, tm ? (tm->tm_mon+1) : 0, tm ? tm->tm_mday : 0,
+                         tm ? tm->tm_hour : 0, tm ? tm->tm_min : 0,
+                         (unsigned long long)e->st.st_ino);
+                show_status(status, buf);
+                doupdate();
+                wgetch(stdscr);
+            }
+        }
+        else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8) {
+            /* go up one directory */
+            char parent[PATH_MAX];
+            strcpy(parent, p->cwd);
+            char *slash = strrchr(parent, '/');
+            if (slash && slash != parent) *slash = '\0';
+            else strcpy(parent, "/");
+            if (pane_chdir(p, parent) != 0) {
+                show_status_and_wait(status, "✗ Cannot read parent directory. Press any key...");
+            }
+        }
+        else if (ch == 'n' || ch == 'N') {
+            char name[PATH_MAX];
+            if (prompt_input(status, "New directory name:", name, sizeof(name)) == 0 && strlen(name) > 0) {
                 char path[PATH_MAX * 2];
-                if (build_path(path, sizeof(path), cwd, name) == -1) {
+                if (build_path(path, sizeof(path), p->cwd, name) == -1) {
                     show_status_and_wait(status, "✗ Path too long. Press any key...");
                 } else if (fm_mkdir(path) == 0) {
                     show_status_and_wait(status, "✓ Directory created successfully. Press any key...");
@@ -577,7 +2226,7 @@ int fm_ui_run(const char *startpath) {
             char name[PATH_MAX];
             if (prompt_input(status, "New file name:", name, sizeof(name)) == 0 && strlen(name) > 0) {
                 char path[PATH_MAX * 2];
-                if (build_path(path, sizeof(path), cwd, name) == -1) {
+                if (build_path(path, sizeof(path), p->cwd, name) == -1) {
                     show_status_and_wait(status, "✗ Path too long. Press any key...");
                 } else if (fm_create_file(path) == 0) {
                     show_status_and_wait(status, "✓ File created successfully. Press any key...");
@@ -586,9 +2235,74 @@ int fm_ui_run(const char *startpath) {
                 }
             }
         }
+        else if (ch == ' ') {
+            if (count == 0) continue;
+            fm_sel_toggle(&p->marks, items, p->sel);
+            /* Advance so holding Space marks a run of entries */
+            if (p->sel + 1 < count) p->sel++;
+            pane_follow(p);
+        }
+        else if (ch == 'a' || ch == 'A') {
+            if (count == 0) continue;
+            fm_sel_range(&p->marks, items, p->sel);
+        }
+        else if (ch == '*') {
+            fm_sel_invert(&p->marks, items);
+        }
+        else if (ch == '-') {
+            fm_sel_clear(&p->marks);
+        }
+        else if (ch == '+') {
+            char pattern[256];
+            if (prompt_input(status, "Mark names matching (glob):", pattern, sizeof(pattern)) == 0 && strlen(pattern) > 0) {
+                char msg[128];
+                snprintf(msg, sizeof(msg), "Marked %d new items (%d total). Press any key...",
+                         fm_sel_match(&p->marks, items, pattern), p->marks.count);
+                show_status_and_wait(status, msg);
+            }
+        }
+        else if ((ch == 'd' || ch == 'D') && p->marks.count > 0) {
+            batch_marked(status, FM_BATCH_DELETE, p->cwd, items, &p->marks, NULL);
+        }
+        else if ((ch == 'm' || ch == 'M') && p->marks.count > 0) {
+            batch_marked(status, FM_BATCH_MOVE, p->cwd, items, &p->marks, other ? other->cwd : NULL);
+        }
+        else if ((ch == 'c' || ch == 'C') && p->marks.count > 0) {
+            batch_marked(status, FM_BATCH_COPY, p->cwd, items, &p->marks, other ? other->cwd : NULL);
+        }
+        else if (ch == 'p' || ch == 'P') {
+            if (count == 0) continue;
+            char input[16];
+            if (prompt_input(status, "New mode (octal, e.g. 644):", input, sizeof(input)) != 0 || strlen(input) == 0) {
+                continue;
+            }
+            char *end;
+            long mode = strtol(input, &end, 8);
+            if (*end != '\0' || mode < 0 || mode > 07777) {
+                show_status_and_wait(status, "✗ Invalid mode. Press any key...");
+                continue;
+            }
+            /* Without marks, chmod applies to the highlighted entry alone */
+            const fm_entry **set = NULL;
+            int n;
+            if (p->marks.count > 0) {
+                n = collect_marked(&p->marks, items, &set);
+            } else {
+                set = malloc(sizeof(*set));
+                n = set ? 1 : -1;
+                if (set) set[0] = &items[p->sel];
+            }
+            if (n < 0) {
+                show_status_and_wait(status, "✗ Out of memory. Press any key...");
+                continue;
+            }
+            run_batch(status, FM_BATCH_CHMOD, p->cwd, NULL, (mode_t)mode, set, n);
+            free(set);
+            fm_sel_clear(&p->marks);
+        }
         else if (ch == 'd' || ch == 'D') {
             if (count == 0) continue;
-            fm_entry *e = &items[sel];
+            const fm_entry *e = &items[p->sel];
             char q[1024];
             snprintf(q, sizeof(q), "Delete '%s'? [y/n]", e->name);
             show_status(status, q);
@@ -597,7 +2311,7 @@ int fm_ui_run(const char *startpath) {
             if (c == 'y' || c == 'Y') {
                 if (fm_remove(e->path) == 0) {
                     show_status_and_wait(status, "✓ Deleted successfully. Press any key...");
-                    if (sel >= count - 1 && sel > 0) sel--;
+                    if (p->sel >= count - 1 && p->sel > 0) p->sel--;
                 } else {
                     show_status_and_wait(status, "✗ Delete failed (may be non-empty dir). Press any key...");
                 }
@@ -605,11 +2319,11 @@ int fm_ui_run(const char *startpath) {
         }
         else if (ch == 'r' || ch == 'R') {
             if (count == 0) continue;
-            fm_entry *e = &items[sel];
+            const fm_entry *e = &items[p->sel];
             char name[PATH_MAX];
             if (prompt_input(status, "Rename to:", name, sizeof(name)) == 0 && strlen(name) > 0) {
                 char path[PATH_MAX * 2];
-                if (build_path(path, sizeof(path), cwd, name) == -1) {
+                if (build_path(path, sizeof(path), p->cwd, name) == -1) {
                     show_status_and_wait(status, "✗ Path too long. Press any key...");
                 } else if (fm_rename(e->path, path) == 0) {
                     show_status_and_wait(status, "✓ Renamed successfully. Press any key...");
@@ -620,31 +2334,27 @@ int fm_ui_run(const char *startpath) {
         }
         else if (ch == 'm' || ch == 'M') {
             if (count == 0) continue;
-            fm_entry *e = &items[sel];
+            const fm_entry *e = &items[p->sel];
             char destdir[PATH_MAX];
-            if (prompt_input(status, "Move to directory (path):", destdir, sizeof(destdir)) != 0 || strlen(destdir) == 0) {
+            const char *q = other ? "Move to directory (path, Enter: other pane):" : "Move to directory (path):";
+            if (prompt_input(status, q, destdir, sizeof(destdir)) != 0) {
                 continue;
             }
+            if (strlen(destdir) == 0) {
+                /* In dual-pane mode the default target is the other pane */
+                if (!other) continue;
+                snprintf(destdir, sizeof(destdir), "%s", other->cwd);
+            }
             
             char resolved[PATH_MAX * 2];
             char dest_path[PATH_MAX * 2];
             
-            /* Resolve destination directory path */
-            if (destdir[0] == '/') {
-                /* Absolute path */
-                strncpy(resolved, destdir, sizeof(resolved) - 1);
-                resolved[sizeof(resolved) - 1] = '\0';
-            } else {
-                /* Relative path */
-                if (build_path(resolved, sizeof(resolved), cwd, destdir) == -1) {
-                    show_status_and_wait(status, "✗ Path too long. Press any key...");
-                    continue;
-                }
-            }
-            
-            /* Check if destination directory exists */
-            struct stat st;
-            if (stat(resolved, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            /* Resolve destination directory path and check it exists */
+            int rc = resolve_dir(resolved, sizeof(resolved), p->cwd, destdir);
+            if (rc == -1) {
+                show_status_and_wait(status, "✗ Path too long. Press any key...");
+                continue;
+            } else if (rc == -2) {
                 show_status_and_wait(status, "✗ Destination directory does not exist. Press any key...");
                 continue;
             }
@@ -657,21 +2367,25 @@ int fm_ui_run(const char *startpath) {
             
             if (fm_rename(e->path, dest_path) == 0) {
                 show_status_and_wait(status, "✓ Moved successfully. Press any key...");
-                if (sel > 0) sel--;
+                if (p->sel > 0) p->sel--;
             } else {
                 show_status_and_wait(status, "✗ Move failed (destination may already exist). Press any key...");
             }
         }
         else if (ch == 'c' || ch == 'C') {
             if (count == 0) continue;
-            fm_entry *e = &items[sel];
+            const fm_entry *e = &items[p->sel];
             if (e->is_dir) {
                 show_status_and_wait(status, "✗ Copy directory not supported. Press any key...");
             } else {
                 char name[PATH_MAX];
-                if (prompt_input(status, "Copy to (name):", name, sizeof(name)) == 0 && strlen(name) > 0) {
+                const char *q = other ? "Copy to (name, Enter: other pane):" : "Copy to (name):";
+                if (prompt_input(status, q, name, sizeof(name)) == 0 && (strlen(name) > 0 || other)) {
                     char path[PATH_MAX * 2];
-                    if (build_path(path, sizeof(path), cwd, name) == -1) {
+                    /* An empty name copies under the same name into the other pane */
+                    int rc = strlen(name) > 0 ? build_path(path, sizeof(path), p->cwd, name)
+                                              : build_path(path, sizeof(path), other->cwd, e->name);
+                    if (rc == -1) {
                         show_status_and_wait(status, "✗ Path too long. Press any key...");
                     } else if (fm_copy_file(e->path, path) == 0) {
                         show_status_and_wait(status, "✓ File copied successfully. Press any key...");
@@ -683,33 +2397,34 @@ int fm_ui_run(const char *startpath) {
         }
         else if (ch == 'i' || ch == 'I') {
             if (count == 0) continue;
-            fm_entry *e = &items[sel];
-            view_file_info(e);
+            view_file_info(&items[p->sel]);
             /* Force complete redraw */
             clearok(stdscr, TRUE);
             clear();
             refresh();
+            panes[0].dirty = panes[1].dirty = 1;
         }
         else if (ch == 'o' || ch == 'O') {
             if (count == 0) continue;
-            fm_entry *e = &items[sel];
+            const fm_entry *e = &items[p->sel];
             if (e->is_dir) {
                 show_status(status, "Cannot open directory. Press any key...");
                 doupdate();
                 wgetch(stdscr);
                 continue;
             }
-            /* View file with custom file viewer */
-            view_file_content(e->path);
+            /* View file with custom file viewer; gzip is decompressed on the fly */
+            if (!p->arc && fm_gz_is_gzip(e->path)) view_gzip(e->path);
+            else view_file_content(e->path, p->arc);
             /* Force complete redraw */
             clearok(stdscr, TRUE);
             clear();
             refresh();
-            /* redraw next loop iteration will draw everything */
+            panes[0].dirty = panes[1].dirty = 1;
         }
         else if (ch == 'e' || ch == 'E') {
             if (count == 0) continue;
-            fm_entry *e = &items[sel];
+            const fm_entry *e = &items[p->sel];
             if (e->is_dir) {
                 show_status(status, "✗ Cannot edit directory. Press any key...");
                 doupdate();
@@ -725,6 +2440,9 @@ int fm_ui_run(const char *startpath) {
             clearok(stdscr, TRUE);
             clear();
             refresh();
+            panes[0].dirty = panes[1].dirty = 1;
+            /* Size/mtime changes are not visible in the directory mtime */
+            fm_dircache_invalidate(p->cwd);
             
             if (result == -2) {
                 show_status(status, "✗ Can only edit regular files. Press any key...");
@@ -741,25 +2459,146 @@ int fm_ui_run(const char *startpath) {
             }
             /* File list will be refreshed in next loop iteration */
         }
+        else if (ch == 'h' || ch == 'H') {
+            if (count == 0) continue;
+            checksum_entries(status, p->cwd, items, p->sel, &p->marks);
+            clearok(stdscr, TRUE);
+            panes[0].dirty = panes[1].dirty = 1;
+        }
+        else if (ch == 'k' || ch == 'K') {
+            if (count == 0 || items[p->sel].is_dir) continue;
+            verify_manifest(status, items[p->sel].path);
+            clearok(stdscr, TRUE);
+            panes[0].dirty = panes[1].dirty = 1;
+        }
+        else if (ch == 'u' || ch == 'U') {
+            view_dupes(status, p->cwd);
+            /* Deleted or relinked copies may live in a listed directory */
+            fm_dircache_invalidate(p->cwd);
+            if (other) fm_dircache_invalidate(other->cwd);
+            clearok(stdscr, TRUE);
+            panes[0].dirty = panes[1].dirty = 1;
+        }
+        else if (ch == 's' || ch == 'S') {
+            char target[PATH_MAX], resolved[PATH_MAX * 2];
+            const char *q = other ? "Compare with directory (path, Enter: other pane):" : "Compare with directory (path):";
+            if (prompt_input(status, q, target, sizeof(target)) != 0) continue;
+            if (strlen(target) == 0) {
+                if (!other) continue;
+                snprintf(target, sizeof(target), "%s", other->cwd);
+            }
+            int rc = resolve_dir(resolved, sizeof(resolved), p->cwd, target);
+            if (rc == -1) {
+                show_status_and_wait(status, "✗ Path too long. Press any key...");
+                continue;
+            } else if (rc == -2) {
+                show_status_and_wait(status, "✗ Directory does not exist. Press any key...");
+                continue;
+            }
+            char canon[PATH_MAX];
+            view_compare(status, p->cwd, realpath(resolved, canon) ? canon : resolved);
+            fm_dircache_invalidate(p->cwd);
+            if (other) fm_dircache_invalidate(other->cwd);
+            clearok(stdscr, TRUE);
+            panes[0].dirty = panes[1].dirty = 1;
+        }
+        else if (ch == 'j' || ch == 'J') {
+            char dir[PATH_MAX];
+            int chosen = view_jump(status, &jumps, dir, sizeof(dir));
+            clearok(stdscr, TRUE);
+            panes[0].dirty = panes[1].dirty = 1;
+            if (!chosen) continue;
+            /* Only the target directory is read */
+            if (pane_chdir(p, dir) != 0) {
+                /* Only a directory that is gone is dropped; permissions or an unmounted
+                 * volume may come back */
+                if (errno == ENOENT || errno == ENOTDIR) {
+                    fm_jump_forget(&jumps, dir);
+                    show_status_and_wait(status, "✗ Directory no longer exists; removed from the jump list. Press any key...");
+                } else {
+                    char msg[PATH_MAX + 64];
+                    snprintf(msg, sizeof(msg), "✗ Cannot open %s: %s. Press any key...", dir, strerror(errno));
+                    show_status_and_wait(status, msg);
+                }
+            }
+        }
+        else if (ch == 't' || ch == 'T') {
+            char dir[PATH_MAX], name[NAME_MAX + 1];
+            int chosen = view_tree(status, p->cwd, dir, sizeof(dir), name, sizeof(name));
+            clearok(stdscr, TRUE);
+            panes[0].dirty = panes[1].dirty = 1;
+            if (!chosen) continue;
+            if (pane_chdir(p, dir) != 0) {
+                show_status_and_wait(status, "✗ Directory no longer exists. Press any key...");
+                continue;
+            }
+            for (int i = 0; name[0] && i < p->list->count; ++i) {
+                if (strcmp(p->list->entries[i].name, name) == 0) { p->sel = i; break; }
+            }
+            pane_follow(p);
+        }
+        else if (ch == 'g' || ch == 'G') {
+            if (!index_mapped) {
+                char q[PATH_MAX + 64];
+                snprintf(q, sizeof(q), "No index yet. Index %s in the background? [y/n]", p->cwd);
+                show_status(status, q);
+                doupdate();
+                int c = wgetch(stdscr);
+                if (c != 'y' && c != 'Y') continue;
+                if (!have_index_file) {
+                    have_index_file = fm_index_default_file(index_file, sizeof(index_file), 1) == 0;
+                }
+                if (have_index_file && fm_index_refresh_start(index_file, p->cwd) == 0) {
+                    show_status_and_wait(status, "✓ Indexing started; search with [g] once it is done. Press any key...");
+                } else {
+                    show_status_and_wait(status, "✗ Cannot create the index file. Press any key...");
+                }
+                continue;
+            }
+            char dir[PATH_MAX], name[NAME_MAX + 1];
+            int chosen = view_search(status, dir, sizeof(dir), name, sizeof(name));
+            clearok(stdscr, TRUE);
+            panes[0].dirty = panes[1].dirty = 1;
+            if (!chosen) continue;
+            if (pane_chdir(p, dir) != 0) {
+                show_status_and_wait(status, "✗ Directory no longer exists. Press any key...");
+                continue;
+            }
+            for (int i = 0; i < p->list->count; ++i) {
+                if (strcmp(p->list->entries[i].name, name) == 0) { p->sel = i; break; }
+            }
+            pane_follow(p);
+        }
         else if (ch == KEY_RESIZE) {
             /* Recreate/resize windows to match new terminal size */
-            resize_windows(&header, &listw, &status);
+            resize_windows(header, panes, dual, active, show_preview && !dual ? prevw : NULL, status);
+            int nw = getmaxx(stdscr);
+            mvwin(perfw, 1, nw > PERF_OVERLAY_W ? nw - PERF_OVERLAY_W : 0);
             /* Ensure wnoutrefresh/doupdate following next draw */
         }
-
-        /* keep offset in valid range */
-        if (offset > count - 1) offset = count > 0 ? count - 1 : 0;
-        if (offset < 0) offset = 0;
-
-        free(items);
-        items = NULL;
     }
 
-    /* cleanup */
-    if (items) free(items);
+cleanup:
+    for (int i = 0; i < 2; ++i) {
+        pane_release_list(&panes[i]);
+        fm_tar_release(panes[i].arc);
+        fm_sel_free(&panes[i].marks);
+        delwin(panes[i].win);
+    }
+    fm_prefetch_stop();
+    fm_index_refresh_stop();
+    fm_sync_stop();
+    fm_tar_shutdown();
+    if (jumps.dirty && fm_jump_default_file(jump_file, sizeof(jump_file), 1) == 0) fm_jump_save(&jumps, jump_file);
+    fm_jump_free(&jumps);
+    if (index_mapped) fm_index_close(&index_map);
+    index_mapped = 0;
+    fm_cache_shutdown();
+    fm_perf_close_log();
+    delwin(prevw);
+    delwin(perfw);
     delwin(header);
-    delwin(listw);
     delwin(status);
     endwin();
     return 0;
-}
\ No newline at end of file
+}
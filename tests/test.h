@@ -0,0 +1,32 @@
+#ifndef FM_TEST_H
+#define FM_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Minimal checks for the unit tests: a failed CHECK prints its location and the test
+// program exits non-zero at the end of main via TEST_DONE
+
+static int test_failures, test_checks;
+
+#define CHECK(cond) do { \
+    test_checks++; \
+    if (!(cond)) { \
+        test_failures++; \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+} while (0)
+
+#define TEST_DONE(name) do { \
+    printf("%-8s %d checks, %d failed\n", name, test_checks, test_failures); \
+    return test_failures ? 1 : 0; \
+} while (0)
+
+// Scratch directory for tests that need files; removed by the caller with rm -r
+static inline const char *test_tmpdir(char *buf, size_t size, const char *name) {
+    const char *base = getenv("TMPDIR");
+    snprintf(buf, size, "%s/fm_test_%s_XXXXXX", base && *base ? base : "/tmp", name);
+    return mkdtemp(buf);
+}
+
+#endif // FM_TEST_H
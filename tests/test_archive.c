@@ -0,0 +1,187 @@
+#define _XOPEN_SOURCE 700
+#include "archive.h"
+#include "fs.h"
+#include "test.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* A tar image built in memory, one 512-byte block at a time */
+typedef struct tarbuf {
+    unsigned char data[64 * 512];
+    size_t len;
+} tarbuf;
+
+/* Append a ustar header; size_field, when set, is copied raw into the size field */
+static unsigned char *add_header(tarbuf *b, const char *name, char type, long long size,
+                                 const unsigned char *size_field, const char *link) {
+    unsigned char *h = b->data + b->len;
+    memset(h, 0, 512);
+    snprintf((char *)h, 100, "%s", name);
+    snprintf((char *)h + 100, 8, "%07o", type == '5' ? 0755 : 0644);
+    snprintf((char *)h + 108, 8, "%07o", 1000);
+    snprintf((char *)h + 116, 8, "%07o", 100);
+    if (size_field) memcpy(h + 124, size_field, 12);
+    else snprintf((char *)h + 124, 12, "%011llo", size);
+    snprintf((char *)h + 136, 12, "%011o", 1700000000);
+    h[156] = type;
+    if (link) snprintf((char *)h + 157, 100, "%s", link);
+    memcpy(h + 257, "ustar\0" "00", 8);
+    memset(h + 148, ' ', 8);
+    unsigned sum = 0;
+    for (int i = 0; i < 512; ++i) sum += h[i];
+    snprintf((char *)h + 148, 8, "%06o", sum);
+    b->len += 512;
+    return h;
+}
+
+static void add_data(tarbuf *b, const void *data, size_t len) {
+    memcpy(b->data + b->len, data, len);
+    b->len += (len + 511) / 512 * 512;
+}
+
+static void add_end(tarbuf *b) {
+    b->len += 1024;
+}
+
+static int write_tar(const char *dir, const char *name, const tarbuf *b, char *path, size_t size) {
+    snprintf(path, size, "%s/%s", dir, name);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    ssize_t w = write(fd, b->data, b->len);
+    close(fd);
+    return w == (ssize_t)b->len ? 0 : -1;
+}
+
+static int list_has(const fm_entry *e, int n, const char *name) {
+    for (int i = 0; i < n; ++i) {
+        if (strcmp(e[i].name, name) == 0) return 1;
+    }
+    return 0;
+}
+
+static void test_members(const char *dir) {
+    static tarbuf b;
+    char text[600];
+    for (size_t i = 0; i < sizeof(text); ++i) text[i] = 'a' + i % 26;
+    add_header(&b, "./dir/", '5', 0, NULL, NULL);
+    add_header(&b, "dir/a.txt", '0', 6, NULL, NULL);
+    add_data(&b, "hello\n", 6);
+    add_header(&b, "b.txt", '0', sizeof(text), NULL, NULL);
+    add_data(&b, text, sizeof(text));
+    add_header(&b, "dir/link", '1', 0, NULL, "dir/a.txt");
+    /* A base-256 size field, as GNU tar writes for members over 8 GiB */
+    unsigned char big[12] = { 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 0x00 };
+    add_header(&b, "sub/deep/c.bin", '0', 0, big, NULL);
+    char zeros[512] = { 0 };
+    add_data(&b, zeros, sizeof(zeros));
+    add_end(&b);
+
+    char path[PATH_MAX];
+    CHECK(write_tar(dir, "ok.tar", &b, path, sizeof(path)) == 0);
+    CHECK(fm_tar_is_archive(path) && !fm_tar_is_archive("ok.tgz"));
+    fm_tar *t = fm_tar_get(path);
+    CHECK(t != NULL);
+    if (!t) return;
+    CHECK(t->count == 5);
+
+    int a = fm_tar_find(t, "dir/a.txt");
+    int d = fm_tar_find(t, "dir");
+    int l = fm_tar_find(t, "dir/link");
+    int c = fm_tar_find(t, "sub/deep/c.bin");
+    CHECK(a >= 0 && d >= 0 && l >= 0 && c >= 0 && fm_tar_find(t, "sub") < 0);
+    if (a >= 0) {
+        CHECK(S_ISREG(t->members[a].st.st_mode) && (t->members[a].st.st_mode & 07777) == 0644);
+        CHECK(t->members[a].st.st_size == 6 && t->members[a].st.st_uid == 1000);
+        CHECK(t->members[a].st.st_gid == 100 && t->members[a].st.st_mtim.tv_sec == 1700000000);
+    }
+    if (d >= 0) CHECK(S_ISDIR(t->members[d].st.st_mode));
+    if (l >= 0) CHECK(t->members[l].hardlink && t->members[l].st.st_size == 6);
+    if (c >= 0) CHECK(t->members[c].st.st_size == 512);
+
+    char *content = NULL;
+    int bi = fm_tar_find(t, "b.txt");
+    CHECK(bi >= 0 && fm_tar_read(t, bi, 4096, &content) == (ssize_t)sizeof(text));
+    CHECK(content && memcmp(content, text, sizeof(text)) == 0 && content[sizeof(text)] == '\0');
+    free(content);
+    content = NULL;
+    CHECK(fm_tar_read(t, bi, 10, &content) == 10);
+    free(content);
+
+    /* Directories without their own header are still listed */
+    fm_entry *e = NULL;
+    int n = fm_tar_list(t, "", &e);
+    CHECK(n == 4 && strcmp(e[0].name, "..") == 0 && strcmp(e[0].path, dir) == 0);
+    CHECK(list_has(e, n, "dir") && list_has(e, n, "b.txt") && list_has(e, n, "sub"));
+    free(e);
+    n = fm_tar_list(t, "dir", &e);
+    CHECK(n == 3 && list_has(e, n, "a.txt") && list_has(e, n, "link"));
+    free(e);
+    n = fm_tar_list(t, "sub", &e);
+    CHECK(n == 2 && list_has(e, n, "deep") && e[1].is_dir);
+    free(e);
+    errno = 0;
+    CHECK(fm_tar_list(t, "b.txt", &e) == -1 && errno == ENOTDIR);
+    CHECK(fm_tar_list(t, "nope", &e) == -1 && errno == ENOENT);
+
+    /* The same archive version is shared */
+    fm_tar *again = fm_tar_get(path);
+    CHECK(again == t && t->refs == 2);
+    fm_tar_release(again);
+    fm_tar_release(t);
+}
+
+/* Size fields that do not decode to a sane offset */
+static void test_bad_sizes(const char *dir) {
+    static const unsigned char fields[][12] = {
+        /* base-256 magnitude past LLONG_MAX */
+        { 0x80, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+        /* negative base-256 */
+        { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 },
+        /* fits, but runs past the end of the archive */
+        { 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x00, 0x00 },
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        static tarbuf b;
+        char name[32], path[PATH_MAX];
+        b.len = 0;
+        add_header(&b, "x", '0', 0, fields[i], NULL);
+        add_end(&b);
+        snprintf(name, sizeof(name), "bad%zu.tar", i);
+        CHECK(write_tar(dir, name, &b, path, sizeof(path)) == 0);
+        errno = 0;
+        CHECK(fm_tar_get(path) == NULL && errno == EINVAL);
+
+        /* After a good member, the bad header just ends the listing */
+        b.len = 0;
+        add_header(&b, "first", '0', 3, NULL, NULL);
+        add_data(&b, "abc", 3);
+        add_header(&b, "x", '0', 0, fields[i], NULL);
+        add_end(&b);
+        snprintf(name, sizeof(name), "tail%zu.tar", i);
+        CHECK(write_tar(dir, name, &b, path, sizeof(path)) == 0);
+        fm_tar *t = fm_tar_get(path);
+        CHECK(t && t->count == 1 && fm_tar_find(t, "first") == 0);
+        if (t) fm_tar_release(t);
+    }
+
+    /* Not a tar at all */
+    static tarbuf junk;
+    char path[PATH_MAX];
+    memset(junk.data, 'j', 1024);
+    junk.len = 1024;
+    CHECK(write_tar(dir, "junk.tar", &junk, path, sizeof(path)) == 0);
+    errno = 0;
+    CHECK(fm_tar_get(path) == NULL && errno == EINVAL);
+}
+
+int main(void) {
+    char dir[PATH_MAX];
+    if (!test_tmpdir(dir, sizeof(dir), "archive")) { perror("mkdtemp"); return 1; }
+    test_members(dir);
+    test_bad_sizes(dir);
+    fm_tar_shutdown();
+    fm_remove_tree(dir, NULL, NULL);
+    TEST_DONE("archive");
+}
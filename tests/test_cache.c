@@ -0,0 +1,65 @@
+#define _XOPEN_SOURCE 700
+#include "cache.h"
+#include "test.h"
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static void touch(const char *dir, const char *name) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    close(open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+}
+
+/* Changes are picked up once the watcher or the mtime fallback reports them */
+static int poll_stale(const fm_dirlist *l) {
+    struct timespec tick = { 0, 10000000 };
+    for (int i = 0; i < 100 && !l->stale; ++i) {
+        fm_cache_poll();
+        if (!l->stale) nanosleep(&tick, NULL);
+    }
+    return l->stale;
+}
+
+static void test_shared(const char *dir) {
+    char real[PATH_MAX], link[PATH_MAX];
+    snprintf(real, sizeof(real), "%s/real", dir);
+    snprintf(link, sizeof(link), "%s/link", dir);
+    CHECK(mkdir(real, 0755) == 0 && symlink("real", link) == 0);
+
+    fm_dirlist *a = fm_dircache_get(real);
+    fm_dirlist *b = fm_dircache_get(link);
+    CHECK(a && b && a != b && a->count == 1 && fm_dircache_get(real) == a && a->refs == 2);
+    fm_dircache_release(a);
+
+    touch(real, "one");
+    CHECK(poll_stale(a) && poll_stale(b));
+    CHECK(fm_dircache_revalidate(a) == 0 && a->count == 2 && !a->stale);
+    CHECK(fm_dircache_revalidate(b) == 0 && b->count == 2);
+
+    /* Dropping the listing under the other path keeps this one watched */
+    fm_dircache_invalidate(link);
+    fm_dircache_release(b);
+    CHECK(!fm_dircache_contains(link) && fm_dircache_contains(real));
+    struct timespec settle = { 0, 50000000 };
+    nanosleep(&settle, NULL);
+    fm_cache_poll();
+    CHECK(!a->stale && a->wd >= 0);
+    touch(real, "two");
+    CHECK(poll_stale(a));
+    CHECK(fm_dircache_revalidate(a) == 0 && a->count == 3);
+    CHECK(fm_dircache_peek(real) == a);
+    fm_dircache_release(a);
+}
+
+int main(void) {
+    char dir[PATH_MAX];
+    if (!test_tmpdir(dir, sizeof(dir), "cache")) { perror("mkdtemp"); return 1; }
+    fm_cache_init();
+    test_shared(dir);
+    fm_cache_shutdown();
+    fm_remove_tree(dir, NULL, NULL);
+    TEST_DONE("cache");
+}
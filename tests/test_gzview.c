@@ -0,0 +1,132 @@
+#define _XOPEN_SOURCE 700
+#include "gzview.h"
+#include "fs.h"
+#include "test.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#define DATA_SIZE (5 * 1024 * 1024 + 12345)
+
+static unsigned long long rng_state = 88172645463325252ULL;
+
+static unsigned long long rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* Append one gzip member holding data to fd */
+static int write_member(int fd, const unsigned char *data, size_t len) {
+    z_stream s;
+    memset(&s, 0, sizeof(s));
+    if (deflateInit2(&s, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return -1;
+    unsigned char out[65536];
+    s.next_in = (unsigned char *)data;
+    s.avail_in = len;
+    int rc;
+    do {
+        s.next_out = out;
+        s.avail_out = sizeof(out);
+        rc = deflate(&s, Z_FINISH);
+        size_t n = sizeof(out) - s.avail_out;
+        if (rc == Z_STREAM_ERROR || write(fd, out, n) != (ssize_t)n) { deflateEnd(&s); return -1; }
+    } while (rc != Z_STREAM_END);
+    deflateEnd(&s);
+    return 0;
+}
+
+/* Read [off, off + len) and compare with the source */
+static int read_matches(fm_gz *gz, const unsigned char *data, off_t off, size_t len) {
+    static unsigned char buf[300 * 1024];
+    ssize_t n = fm_gz_pread(gz, buf, len, off);
+    size_t want = off >= DATA_SIZE ? 0 : (size_t)(DATA_SIZE - off) < len ? (size_t)(DATA_SIZE - off) : len;
+    return n == (ssize_t)want && memcmp(buf, data + off, want) == 0;
+}
+
+/* Random reads in both directions over members split at odd offsets (one of them empty) */
+static void test_reads(const char *dir, const unsigned char *data) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/data.gz", dir);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0);
+    size_t cuts[] = { 0, 1500000, 1500000, 3333333, DATA_SIZE };
+    for (size_t i = 0; i + 1 < sizeof(cuts) / sizeof(cuts[0]); ++i) {
+        CHECK(write_member(fd, data + cuts[i], cuts[i + 1] - cuts[i]) == 0);
+    }
+    close(fd);
+
+    CHECK(fm_gz_is_gzip(path));
+    fm_gz *gz = fm_gz_open(path);
+    CHECK(gz != NULL);
+    if (!gz) return;
+
+    /* Forward to the end, then jumps back across checkpoints and member boundaries */
+    CHECK(read_matches(gz, data, 0, 4096));
+    CHECK(read_matches(gz, data, DATA_SIZE - 100, 4096));
+    CHECK(read_matches(gz, data, 1500000 - 10, 20));
+    CHECK(read_matches(gz, data, 3333333 - 70000, 140000));
+    CHECK(read_matches(gz, data, 1048576 + 3, 300 * 1024));
+    CHECK(read_matches(gz, data, 17, 1));
+    int ok = 1;
+    for (int i = 0; i < 200; ++i) {
+        off_t off = rng() % (DATA_SIZE + 1000);
+        if (!read_matches(gz, data, off, 1 + rng() % (64 * 1024))) ok = 0;
+    }
+    CHECK(ok);
+    CHECK(read_matches(gz, data, DATA_SIZE, 10) && read_matches(gz, data, DATA_SIZE + 5, 10));
+
+    CHECK(fm_gz_scan(gz, NULL, NULL) == 0);
+    CHECK(gz->complete && gz->size == DATA_SIZE);
+    CHECK(gz->npoints > 1 && gz->points[0].out == 0);
+    ok = 1;
+    for (int i = 1; i < gz->npoints; ++i) {
+        if (gz->points[i].out <= gz->points[i - 1].out) ok = 0;
+    }
+    CHECK(ok);
+    CHECK(read_matches(gz, data, 2 * 1048576 - 1, 2));
+    fm_gz_close(gz);
+}
+
+/* A fresh reader whose first read is far from the start */
+static void test_cold_seek(const char *dir, const unsigned char *data) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/data.gz", dir);
+    fm_gz *gz = fm_gz_open(path);
+    CHECK(gz != NULL);
+    if (!gz) return;
+    CHECK(read_matches(gz, data, 4 * 1048576, 1000));
+    CHECK(read_matches(gz, data, 5, 1000));
+    fm_gz_close(gz);
+}
+
+static void test_not_gzip(const char *dir) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/plain.txt", dir);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0 && write(fd, "plain text\n", 11) == 11);
+    close(fd);
+    CHECK(!fm_gz_is_gzip(path));
+    errno = 0;
+    CHECK(fm_gz_open(path) == NULL && errno == EINVAL);
+}
+
+int main(void) {
+    char dir[PATH_MAX];
+    if (!test_tmpdir(dir, sizeof(dir), "gzview")) { perror("mkdtemp"); return 1; }
+    /* Compressible but not trivial: short words from a small alphabet */
+    unsigned char *data = malloc(DATA_SIZE);
+    for (size_t i = 0; i < DATA_SIZE; ++i) {
+        unsigned r = rng() % 40;
+        data[i] = r < 4 ? ' ' : r == 4 ? '\n' : 'a' + r % 16;
+    }
+    test_reads(dir, data);
+    test_cold_seek(dir, data);
+    test_not_gzip(dir);
+    free(data);
+    fm_remove_tree(dir, NULL, NULL);
+    TEST_DONE("gzview");
+}
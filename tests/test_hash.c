@@ -0,0 +1,94 @@
+#define _XOPEN_SOURCE 700
+#include "hash.h"
+#include "test.h"
+#include <string.h>
+
+static void hex(const unsigned char *d, size_t n, char *out) {
+    for (size_t i = 0; i < n; ++i) sprintf(out + 2 * i, "%02x", d[i]);
+}
+
+static void sha256_hex(const void *data, size_t len, size_t chunk, char out[65]) {
+    fm_sha256_state s;
+    unsigned char d[32];
+    fm_sha256_init(&s);
+    for (size_t off = 0; off < len; off += chunk) {
+        fm_sha256_update(&s, (const char *)data + off, len - off < chunk ? len - off : chunk);
+    }
+    fm_sha256_final(&s, d);
+    hex(d, sizeof(d), out);
+}
+
+static void test_xxh64(void) {
+    CHECK(fm_xxh64("", 0, 0) == 0xEF46DB3751D8E999ULL);
+    CHECK(fm_xxh64("abc", 3, 0) == 0x44BC2CF5AD770999ULL);
+
+    /* Streaming in odd pieces gives the one-shot result, across the 32-byte stripes */
+    unsigned char buf[1000];
+    for (size_t i = 0; i < sizeof(buf); ++i) buf[i] = (unsigned char)(i * 31 + 7);
+    for (uint64_t seed = 0; seed < 2; ++seed) {
+        uint64_t want = fm_xxh64(buf, sizeof(buf), seed);
+        static const size_t chunks[] = { 1, 7, 31, 32, 33, 500 };
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c) {
+            fm_xxh64_state s;
+            fm_xxh64_init(&s, seed);
+            for (size_t off = 0; off < sizeof(buf); off += chunks[c]) {
+                size_t n = sizeof(buf) - off < chunks[c] ? sizeof(buf) - off : chunks[c];
+                fm_xxh64_update(&s, buf + off, n);
+            }
+            CHECK(fm_xxh64_digest(&s) == want);
+        }
+    }
+    CHECK(fm_xxh64(buf, sizeof(buf), 0) != fm_xxh64(buf, sizeof(buf), 1));
+}
+
+static void test_crc32c(void) {
+    CHECK(fm_crc32c(0, "", 0) == 0);
+    CHECK(fm_crc32c(0, "123456789", 9) == 0xE3069283u);
+
+    /* 32 zero bytes and 32 0xff bytes (RFC 3720 B.4) */
+    unsigned char buf[32];
+    memset(buf, 0, sizeof(buf));
+    CHECK(fm_crc32c(0, buf, sizeof(buf)) == 0x8A9136AAu);
+    memset(buf, 0xff, sizeof(buf));
+    CHECK(fm_crc32c(0, buf, sizeof(buf)) == 0x62A8AB43u);
+
+    /* Continuing from a previous result, at every split of an unaligned buffer */
+    unsigned char big[301];
+    for (size_t i = 0; i < sizeof(big); ++i) big[i] = (unsigned char)(i * 13 + 5);
+    uint32_t want = fm_crc32c(0, big + 1, sizeof(big) - 1);
+    int ok = 1;
+    for (size_t cut = 0; cut < sizeof(big) - 1; ++cut) {
+        if (fm_crc32c(fm_crc32c(0, big + 1, cut), big + 1 + cut, sizeof(big) - 1 - cut) != want) ok = 0;
+    }
+    CHECK(ok);
+}
+
+static void test_sha256(void) {
+    char out[65];
+    sha256_hex("", 0, 1, out);
+    CHECK(strcmp(out, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855") == 0);
+    sha256_hex("abc", 3, 3, out);
+    CHECK(strcmp(out, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") == 0);
+
+    /* Two blocks of padding, fed whole and byte by byte */
+    const char *two = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    const char *want = "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1";
+    sha256_hex(two, strlen(two), strlen(two), out);
+    CHECK(strcmp(out, want) == 0);
+    sha256_hex(two, strlen(two), 1, out);
+    CHECK(strcmp(out, want) == 0);
+
+    /* One million 'a' in uneven pieces */
+    char *a = malloc(1000000);
+    memset(a, 'a', 1000000);
+    sha256_hex(a, 1000000, 4099, out);
+    CHECK(strcmp(out, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0") == 0);
+    free(a);
+}
+
+int main(void) {
+    test_xxh64();
+    test_crc32c();
+    test_sha256();
+    TEST_DONE("hash");
+}
@@ -0,0 +1,140 @@
+#define _XOPEN_SOURCE 700
+#include "jump.h"
+#include "test.h"
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#define NOW 1700000000
+
+static int find(const fm_jumps *db, const char *path) {
+    for (int i = 0; i < db->count; ++i) {
+        if (strcmp(db->items[i].path, path) == 0) return i;
+    }
+    return -1;
+}
+
+/* Paths of the matches for query, best first, separated by spaces */
+static int matches_are(const fm_jumps *db, const char *query, const char *want) {
+    int out[FM_JUMP_MAX_ENTRIES];
+    int n = fm_jump_match(db, query, NOW, NULL, 0, out);
+    char got[4096] = "";
+    size_t len = 0;
+    for (int i = 0; i < n && len < sizeof(got) - 1024; ++i) {
+        len += snprintf(got + len, sizeof(got) - len, "%s%s", i ? " " : "", db->items[out[i]].path);
+    }
+    if (strcmp(got, want) != 0) fprintf(stderr, "match \"%s\": \"%s\", expected \"%s\"\n", query, got, want);
+    return strcmp(got, want) == 0;
+}
+
+static void test_frecency(void) {
+    fm_jump_entry e = { "/x", 8, NOW };
+    CHECK(fm_jump_frecency(&e, NOW + 10) == 32);
+    CHECK(fm_jump_frecency(&e, NOW + 7200) == 16);
+    CHECK(fm_jump_frecency(&e, NOW + 2 * 86400) == 4);
+    CHECK(fm_jump_frecency(&e, NOW + 30 * 86400) == 2);
+}
+
+static void test_match(void) {
+    fm_jumps db;
+    memset(&db, 0, sizeof(db));
+    for (int i = 0; i < 3; ++i) fm_jump_visit(&db, "/home/u/src/filemgr", NOW);
+    fm_jump_visit(&db, "/home/u/src/filemgr/include", NOW);
+    for (int i = 0; i < 5; ++i) fm_jump_visit(&db, "/home/u/Documents/film", NOW - 2 * 86400);
+    fm_jump_visit(&db, "/tmp/fm", NOW);
+    fm_jump_visit(&db, "relative", NOW);
+    fm_jump_visit(&db, "/bad\tpath", NOW);
+    CHECK(db.count == 4 && db.dirty && db.total == 10);
+    CHECK(db.items[find(&db, "/home/u/src/filemgr")].rank == 3);
+
+    /* Last component x4 as a substring, x2 as a subsequence, times rank weighted by age:
+     * filemgr 2*3*4, fm 4*1*4, film 2*5/2, include 1*1*4 */
+    CHECK(matches_are(&db, "fm", "/home/u/src/filemgr /tmp/fm /home/u/Documents/film /home/u/src/filemgr/include"));
+    /* filemgr 2*3*4, film 4*5/2, include 1*1*4 */
+    CHECK(matches_are(&db, "FILM", "/home/u/src/filemgr /home/u/Documents/film /home/u/src/filemgr/include"));
+    CHECK(matches_are(&db, "src inc", "/home/u/src/filemgr/include"));
+    CHECK(matches_are(&db, "inc src", ""));
+    CHECK(matches_are(&db, "zzz", ""));
+    /* Equal scores put the shorter path first */
+    CHECK(matches_are(&db, "  ", "/home/u/src/filemgr /tmp/fm /home/u/src/filemgr/include /home/u/Documents/film"));
+
+    /* Refining a previous result only looks at those candidates */
+    int cand[FM_JUMP_MAX_ENTRIES], out[FM_JUMP_MAX_ENTRIES];
+    int n = fm_jump_match(&db, "u", NOW, NULL, 0, cand);
+    CHECK(n == 3);
+    n = fm_jump_match(&db, "u m", NOW, cand, n, cand);
+    CHECK(n == 3);
+    for (int i = 0; i < n; ++i) CHECK(cand[i] != find(&db, "/tmp/fm"));
+    n = fm_jump_match(&db, "fm", NOW, cand, 0, out);
+    CHECK(n == 0);
+
+    fm_jump_forget(&db, "/tmp/fm");
+    fm_jump_forget(&db, "/not/there");
+    CHECK(db.count == 3 && find(&db, "/tmp/fm") < 0 && db.total == 9);
+    fm_jump_free(&db);
+}
+
+static void test_aging(void) {
+    fm_jumps db;
+    memset(&db, 0, sizeof(db));
+    fm_jump_visit(&db, "/once", NOW);
+    for (int i = 0; i < FM_JUMP_MAX_RANK - 1; ++i) fm_jump_visit(&db, "/often", NOW);
+    CHECK(db.count == 2 && db.total == FM_JUMP_MAX_RANK);
+
+    /* Going over the total ages every rank by 10% and drops what falls below 1 */
+    fm_jump_visit(&db, "/often", NOW);
+    CHECK(db.count == 1 && find(&db, "/once") < 0);
+    CHECK(db.total > 0.9 * FM_JUMP_MAX_RANK - 0.5 && db.total < 0.9 * FM_JUMP_MAX_RANK + 0.5);
+    fm_jump_free(&db);
+
+    /* A full database makes room by dropping the lowest frecency */
+    memset(&db, 0, sizeof(db));
+    char path[64];
+    for (int i = 0; i < FM_JUMP_MAX_ENTRIES; ++i) {
+        snprintf(path, sizeof(path), "/d%d", i);
+        fm_jump_visit(&db, path, i == 7 ? NOW - 30 * 86400 : NOW);
+        if (i != 7) fm_jump_visit(&db, path, NOW);
+    }
+    CHECK(db.count == FM_JUMP_MAX_ENTRIES);
+    fm_jump_visit(&db, "/newcomer", NOW);
+    CHECK(db.count == FM_JUMP_MAX_ENTRIES && find(&db, "/d7") < 0 && find(&db, "/newcomer") >= 0);
+    fm_jump_free(&db);
+}
+
+static void test_save_load(void) {
+    char file[PATH_MAX];
+    const char *base = getenv("TMPDIR");
+    snprintf(file, sizeof(file), "%s/fm_test_jumps_%ld", base && *base ? base : "/tmp", (long)getpid());
+
+    fm_jumps db;
+    CHECK(fm_jump_load(&db, file) == 0 && db.count == 0);
+    fm_jump_visit(&db, "/a b/c", NOW);
+    fm_jump_visit(&db, "/a b/c", NOW + 5);
+    fm_jump_visit(&db, "/z", NOW - 100);
+    CHECK(fm_jump_save(&db, file) == 0 && !db.dirty);
+    fm_jump_free(&db);
+
+    /* Malformed and duplicate lines are skipped */
+    FILE *f = fopen(file, "a");
+    CHECK(f != NULL);
+    if (f) {
+        fputs("garbage\n-1\t5\t/neg\n2\t5\trelative\n9\t9\t/z\n", f);
+        fclose(f);
+    }
+    CHECK(fm_jump_load(&db, file) == 0);
+    CHECK(db.count == 2 && db.total == 3 && !db.dirty);
+    int i = find(&db, "/a b/c");
+    CHECK(i >= 0 && db.items[i].rank == 2 && db.items[i].last == NOW + 5);
+    i = find(&db, "/z");
+    CHECK(i >= 0 && db.items[i].rank == 1 && db.items[i].last == NOW - 100);
+    fm_jump_free(&db);
+    unlink(file);
+}
+
+int main(void) {
+    test_frecency();
+    test_match();
+    test_aging();
+    test_save_load();
+    TEST_DONE("jump");
+}
@@ -0,0 +1,89 @@
+#define _XOPEN_SOURCE 700
+#include "select.h"
+#include "test.h"
+#include <string.h>
+
+static fm_entry *make_items(int n) {
+    fm_entry *items = calloc(n, sizeof(*items));
+    strcpy(items[0].name, "..");
+    for (int i = 1; i < n; ++i) snprintf(items[i].name, sizeof(items[i].name), "f%03d", i);
+    return items;
+}
+
+/* Marks, anchors and ".." in a short listing */
+static void test_small(void) {
+    static const char *names[] = { "..", "a.c", "b.c", "c.h", ".hidden.c", "d" };
+    fm_entry items[6];
+    memset(items, 0, sizeof(items));
+    for (int i = 0; i < 6; ++i) strcpy(items[i].name, names[i]);
+
+    fm_selection s;
+    fm_sel_init(&s);
+    CHECK(fm_sel_resize(&s, 6) == 0);
+    CHECK(s.count == 0 && s.anchor == -1);
+
+    fm_sel_toggle(&s, items, 0);
+    CHECK(s.count == 0 && !fm_sel_test(&s, 0));
+    fm_sel_toggle(&s, items, 1);
+    CHECK(s.count == 1 && fm_sel_test(&s, 1) && s.anchor == 1);
+    fm_sel_toggle(&s, items, 1);
+    CHECK(s.count == 0 && !fm_sel_test(&s, 1));
+
+    fm_sel_toggle(&s, items, 4);
+    fm_sel_range(&s, items, 0);
+    CHECK(s.count == 4);
+    CHECK(!fm_sel_test(&s, 0) && fm_sel_test(&s, 1) && fm_sel_test(&s, 4) && !fm_sel_test(&s, 5));
+    CHECK(s.anchor == 0);
+
+    fm_sel_invert(&s, items);
+    CHECK(s.count == 1 && fm_sel_test(&s, 5) && !fm_sel_test(&s, 0));
+    CHECK(fm_sel_next(&s, 0) == 5 && fm_sel_next(&s, 6) == -1);
+
+    fm_sel_clear(&s);
+    CHECK(fm_sel_match(&s, items, "*.c") == 2);
+    CHECK(fm_sel_test(&s, 1) && fm_sel_test(&s, 2) && !fm_sel_test(&s, 4));
+    CHECK(fm_sel_match(&s, items, "*.c") == 0);
+    CHECK(fm_sel_match(&s, items, "*") == 2);
+    CHECK(s.count == 4 && !fm_sel_test(&s, 4));
+    CHECK(fm_sel_next(&s, 0) == 1 && fm_sel_next(&s, 3) == 3 && fm_sel_next(&s, 4) == 5);
+    fm_sel_free(&s);
+}
+
+/* Ranges and inversion across word boundaries, and resizing to a new listing */
+static void test_words(void) {
+    int n = 130;
+    fm_entry *items = make_items(n);
+    fm_selection s;
+    fm_sel_init(&s);
+    CHECK(fm_sel_resize(&s, n) == 0);
+
+    fm_sel_toggle(&s, items, 10);
+    fm_sel_range(&s, items, 120);
+    CHECK(s.count == 111);
+    CHECK(fm_sel_next(&s, 0) == 10 && fm_sel_next(&s, 64) == 64 && fm_sel_next(&s, 121) == -1);
+
+    fm_sel_invert(&s, items);
+    CHECK(s.count == n - 1 - 111);
+    CHECK(fm_sel_next(&s, 0) == 1 && fm_sel_next(&s, 10) == 121 && fm_sel_test(&s, 129));
+    CHECK(!fm_sel_test(&s, 130) && !fm_sel_test(&s, -1));
+
+    fm_sel_invert(&s, items);
+    CHECK(s.count == 111);
+
+    /* A new listing starts without marks, whatever its size */
+    CHECK(fm_sel_resize(&s, 3) == 0);
+    CHECK(s.count == 0 && fm_sel_next(&s, 0) == -1);
+    fm_sel_invert(&s, items);
+    CHECK(s.count == 2 && fm_sel_next(&s, 0) == 1);
+    CHECK(fm_sel_resize(&s, n) == 0);
+    CHECK(s.count == 0 && fm_sel_next(&s, 0) == -1);
+
+    fm_sel_free(&s);
+    free(items);
+}
+
+int main(void) {
+    test_small();
+    test_words();
+    TEST_DONE("select");
+}
@@ -0,0 +1,143 @@
+#define _XOPEN_SOURCE 700
+#include "tree.h"
+#include "fs.h"
+#include "test.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static void make(const char *dir, const char *name, int is_dir) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (is_dir) mkdir(path, 0755);
+    else close(open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+}
+
+/* Rows after the root, by name, separated by spaces */
+static int rows_are(const fm_tree *t, const char *want) {
+    char got[4096] = "";
+    size_t len = 0;
+    for (int r = 1; r < t->nrows && len < sizeof(got) - 512; ++r) {
+        len += snprintf(got + len, sizeof(got) - len, "%s%s", r > 1 ? " " : "", fm_tree_row(t, r)->name);
+    }
+    if (strcmp(got, want) != 0) fprintf(stderr, "rows: \"%s\", expected \"%s\"\n", got, want);
+    return strcmp(got, want) == 0;
+}
+
+static int row_of(const fm_tree *t, const char *name) {
+    for (int r = 0; r < t->nrows; ++r) {
+        if (strcmp(fm_tree_row(t, r)->name, name) == 0) return r;
+    }
+    return -1;
+}
+
+static void test_expand(const char *dir) {
+    make(dir, "a", 1);
+    make(dir, "a/x", 1);
+    make(dir, "a/x/f1", 0);
+    make(dir, "a/y", 1);
+    make(dir, "B", 1);
+    make(dir, "c.txt", 0);
+    make(dir, "D.txt", 0);
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/link", dir);
+    CHECK(symlink("a", path) == 0);
+
+    fm_tree t;
+    CHECK(fm_tree_init(&t, dir) == 0);
+    CHECK(t.nrows == 6 && t.reads == 1 && fm_tree_row(&t, 0) == &t.root);
+    CHECK(rows_are(&t, "a B c.txt D.txt link"));
+    CHECK(fm_tree_row(&t, 6) == NULL && fm_tree_row(&t, -1) == NULL);
+
+    /* Files and symlinks to directories do not expand */
+    CHECK(fm_tree_expand(&t, row_of(&t, "c.txt")) == 0);
+    CHECK(fm_tree_expand(&t, row_of(&t, "link")) == 0);
+
+    CHECK(fm_tree_expand(&t, 1) == 2);
+    CHECK(rows_are(&t, "a x y B c.txt D.txt link"));
+    CHECK(fm_tree_expand(&t, 1) == 0);
+    CHECK(fm_tree_expand(&t, 2) == 1);
+    CHECK(rows_are(&t, "a x f1 y B c.txt D.txt link"));
+    CHECK(t.reads == 3 && fm_tree_row(&t, 3)->depth == 3);
+    CHECK(fm_tree_parent_row(&t, 3) == 2 && fm_tree_parent_row(&t, 4) == 1);
+    CHECK(fm_tree_parent_row(&t, 5) == 0 && fm_tree_parent_row(&t, 0) == -1);
+    snprintf(path, sizeof(path), "%s/a/x/f1", dir);
+    char got[PATH_MAX];
+    CHECK(fm_tree_path(fm_tree_row(&t, 3), got, sizeof(got)) == 0 && strcmp(got, path) == 0);
+    CHECK(fm_tree_path(fm_tree_row(&t, 3), got, 8) == -1);
+
+    /* Collapsing keeps the subtree; expanding again brings back what was open, unread */
+    CHECK(fm_tree_collapse(&t, 1) == 3);
+    CHECK(rows_are(&t, "a B c.txt D.txt link"));
+    CHECK(fm_tree_collapse(&t, 1) == 0);
+    CHECK(fm_tree_expand(&t, 1) == 3 && t.reads == 3);
+    CHECK(rows_are(&t, "a x f1 y B c.txt D.txt link"));
+
+    /* Reloading rereads the directory and forgets what was expanded below it */
+    make(dir, "a/new", 0);
+    CHECK(fm_tree_reload(&t, 1) == 0 && t.reads == 4);
+    CHECK(rows_are(&t, "a x y new B c.txt D.txt link"));
+
+    /* An unreadable directory keeps its errno and stays collapsed */
+    snprintf(path, sizeof(path), "%s/a/y", dir);
+    rmdir(path);
+    int y = row_of(&t, "y");
+    CHECK(fm_tree_expand(&t, y) == -1 && fm_tree_row(&t, y)->err == ENOENT);
+    CHECK(!fm_tree_row(&t, y)->expanded);
+    fm_tree_free(&t);
+}
+
+/* Enough rows to grow the gap buffer, opened and closed in a scattered order */
+static void test_many(const char *dir) {
+    char sub[PATH_MAX], name[64];
+    snprintf(sub, sizeof(sub), "%s/many", dir);
+    mkdir(sub, 0755);
+    for (int i = 0; i < 40; ++i) {
+        snprintf(name, sizeof(name), "d%02d", i);
+        make(sub, name, 1);
+        for (int j = 0; j < 20; ++j) {
+            snprintf(name, sizeof(name), "d%02d/f%02d", i, j);
+            make(sub, name, 0);
+        }
+    }
+    fm_tree t;
+    CHECK(fm_tree_init(&t, sub) == 0);
+    CHECK(t.nrows == 41);
+    for (int i = 39; i >= 0; i -= 3) CHECK(fm_tree_expand(&t, 1 + i) == 20);
+    for (int i = 0; i < 40; ++i) {
+        snprintf(name, sizeof(name), "d%02d", i);
+        int r = row_of(&t, name);
+        if (i % 3 == 0) CHECK(fm_tree_collapse(&t, r) == 20);
+        else if (i % 3 == 1) CHECK(fm_tree_expand(&t, r) == 20);
+    }
+    /* Every directory row is followed by exactly its own children */
+    int ok = 1, expect = 0;
+    for (int r = 1; r < t.nrows; ++r) {
+        fm_tree_node *n = fm_tree_row(&t, r);
+        if (n->depth == 1) {
+            snprintf(name, sizeof(name), "d%02d", expect++);
+            if (strcmp(n->name, name) != 0) ok = 0;
+            for (int j = 0; n->expanded && j < 20; ++j) {
+                fm_tree_node *c = fm_tree_row(&t, r + 1 + j);
+                snprintf(name, sizeof(name), "f%02d", j);
+                if (!c || c->parent != n || strcmp(c->name, name) != 0) ok = 0;
+                if (fm_tree_parent_row(&t, r + 1 + j) != r) ok = 0;
+            }
+        }
+    }
+    CHECK(ok && expect == 40 && t.nrows == 41 + 13 * 20);
+    CHECK(t.gap >= 0 && t.gap <= t.nrows && t.reads == 1 + 27);
+    fm_tree_free(&t);
+}
+
+int main(void) {
+    char dir[PATH_MAX];
+    if (!test_tmpdir(dir, sizeof(dir), "tree")) { perror("mkdtemp"); return 1; }
+    test_expand(dir);
+    test_many(dir);
+    fm_remove_tree(dir, NULL, NULL);
+    TEST_DONE("tree");
+}